@@ -0,0 +1,55 @@
+//
+// 编码输出的分配测试：统计稳定运行后每张图片的数据包内存申请次数（含 ffmpeg 内部为数据包分配的缓冲）。
+// 使用固定的量化参数，编码器上下文在预热后复用
+//
+// 用法：AllocationBenchmark <H264/H265 文件> [次数]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/* 预热的次数，之后视为稳定运行 */
+#define WARMUP_TIMES 10
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 文件> [次数]\n", argv[0]);
+        return -1;
+    }
+    const int times = argc > 2 ? atoi(argv[2]) : 200;
+
+    std::vector<unsigned char> inputData;
+    if (!readWholeFile(argv[1], inputData)) {
+        return -1;
+    }
+    std::vector<unsigned char> jpegData;
+
+    DecoderConfig config;
+    config.persistent = true;
+    config.jpegQscale = 6;
+    auto decoder = IDecoder::getInstance(config);
+
+    AllocationStats warmup = {};
+    unsigned long long t1 = 0;
+    for (int i = 0; i < WARMUP_TIMES + times; ++i) {
+        if (i == WARMUP_TIMES) {
+            warmup = IDecoder::getAllocationStats();
+            t1 = getCurrentMicros();
+        }
+        if (!decoder->H265ToJpeg(inputData.data(), inputData.size(), jpegData)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t2 = getCurrentMicros();
+    AllocationStats steady = IDecoder::getAllocationStats();
+
+    printf(">>> 预热 %d 张: 申请 %llu 次, 共 %llu 字节\n", WARMUP_TIMES, warmup.heapAllocations, warmup.heapBytes);
+    printf(">>> 稳定运行 %llu 张: 申请 %llu 次, 共 %llu 字节\n", steady.encodes - warmup.encodes,
+           steady.heapAllocations - warmup.heapAllocations, steady.heapBytes - warmup.heapBytes);
+    printf(">>> 稳定运行: %.2f 次/张\n",
+           (double) (steady.heapAllocations - warmup.heapAllocations) / (steady.encodes - warmup.encodes));
+    printf(">>> 稳定运行: %.3f 毫秒/张\n", (t2 - t1) / 1000.0 / times);
+    return 0;
+}
@@ -0,0 +1,80 @@
+//
+// Annex-B 裸流快速路径的性能测试：对比 avformat 打开探测与 av_parser 直接切分的单张耗时（即出第一帧的耗时）
+//
+// 用法：AnnexBBenchmark <H264/H265 裸流文件> [次数]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 统计一种配置下的单张耗时
+ * @param config    解码器配置
+ * @param filePath  输入文件路径，同时用于文件接口的测试
+ * @param inputData 输入文件的内容，用于内存接口的测试
+ * @param times     次数
+ * @param memoryMs  内存接口的单张耗时（毫秒）
+ * @param fileMs    文件接口的单张耗时（毫秒）
+ * @return
+ */
+static bool measure(const DecoderConfig &config, const char *filePath, const std::vector<unsigned char> &inputData,
+                    int times, double &memoryMs, double &fileMs) {
+    auto decoder = IDecoder::getInstance(config);
+    std::vector<unsigned char> jpegData;
+    MemorySink sink;
+
+    unsigned long long t1 = getCurrentMicros();
+    for (int i = 0; i < times; ++i) {
+        if (!decoder->H265ToJpeg(inputData.data(), inputData.size(), jpegData)) {
+            printf("解码失败！\n");
+            return false;
+        }
+    }
+    unsigned long long t2 = getCurrentMicros();
+    for (int i = 0; i < times; ++i) {
+        if (!decoder->H265ToJpeg(filePath, sink)) {
+            printf("解码失败！\n");
+            return false;
+        }
+    }
+    unsigned long long t3 = getCurrentMicros();
+
+    memoryMs = (t2 - t1) / 1000.0 / times;
+    fileMs = (t3 - t2) / 1000.0 / times;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 裸流文件> [次数]\n", argv[0]);
+        return -1;
+    }
+    const int times = argc > 2 ? atoi(argv[2]) : 50;
+
+    std::vector<unsigned char> inputData;
+    if (!readWholeFile(argv[1], inputData)) {
+        return -1;
+    }
+
+    // 两种方式都使用常驻解码器，只比较输入解析部分的差异
+    DecoderConfig config;
+    config.persistent = true;
+
+    double formatMemoryMs, formatFileMs;
+    config.annexBFastPath = false;
+    if (!measure(config, argv[1], inputData, times, formatMemoryMs, formatFileMs)) {
+        return -1;
+    }
+
+    double parserMemoryMs, parserFileMs;
+    config.annexBFastPath = true;
+    if (!measure(config, argv[1], inputData, times, parserMemoryMs, parserFileMs)) {
+        return -1;
+    }
+
+    printf(">>> 次数: %d\n", times);
+    printf(">>> avformat 探测: 内存 %.3f 毫秒/张，文件 %.3f 毫秒/张\n", formatMemoryMs, formatFileMs);
+    printf(">>> av_parser 切分: 内存 %.3f 毫秒/张，文件 %.3f 毫秒/张\n", parserMemoryMs, parserFileMs);
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+// 异步转换的性能测试：对比一个调用线程逐张同步转换与一次提交全部异步转换的吞吐量
+//
+// 用法：AsyncBenchmark <H264/H265 文件> [张数] [工作线程数]
+//
+
+#include <cstdlib>
+#include <string>
+#include "BenchUtil.h"
+#include "IConvertService.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 文件> [张数] [工作线程数]\n", argv[0]);
+        return -1;
+    }
+    const int count = argc > 2 ? atoi(argv[2]) : 200;
+    const int workers = argc > 3 ? atoi(argv[3]) : 0;
+
+    std::vector<ConvertItem> items;
+    for (int i = 0; i < count; ++i) {
+        items.push_back(ConvertItem{argv[1], "/tmp/async_" + std::to_string(i) + ".jpeg"});
+    }
+
+    // 一个调用线程逐张同步转换
+    DecoderConfig decoderConfig;
+    decoderConfig.persistent = true;
+    auto decoder = IDecoder::getInstance(decoderConfig);
+    unsigned long long t1 = getCurrentMicros();
+    for (const auto &item : items) {
+        if (!decoder->H265ToJpeg(item.inputFilePath.c_str(), item.outputFilePath.c_str())) {
+            printf("转换失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t2 = getCurrentMicros();
+
+    // 同一个调用线程一次提交全部异步转换，再依次等待结果
+    ConvertServiceConfig config;
+    config.workers = workers;
+    auto service = IConvertService::getInstance(config);
+    unsigned long long t3 = getCurrentMicros();
+    std::vector<std::future<ConvertResult>> futures;
+    for (const auto &item : items) {
+        futures.push_back(service->convertAsync(item));
+    }
+    unsigned long long t4 = getCurrentMicros();
+    for (auto &future : futures) {
+        if (future.get() != ConvertResult::Ok) {
+            printf("转换失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t5 = getCurrentMicros();
+
+    printf(">>> 张数: %d ，工作线程数: %d\n", count, service->workerCount());
+    printf(">>> 同步逐张: %.1f 张/秒\n", count * 1e6 / (t2 - t1));
+    printf(">>> 异步提交: %.1f 张/秒（提交全部耗时 %.3f 毫秒）\n", count * 1e6 / (t5 - t3), (t4 - t3) / 1000.0);
+    return 0;
+}
@@ -0,0 +1,77 @@
+//
+// 批量转换的性能测试：对比多个线程各自每张新建解码器（原有 JNI 的调用方式）与批量转换服务的吞吐量，
+// 以及指定固定量化参数、编码器也常驻时的吞吐量
+//
+// 用法：BatchBenchmark <H264/H265 文件> [张数] [线程数]
+//
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "BenchUtil.h"
+#include "IConvertService.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 文件> [张数] [线程数]\n", argv[0]);
+        return -1;
+    }
+    const int count = argc > 2 ? atoi(argv[2]) : 200;
+    const int threads = argc > 3 ? atoi(argv[3]) : (int) std::thread::hardware_concurrency();
+
+    std::vector<ConvertItem> items;
+    for (int i = 0; i < count; ++i) {
+        items.push_back(ConvertItem{argv[1], "/tmp/batch_" + std::to_string(i % threads) + ".jpeg"});
+    }
+
+    // 多个线程各自循环，每张新建一个解码器
+    unsigned long long t1 = getCurrentMicros();
+    std::vector<std::thread> callers;
+    for (int t = 0; t < threads; ++t) {
+        callers.emplace_back([&items, threads, t] {
+            for (size_t i = (size_t) t; i < items.size(); i += threads) {
+                auto decoder = IDecoder::getInstance();
+                decoder->H265ToJpeg(items[i].inputFilePath.c_str(), items[i].outputFilePath.c_str());
+            }
+        });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+    unsigned long long t2 = getCurrentMicros();
+
+    // 批量转换服务，工作线程的解码器常驻，编码器每张新建（默认的码率控制）
+    ConvertServiceConfig config;
+    config.workers = threads;
+    auto service = IConvertService::getInstance(config);
+    unsigned long long t3 = getCurrentMicros();
+    std::vector<ConvertResult> results = service->convertBatch(items);
+    unsigned long long t4 = getCurrentMicros();
+    for (auto result : results) {
+        if (result != ConvertResult::Ok) {
+            printf("转换失败！\n");
+            return -1;
+        }
+    }
+
+    // 指定固定的量化参数，编码器也常驻，每个线程只新建一次
+    config.decoder.jpegQscale = 6;
+    auto fixedQuality = IConvertService::getInstance(config);
+    unsigned long long opens = IDecoder::getAllocationStats().encoderOpens;
+    unsigned long long t5 = getCurrentMicros();
+    results = fixedQuality->convertBatch(items);
+    unsigned long long t6 = getCurrentMicros();
+    opens = IDecoder::getAllocationStats().encoderOpens - opens;
+    for (auto result : results) {
+        if (result != ConvertResult::Ok) {
+            printf("转换失败！\n");
+            return -1;
+        }
+    }
+
+    printf(">>> 张数: %d ，线程数: %d\n", count, threads);
+    printf(">>> 每张新建解码器: %.1f 张/秒\n", count * 1e6 / (t2 - t1));
+    printf(">>> 批量转换服务:   %.1f 张/秒\n", count * 1e6 / (t4 - t3));
+    printf(">>> 固定量化参数:   %.1f 张/秒，新建编码器 %llu 个\n", count * 1e6 / (t6 - t5), opens);
+    return 0;
+}
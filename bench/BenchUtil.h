@@ -0,0 +1,39 @@
+//
+// 性能测试的公共工具
+//
+
+#ifndef H265TOJPEG_BENCHUTIL_H
+#define H265TOJPEG_BENCHUTIL_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+/**
+ * 获取单调时钟时间戳（微秒级）
+ * @return
+ */
+inline unsigned long long getCurrentMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * 将整个文件读入内存
+ * @param filePath 文件路径
+ * @param data     文件内容
+ * @return
+ */
+inline bool readWholeFile(const char *filePath, std::vector<unsigned char> &data) {
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) {
+        printf("打开文件失败：%s\n", filePath);
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+#endif //H265TOJPEG_BENCHUTIL_H
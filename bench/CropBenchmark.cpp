@@ -0,0 +1,101 @@
+//
+// 批量裁剪的性能测试：对每个输入文件，对比转换整张 Jpeg 与一次解码裁剪出多个区域（大小相同 / 大小各异）的单张耗时。
+// 区域在图像中随机分布。指定量化参数时编码器按尺寸缓存，大小相同的区域共用一个编码器上下文
+//
+// 用法：CropBenchmark <H264/H265 文件>... [-n 张数] [-r 每张的区域数] [-w 区域边长] [-q Jpeg 量化参数]
+//
+
+#include <cstdlib>
+#include <cstring>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 生成随机分布的区域
+ * @param count    区域数
+ * @param size     区域边长，sameSize 为 false 时在 size/2 ~ size*3/2 之间随机
+ * @param sameSize 是否大小相同
+ * @param sinks    各区域的输出端
+ * @return
+ */
+static std::vector<CropRegion> makeRegions(int count, int size, bool sameSize, std::vector<MemorySink> &sinks) {
+    // 1080P 以上的图像都能容纳，超出图像的部分由解码器截掉
+    std::vector<CropRegion> regions((size_t) count);
+    srand(1);
+    for (int i = 0; i < count; ++i) {
+        CropRegion &region = regions[i];
+        region.width = sameSize ? size : size / 2 + rand() % (size + 1);
+        region.height = sameSize ? size : size / 2 + rand() % (size + 1);
+        region.x = rand() % (1920 - region.width);
+        region.y = rand() % (1080 - region.height);
+        region.sink = &sinks[i];
+    }
+    return regions;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+    int count = 20;
+    int regionCount = 32;
+    int size = 128;
+    DecoderConfig config;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            regionCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            config.jpegQscale = atoi(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || regionCount <= 0 || size <= 0 || size * 3 / 2 >= 1080) {
+        printf("用法：%s <H264/H265 文件>... [-n 张数] [-r 每张的区域数] [-w 区域边长，小于 720] [-q Jpeg 量化参数]\n",
+               argv[0]);
+        return -1;
+    }
+
+    std::vector<MemorySink> sinks((size_t) regionCount);
+    std::vector<CropRegion> sameRegions = makeRegions(regionCount, size, true, sinks);
+    std::vector<CropRegion> mixedRegions = makeRegions(regionCount, size, false, sinks);
+    auto decoder = IDecoder::getInstance(config);
+
+    for (const char *file : files) {
+        std::vector<unsigned char> data;
+        if (!readWholeFile(file, data)) {
+            return -1;
+        }
+        printf("\n>>> %s ，每张 %d 个区域，%d 张\n", file, regionCount, count);
+
+        // 先各转换一次，创建好编码器和转换上下文，不计入耗时
+        std::vector<unsigned char> jpeg;
+        if (!decoder->H265ToJpeg(data.data(), data.size(), jpeg) ||
+            !decoder->H265ToJpegCrops(data.data(), data.size(), sameRegions) ||
+            !decoder->H265ToJpegCrops(data.data(), data.size(), mixedRegions)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+
+        unsigned long long t1 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToJpeg(data.data(), data.size(), jpeg);
+        }
+        unsigned long long t2 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToJpegCrops(data.data(), data.size(), sameRegions);
+        }
+        unsigned long long t3 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToJpegCrops(data.data(), data.size(), mixedRegions);
+        }
+        unsigned long long t4 = getCurrentMicros();
+
+        printf(">>> 整张 Jpeg:           %.2f 毫秒/张\n", (t2 - t1) / 1000.0 / count);
+        printf(">>> 裁剪（大小相同）:    %.2f 毫秒/张\n", (t3 - t2) / 1000.0 / count);
+        printf(">>> 裁剪（大小各异）:    %.2f 毫秒/张\n", (t4 - t3) / 1000.0 / count);
+    }
+    return 0;
+}
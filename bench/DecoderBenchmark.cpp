@@ -0,0 +1,51 @@
+//
+// 解码器常驻模式的性能测试：对比每张图片新建解码器与复用解码器上下文的单张耗时
+//
+// 用法：DecoderBenchmark <H264/H265 文件> [次数]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 文件> [次数]\n", argv[0]);
+        return -1;
+    }
+    const int times = argc > 2 ? atoi(argv[2]) : 200;
+
+    std::vector<unsigned char> inputData;
+    if (!readWholeFile(argv[1], inputData)) {
+        return -1;
+    }
+    std::vector<unsigned char> jpegData;
+
+    // 每张图片新建一个解码器（原有方式）
+    unsigned long long t1 = getCurrentMicros();
+    for (int i = 0; i < times; ++i) {
+        auto decoder = IDecoder::getInstance();
+        if (!decoder->H265ToJpeg(inputData.data(), inputData.size(), jpegData)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t2 = getCurrentMicros();
+
+    // 复用同一个常驻解码器
+    DecoderConfig config;
+    config.persistent = true;
+    auto decoder = IDecoder::getInstance(config);
+    for (int i = 0; i < times; ++i) {
+        if (!decoder->H265ToJpeg(inputData.data(), inputData.size(), jpegData)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t3 = getCurrentMicros();
+
+    printf(">>> 次数: %d\n", times);
+    printf(">>> 每次新建解码器: %.3f 毫秒/张\n", (t2 - t1) / 1000.0 / times);
+    printf(">>> 常驻解码器:     %.3f 毫秒/张\n", (t3 - t2) / 1000.0 / times);
+    return 0;
+}
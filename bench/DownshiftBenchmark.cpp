@@ -0,0 +1,109 @@
+//
+// 10 位转 8 位的微基准：对比 swscale 的通用路径、运行时选择的 SIMD 实现和标量实现转换一帧 yuv420p10le 的耗时。
+// 直接调用内部的 PixelConvert ，不经过解码和编码
+//
+// 用法：DownshiftBenchmark [宽] [高] [次数]
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "BenchUtil.h"
+#include "PixelConvert.h"
+
+extern "C" {
+#include "libswscale/swscale.h"
+}
+
+/**
+ * 申请一帧
+ */
+static AVFrame *allocFrame(int width, int height, AVPixelFormat format) {
+    AVFrame *frame = av_frame_alloc();
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+    av_frame_get_buffer(frame, 32);
+    return frame;
+}
+
+/**
+ * 用标量实现逐行转换，与 PixelConvert::downshift 的遍历方式相同
+ */
+static void downshiftScalar(const AVFrame *src, AVFrame *dst) {
+    for (int plane = 0; plane < 3; ++plane) {
+        int width = plane == 0 ? src->width : (src->width + 1) / 2;
+        int height = plane == 0 ? src->height : (src->height + 1) / 2;
+        for (int y = 0; y < height; ++y) {
+            PixelConvert::downshiftScalar((const uint16_t *) (src->data[plane] + y * src->linesize[plane]),
+                                          dst->data[plane] + y * dst->linesize[plane], (size_t) width, 2);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int width = argc > 1 ? atoi(argv[1]) : 2560;
+    const int height = argc > 2 ? atoi(argv[2]) : 1440;
+    const int count = argc > 3 ? atoi(argv[3]) : 50;
+
+    // 随机填充 10 位的像素
+    AVFrame *src = allocFrame(width, height, AV_PIX_FMT_YUV420P10LE);
+    srand(1);
+    for (int plane = 0; plane < 3; ++plane) {
+        int planeHeight = plane == 0 ? height : (height + 1) / 2;
+        for (int i = 0; i < src->linesize[plane] / 2 * planeHeight; ++i) {
+            ((uint16_t *) src->data[plane])[i] = (uint16_t) (rand() & 0x3ff);
+        }
+    }
+    AVFrame *swsDst = allocFrame(width, height, AV_PIX_FMT_YUV420P);
+    AVFrame *simdDst = allocFrame(width, height, AV_PIX_FMT_YUV420P);
+    AVFrame *scalarDst = allocFrame(width, height, AV_PIX_FMT_YUV420P);
+    SwsContext *swsCtx = sws_getContext(width, height, AV_PIX_FMT_YUV420P10LE, width, height, AV_PIX_FMT_YUV420P,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+
+    unsigned long long t1 = getCurrentMicros();
+    for (int i = 0; i < count; ++i) {
+        sws_scale(swsCtx, src->data, src->linesize, 0, height, swsDst->data, swsDst->linesize);
+    }
+    unsigned long long t2 = getCurrentMicros();
+    for (int i = 0; i < count; ++i) {
+        PixelConvert::downshift(src, simdDst);
+    }
+    unsigned long long t3 = getCurrentMicros();
+    for (int i = 0; i < count; ++i) {
+        downshiftScalar(src, scalarDst);
+    }
+    unsigned long long t4 = getCurrentMicros();
+
+    // 两种实现的结果应完全一致；swscale 的取整方式不同，只统计差异
+    long long differ = 0;
+    int maxDiff = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int diff = abs(swsDst->data[0][y * swsDst->linesize[0] + x] -
+                           simdDst->data[0][y * simdDst->linesize[0] + x]);
+            differ += diff != 0;
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+    }
+    bool same = true;
+    for (int y = 0; y < height && same; ++y) {
+        same = memcmp(simdDst->data[0] + y * simdDst->linesize[0], scalarDst->data[0] + y * scalarDst->linesize[0],
+                      (size_t) width) == 0;
+    }
+
+    printf(">>> %dx%d yuv420p10le -> yuv420p ，%d 次\n", width, height, count);
+    printf(">>> swscale:        %.3f 毫秒/帧\n", (t2 - t1) / 1000.0 / count);
+    printf(">>> %-15s %.3f 毫秒/帧\n", (std::string(PixelConvert::kernelName()) + ":").c_str(),
+           (t3 - t2) / 1000.0 / count);
+    printf(">>> scalar:         %.3f 毫秒/帧\n", (t4 - t3) / 1000.0 / count);
+    printf(">>> SIMD 与标量结果%s，与 swscale 不同的亮度像素 %lld 个，最大差 %d\n", same ? "一致" : "不一致！", differ,
+           maxDiff);
+
+    sws_freeContext(swsCtx);
+    av_frame_free(&src);
+    av_frame_free(&swsDst);
+    av_frame_free(&simdDst);
+    av_frame_free(&scalarDst);
+    return same ? 0 : -1;
+}
@@ -0,0 +1,63 @@
+//
+// 直接输出像素的性能测试：对每个输入文件，对比解码为 Jpeg 与解码为像素（原始格式 / RGB24）的单张耗时
+//
+// 用法：FrameBenchmark <H264/H265 文件>... [-n 张数]
+//
+
+#include <cstdlib>
+#include <cstring>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+    int count = 20;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        printf("用法：%s <H264/H265 文件>... [-n 张数]\n", argv[0]);
+        return -1;
+    }
+
+    auto decoder = IDecoder::getInstance();
+    for (const char *file : files) {
+        std::vector<unsigned char> data;
+        if (!readWholeFile(file, data)) {
+            return -1;
+        }
+        printf("\n>>> %s ，%d 张\n", file, count);
+
+        // 先各转换一次，创建好编码器和转换上下文，不计入耗时
+        std::vector<unsigned char> jpeg;
+        DecodedFrame decoded;
+        if (!decoder->H265ToJpeg(data.data(), data.size(), jpeg) ||
+            !decoder->H265ToFrame(data.data(), data.size(), decoded, PixelOutput::Rgb24)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+
+        unsigned long long t1 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToJpeg(data.data(), data.size(), jpeg);
+        }
+        unsigned long long t2 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToFrame(data.data(), data.size(), decoded);
+        }
+        unsigned long long t3 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            decoder->H265ToFrame(data.data(), data.size(), decoded, PixelOutput::Rgb24);
+        }
+        unsigned long long t4 = getCurrentMicros();
+
+        printf(">>> Jpeg:           %.2f 毫秒/张\n", (t2 - t1) / 1000.0 / count);
+        printf(">>> 原始格式:       %.2f 毫秒/张\n", (t3 - t2) / 1000.0 / count);
+        printf(">>> RGB24:          %.2f 毫秒/张\n", (t4 - t3) / 1000.0 / count);
+    }
+    return 0;
+}
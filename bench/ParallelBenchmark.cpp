@@ -0,0 +1,41 @@
+//
+// 按 GOP 并行解码的性能测试：对比不同线程数下提取全部帧的耗时
+//
+// 用法：ParallelBenchmark <H264/H265 裸流文件> [最大线程数] [输出文件名模板]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 裸流文件> [最大线程数] [输出文件名模板]\n", argv[0]);
+        return -1;
+    }
+    const int maxThreads = argc > 2 ? atoi(argv[2]) : 4;
+    const char *outputPattern = argc > 3 ? argv[3] : "/tmp/parallel_%05d.jpeg";
+
+    auto decoder = IDecoder::getInstance();
+    ExtractOptions options;
+    options.select = FrameSelect::All;
+
+    double baseMs = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        options.threads = threads;
+        ExtractStats stats;
+        unsigned long long t1 = getCurrentMicros();
+        if (decoder->H265ToJpegSequence(argv[1], outputPattern, options, &stats) < 0) {
+            printf("解码失败！\n");
+            return -1;
+        }
+        unsigned long long t2 = getCurrentMicros();
+        double ms = (t2 - t1) / 1000.0;
+        if (threads == 1) {
+            baseMs = ms;
+        }
+        printf(">>> %d 线程: 解码 %lld 帧，输出 %d 张，耗时 %.3f 毫秒，加速比 %.2f\n", threads, stats.decoded,
+               stats.written, ms, baseMs / ms);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+//
+// 流水线模式的性能测试：对比工作窃取与读取/解码/编码三级流水线的吞吐量，并打印各级、各队列的统计以找出瓶颈
+//
+// 用法：PipelineBenchmark <H264/H265 文件> [张数] [解码线程数] [编码线程数]
+//
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "BenchUtil.h"
+#include "IConvertService.h"
+
+/**
+ * 转换全部项并打印吞吐量
+ * @param name   调度方式名称
+ * @param config 服务配置
+ * @param items  各项
+ * @param stats  流水线的统计
+ * @return
+ */
+static bool run(const char *name, const ConvertServiceConfig &config, const std::vector<ConvertItem> &items,
+                PipelineStats &stats) {
+    auto service = IConvertService::getInstance(config);
+    unsigned long long t1 = getCurrentMicros();
+    std::vector<ConvertResult> results = service->convertBatch(items);
+    unsigned long long t2 = getCurrentMicros();
+    for (auto result : results) {
+        if (result != ConvertResult::Ok) {
+            printf("转换失败！\n");
+            return false;
+        }
+    }
+    stats = service->pipelineStats();
+    printf(">>> %s: %d 个线程，%.1f 张/秒\n", name, service->workerCount(), items.size() * 1e6 / (t2 - t1));
+    return true;
+}
+
+static void printStage(const char *name, const PipelineStageStats &stage) {
+    printf(">>>   %s: %d 个线程，%llu 项，平均每线程忙 %.1f 毫秒\n", name, stage.threads, stage.items,
+           stage.threads > 0 ? stage.busyMicros / 1000.0 / stage.threads : 0);
+}
+
+static void printQueue(const char *name, const PipelineQueueStats &queue) {
+    printf(">>>   %s: 容量 %zu ，最多 %zu ，队列满等待 %.1f 毫秒，队列空等待 %.1f 毫秒\n", name, queue.capacity,
+           queue.maxDepth, queue.fullStallMicros / 1000.0, queue.emptyStallMicros / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 文件> [张数] [解码线程数] [编码线程数]\n", argv[0]);
+        return -1;
+    }
+    const int count = argc > 2 ? atoi(argv[2]) : 200;
+    const int decoderThreads = argc > 3 ? atoi(argv[3]) : 0;
+    const int encoderThreads = argc > 4 ? atoi(argv[4]) : 0;
+
+    std::vector<ConvertItem> items;
+    for (int i = 0; i < count; ++i) {
+        items.push_back(ConvertItem{argv[1], "/tmp/pipeline_" + std::to_string(i) + ".jpeg"});
+    }
+
+    PipelineStats stats;
+    ConvertServiceConfig config;
+    config.scheduling = ConvertScheduling::WorkStealing;
+    if (!run("工作窃取", config, items, stats)) {
+        return -1;
+    }
+
+    config.scheduling = ConvertScheduling::Pipeline;
+    config.decoderThreads = decoderThreads;
+    config.encoderThreads = encoderThreads;
+    if (!run("流水线", config, items, stats)) {
+        return -1;
+    }
+    printStage("读取", stats.reader);
+    printStage("解码", stats.decoder);
+    printStage("编码", stats.encoder);
+    printQueue("读取 -> 解码", stats.read);
+    printQueue("解码 -> 编码", stats.decoded);
+    return 0;
+}
@@ -0,0 +1,109 @@
+//
+// 多分辨率输出的性能测试：对每个输入文件，对比每种分辨率各调用一次 H265ToJpeg（每次都完整解码）
+// 与一次 H265ToJpegPyramid（只解码一次，逐级缩小后并行编码）的单张耗时
+//
+// 用法：PyramidBenchmark <H264/H265 文件>... [-n 张数] [-s 以逗号分隔的最长边，如 0,1024,256]
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 解析以逗号分隔的尺寸列表
+ */
+static std::vector<int> parseSizes(const char *text) {
+    std::vector<int> sizes;
+    std::string item;
+    for (const char *p = text;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                sizes.push_back(atoi(item.c_str()));
+                item.clear();
+            }
+            if (*p == '\0') {
+                break;
+            }
+        } else {
+            item += *p;
+        }
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+    int count = 20;
+    std::vector<int> sizes = {0, 1024, 256};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || sizes.empty()) {
+        printf("用法：%s <H264/H265 文件>... [-n 张数] [-s 以逗号分隔的最长边，如 0,1024,256]\n", argv[0]);
+        return -1;
+    }
+
+    // 每种分辨率一个解码器，与多分辨率输出用同样的输出方式（内存）
+    std::vector<std::shared_ptr<IDecoder>> decoders;
+    for (int size : sizes) {
+        DecoderConfig config;
+        config.maxDimension = size;
+        decoders.push_back(IDecoder::getInstance(config));
+    }
+    auto pyramidDecoder = IDecoder::getInstance();
+    std::vector<MemorySink> sinks(sizes.size());
+    std::vector<PyramidLevel> levels(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        levels[i].maxDimension = sizes[i];
+        levels[i].sink = &sinks[i];
+    }
+
+    for (const char *file : files) {
+        std::vector<unsigned char> data;
+        if (!readWholeFile(file, data)) {
+            return -1;
+        }
+        printf("\n>>> %s ，%zu 种分辨率，%d 张\n", file, sizes.size(), count);
+
+        // 先各转换一次，创建好编码器和转换上下文，不计入耗时
+        std::vector<unsigned char> jpeg;
+        for (auto &decoder : decoders) {
+            if (!decoder->H265ToJpeg(data.data(), data.size(), jpeg)) {
+                printf("解码失败！\n");
+                return -1;
+            }
+        }
+        if (!pyramidDecoder->H265ToJpegPyramid(data.data(), data.size(), levels)) {
+            printf("解码失败！\n");
+            return -1;
+        }
+
+        unsigned long long t1 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            for (auto &decoder : decoders) {
+                decoder->H265ToJpeg(data.data(), data.size(), jpeg);
+            }
+        }
+        unsigned long long t2 = getCurrentMicros();
+        for (int i = 0; i < count; ++i) {
+            pyramidDecoder->H265ToJpegPyramid(data.data(), data.size(), levels);
+        }
+        unsigned long long t3 = getCurrentMicros();
+
+        printf(">>> 分别转换:     %.2f 毫秒/张\n", (t2 - t1) / 1000.0 / count);
+        printf(">>> 多分辨率输出: %.2f 毫秒/张\n", (t3 - t2) / 1000.0 / count);
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            printf(">>>   最长边 %-6s %zu 字节\n", sizes[i] > 0 ? std::to_string(sizes[i]).c_str() : "原尺寸",
+                   sinks[i].size());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+// 按时间间隔取帧的性能测试：对比逐帧解码后挑选、只解码包含取样点的 GOP 、吸附到关键帧三种方式的解码帧数与耗时
+//
+// 用法：SamplingBenchmark <H264/H265 裸流文件> [间隔（秒）] [输出文件名模板]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 运行一次多帧提取并打印统计
+ * @param name          方式名称
+ * @param config        解码器配置
+ * @param inputFilePath 输入文件路径
+ * @param outputPattern 输出文件名模板
+ * @param options       取帧选项
+ * @return
+ */
+static bool run(const char *name, const DecoderConfig &config, const char *inputFilePath,
+                const char *outputPattern, const ExtractOptions &options) {
+    auto decoder = IDecoder::getInstance(config);
+    ExtractStats stats;
+    unsigned long long t1 = getCurrentMicros();
+    if (decoder->H265ToJpegSequence(inputFilePath, outputPattern, options, &stats) < 0) {
+        printf("解码失败！\n");
+        return false;
+    }
+    unsigned long long t2 = getCurrentMicros();
+    printf(">>> %s: 解码 %lld 帧，输出 %d 张，耗时 %.3f 毫秒\n", name, stats.decoded, stats.written,
+           (t2 - t1) / 1000.0);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法：%s <H264/H265 裸流文件> [间隔（秒）] [输出文件名模板]\n", argv[0]);
+        return -1;
+    }
+    const double interval = argc > 2 ? atof(argv[2]) : 10.0;
+    const char *outputPattern = argc > 3 ? argv[3] : "/tmp/sample_%05d.jpeg";
+
+    ExtractOptions options;
+    options.select = FrameSelect::Interval;
+    options.intervalSeconds = interval;
+
+    // 关闭 Annex-B 快速路径时，没有关键帧信息，只能逐帧解码后挑选
+    DecoderConfig config;
+    config.annexBFastPath = false;
+    if (!run("逐帧解码", config, argv[1], outputPattern, options)) {
+        return -1;
+    }
+
+    // 只解码包含取样点的 GOP
+    config.annexBFastPath = true;
+    if (!run("按 GOP 跳转", config, argv[1], outputPattern, options)) {
+        return -1;
+    }
+
+    // 吸附到最近的关键帧，每个取样点只解码一帧
+    options.snapToKeyFrame = true;
+    if (!run("吸附关键帧", config, argv[1], outputPattern, options)) {
+        return -1;
+    }
+    return 0;
+}
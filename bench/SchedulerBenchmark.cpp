@@ -0,0 +1,109 @@
+//
+// 批量转换服务调度方式的性能测试：在大小图混合的输入上，对比 Fifo 与工作窃取（拆分/不拆分编码）的尾延迟和 CPU 利用率
+//
+// 用法：SchedulerBenchmark <小图文件> <大图文件> [张数] [大图比例（%）] [线程数]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include "BenchUtil.h"
+#include "IConvertService.h"
+
+/**
+ * 获取进程已使用的 CPU 时间（用户态 + 内核态，微秒）
+ * @return
+ */
+static unsigned long long getCpuMicros() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (unsigned long long) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+ * 多个客户端线程逐项提交，统计每项的延迟
+ * @param name    调度方式名称
+ * @param config  服务配置
+ * @param items   各项
+ * @param clients 客户端线程数
+ * @return
+ */
+static bool run(const char *name, const ConvertServiceConfig &config, const std::vector<ConvertItem> &items,
+                int clients) {
+    auto service = IConvertService::getInstance(config);
+    std::vector<double> latencies(items.size());
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    unsigned long long cpu1 = getCpuMicros();
+    unsigned long long t1 = getCurrentMicros();
+    std::vector<std::thread> callers;
+    for (int c = 0; c < clients; ++c) {
+        callers.emplace_back([&] {
+            size_t i;
+            while ((i = next++) < items.size()) {
+                unsigned long long start = getCurrentMicros();
+                std::vector<ConvertResult> results = service->convertBatch({items[i]});
+                latencies[i] = (getCurrentMicros() - start) / 1000.0;
+                if (results[0] != ConvertResult::Ok) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+    unsigned long long t2 = getCurrentMicros();
+    unsigned long long cpu2 = getCpuMicros();
+    if (failed) {
+        printf("转换失败！\n");
+        return false;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    printf(">>> %s: %.1f 张/秒，延迟 p50 %.1f / p99 %.1f / 最大 %.1f 毫秒，CPU 利用率 %.0f%%\n", name,
+           n * 1e6 / (t2 - t1), latencies[n / 2], latencies[std::min(n - 1, n * 99 / 100)], latencies[n - 1],
+           100.0 * (cpu2 - cpu1) / (t2 - t1) / service->workerCount());
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("用法：%s <小图文件> <大图文件> [张数] [大图比例（%%）] [线程数]\n", argv[0]);
+        return -1;
+    }
+    const int count = argc > 3 ? atoi(argv[3]) : 200;
+    const int largePercent = argc > 4 ? atoi(argv[4]) : 5;
+    const int threads = argc > 5 ? atoi(argv[5]) : (int) std::thread::hardware_concurrency();
+
+    // 大图均匀地夹在小图之间
+    std::vector<ConvertItem> items;
+    for (int i = 0; i < count; ++i) {
+        bool large = largePercent > 0 && i * largePercent / 100 != (i + 1) * largePercent / 100;
+        items.push_back(ConvertItem{large ? argv[2] : argv[1], "/tmp/scheduler_" + std::to_string(i) + ".jpeg"});
+    }
+    printf(">>> 张数: %d ，大图比例: %d%% ，线程数: %d\n", count, largePercent, threads);
+
+    ConvertServiceConfig config;
+    config.workers = threads;
+    config.scheduling = ConvertScheduling::Fifo;
+    if (!run("Fifo", config, items, threads * 2)) {
+        return -1;
+    }
+    config.scheduling = ConvertScheduling::WorkStealing;
+    config.splitEncode = false;
+    if (!run("工作窃取", config, items, threads * 2)) {
+        return -1;
+    }
+    config.splitEncode = true;
+    if (!run("工作窃取+拆分编码", config, items, threads * 2)) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+// 随机访问的性能测试：对比每次扫描码流与使用关键帧索引文件时，按序号提取单帧的耗时
+//
+// 用法：SeekBenchmark <H264/H265 裸流文件> <帧数> [次数]
+//
+
+#include <cstdlib>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 统计一种配置下按随机序号提取单帧的平均耗时
+ * @param config    解码器配置
+ * @param filePath  输入文件路径
+ * @param times     次数
+ * @param frameMax  序号的范围
+ * @return 平均耗时（毫秒），失败返回负值
+ */
+static double measure(const DecoderConfig &config, const char *filePath, int times, long long frameMax) {
+    auto decoder = IDecoder::getInstance(config);
+    srand(1);
+    unsigned long long t1 = getCurrentMicros();
+    for (int i = 0; i < times; ++i) {
+        if (!decoder->H265ToJpegAtFrame(filePath, rand() % frameMax, "/tmp/seek.jpeg")) {
+            printf("解码失败！\n");
+            return -1;
+        }
+    }
+    unsigned long long t2 = getCurrentMicros();
+    return (t2 - t1) / 1000.0 / times;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("用法：%s <H264/H265 裸流文件> <帧数> [次数]\n", argv[0]);
+        return -1;
+    }
+    const long long frameMax = atoll(argv[2]);
+    const int times = argc > 3 ? atoi(argv[3]) : 20;
+
+    DecoderConfig config;
+    config.persistent = true;
+    config.keyFrameIndexCache = false;
+    double scanMs = measure(config, argv[1], times, frameMax);
+    if (scanMs < 0) {
+        return -1;
+    }
+
+    // 第一次访问时建立索引文件，之后的每次访问都直接映射
+    config.keyFrameIndexCache = true;
+    double indexMs = measure(config, argv[1], times, frameMax);
+    if (indexMs < 0) {
+        return -1;
+    }
+
+    printf(">>> 次数: %d\n", times);
+    printf(">>> 扫描码流: %.3f 毫秒/张\n", scanMs);
+    printf(">>> 关键帧索引: %.3f 毫秒/张\n", indexMs);
+    return 0;
+}
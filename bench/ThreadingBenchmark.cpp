@@ -0,0 +1,115 @@
+//
+// 解码线程策略的性能测试：对每个输入文件，在不同的并发解码器数下对比 Throughput 、Latency 、Auto 三种策略的
+// 单张延迟和总吞吐。并发为 1 时看延迟（Latency 应最低），并发等于 CPU 核数时看吞吐（Throughput 应最高），
+// Auto 在两端都应接近较好的一方
+//
+// 用法：ThreadingBenchmark <H264/H265 文件>... [-n 每个线程的张数] [-c 最大并发数]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 并发的多个线程各自用一个解码器，循环把同一份数据解码为 Jpeg
+ * @param data        输入数据
+ * @param threading   线程策略
+ * @param concurrency 并发的线程数
+ * @param count       每个线程的张数
+ * @param latencyMs   单张的平均耗时（毫秒）
+ * @return 总吞吐（张/秒），失败返回 -1
+ */
+static double run(const std::vector<unsigned char> &data, DecodeThreading threading, int concurrency, int count,
+                  double &latencyMs) {
+    DecoderConfig config;
+    config.threading = threading;
+    std::atomic<bool> failed(false);
+    unsigned long long busyMicros = 0;
+
+    unsigned long long t1 = getCurrentMicros();
+    std::vector<std::thread> callers;
+    std::vector<unsigned long long> busy((size_t) concurrency, 0);
+    for (int t = 0; t < concurrency; ++t) {
+        callers.emplace_back([&, t] {
+            auto decoder = IDecoder::getInstance(config);
+            std::vector<unsigned char> jpeg;
+            for (int i = 0; i < count; ++i) {
+                unsigned long long start = getCurrentMicros();
+                if (!decoder->H265ToJpeg(data.data(), data.size(), jpeg)) {
+                    failed = true;
+                    return;
+                }
+                busy[t] += getCurrentMicros() - start;
+            }
+        });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+    unsigned long long t2 = getCurrentMicros();
+    if (failed) {
+        return -1;
+    }
+
+    for (auto micros : busy) {
+        busyMicros += micros;
+    }
+    latencyMs = busyMicros / 1000.0 / (concurrency * count);
+    return concurrency * count * 1e6 / (t2 - t1);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+    int count = 20;
+    int maxConcurrency = (int) std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            maxConcurrency = atoi(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        printf("用法：%s <H264/H265 文件>... [-n 每个线程的张数] [-c 最大并发数]\n", argv[0]);
+        return -1;
+    }
+    maxConcurrency = std::max(1, maxConcurrency);
+
+    const DecodeThreading policies[] = {DecodeThreading::Throughput, DecodeThreading::Latency,
+                                        DecodeThreading::Auto};
+    const char *names[] = {"Throughput", "Latency", "Auto"};
+
+    printf(">>> CPU 核数: %u ，每个线程 %d 张\n", std::thread::hardware_concurrency(), count);
+    for (const char *file : files) {
+        std::vector<unsigned char> data;
+        if (!readWholeFile(file, data)) {
+            return -1;
+        }
+        printf("\n>>> %s\n", file);
+        printf("%-12s %8s %14s %14s\n", "策略", "并发", "延迟(毫秒/张)", "吞吐(张/秒)");
+
+        // 并发数 1 、2 、4 ... 直到最大并发数
+        for (int concurrency = 1;; concurrency = std::min(concurrency * 2, maxConcurrency)) {
+            for (int p = 0; p < 3; ++p) {
+                double latencyMs = 0;
+                double throughput = run(data, policies[p], concurrency, count, latencyMs);
+                if (throughput < 0) {
+                    printf("解码失败！\n");
+                    return -1;
+                }
+                printf("%-12s %8d %14.2f %14.1f\n", names[p], concurrency, latencyMs, throughput);
+            }
+            if (concurrency >= maxConcurrency) {
+                break;
+            }
+        }
+    }
+    return 0;
+}
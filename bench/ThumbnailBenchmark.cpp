@@ -0,0 +1,83 @@
+//
+// 缩略图模式的性能测试：对每个输入文件，在不同的 maxDimension 下把同一份数据循环转换为 Jpeg ，
+// 对比单张耗时（解码 + 缩小 + 编码）和输出大小。0 表示原尺寸；能整除的尺寸走 SIMD 盒式滤波，其他走 swscale
+//
+// 用法：ThumbnailBenchmark <H264/H265 文件>... [-n 张数] [-s 以逗号分隔的最长边，如 0,1280,640,320]
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "BenchUtil.h"
+#include "IDecoder.h"
+
+/**
+ * 解析以逗号分隔的尺寸列表
+ */
+static std::vector<int> parseSizes(const char *text) {
+    std::vector<int> sizes;
+    std::string item;
+    for (const char *p = text;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                sizes.push_back(atoi(item.c_str()));
+                item.clear();
+            }
+            if (*p == '\0') {
+                break;
+            }
+        } else {
+            item += *p;
+        }
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+    int count = 20;
+    std::vector<int> sizes = {0, 1280, 1000, 640, 320};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        printf("用法：%s <H264/H265 文件>... [-n 张数] [-s 以逗号分隔的最长边，如 0,1280,640,320]\n", argv[0]);
+        return -1;
+    }
+
+    for (const char *file : files) {
+        std::vector<unsigned char> data;
+        if (!readWholeFile(file, data)) {
+            return -1;
+        }
+        printf("\n>>> %s ，每种尺寸 %d 张\n", file, count);
+        printf("%-14s %14s %14s\n", "最长边", "耗时(毫秒/张)", "大小(字节)");
+
+        for (int size : sizes) {
+            DecoderConfig config;
+            config.maxDimension = size;
+            auto decoder = IDecoder::getInstance(config);
+            std::vector<unsigned char> jpeg;
+
+            // 先转换一次，创建好编码器和转换上下文，不计入耗时
+            if (!decoder->H265ToJpeg(data.data(), data.size(), jpeg)) {
+                printf("解码失败！\n");
+                return -1;
+            }
+            unsigned long long t1 = getCurrentMicros();
+            for (int i = 0; i < count; ++i) {
+                decoder->H265ToJpeg(data.data(), data.size(), jpeg);
+            }
+            unsigned long long t2 = getCurrentMicros();
+            printf("%-14s %14.2f %14zu\n", size > 0 ? std::to_string(size).c_str() : "原尺寸",
+                   (t2 - t1) / 1000.0 / count, jpeg.size());
+        }
+    }
+    return 0;
+}
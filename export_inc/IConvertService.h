@@ -0,0 +1,189 @@
+#ifndef H265TOJPEG_ICONVERTSERVICE_H
+#define H265TOJPEG_ICONVERTSERVICE_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IDecoder.h"
+
+
+/**
+ * 批量转换的一项
+ */
+struct ConvertItem {
+    std::string inputFilePath;  /* 输入的 H264/H265 文件路径 */
+    std::string outputFilePath; /* 输出的 Jpeg 文件路径 */
+};
+
+
+/**
+ * 单项的转换结果
+ */
+enum class ConvertResult {
+    Ok,              /* 成功 */
+    InvalidArgument, /* 输入或输出路径为空 */
+    InputNotFound,   /* 输入文件不存在或不可读 */
+    Failed           /* 解码或编码失败 */
+};
+
+
+/**
+ * 批量转换服务的调度方式
+ */
+enum class ConvertScheduling {
+    Fifo,         /* 各工作线程按提交顺序依次领取下一项 */
+    WorkStealing, /* 每个工作线程有自己的任务队列，空闲时从其他线程窃取任务 */
+    Pipeline      /* 读取、解码、编码三级流水线，各级有自己的线程，之间用有界的无锁队列传递 */
+};
+
+
+/**
+ * 批量转换服务的配置
+ */
+struct ConvertServiceConfig {
+    /**
+     * 工作线程数，为 0 时使用全部 CPU 核
+     */
+    int workers = 0;
+
+    /**
+     * 调度方式
+     */
+    ConvertScheduling scheduling = ConvertScheduling::WorkStealing;
+
+    /**
+     * 是否把每一项拆成解码、编码两个任务（只对 WorkStealing 有效）。
+     * 拆分后，大图的编码可以被空闲的线程取走，与同一线程上后续项的解码并行
+     */
+    bool splitEncode = true;
+
+    /**
+     * 流水线读取文件的线程数（只对 Pipeline 有效）
+     */
+    int readerThreads = 1;
+
+    /**
+     * 流水线解码的线程数，为 0 时取 workers 的一半（只对 Pipeline 有效）
+     */
+    int decoderThreads = 0;
+
+    /**
+     * 流水线编码的线程数，为 0 时取 workers 的一半（只对 Pipeline 有效）
+     */
+    int encoderThreads = 0;
+
+    /**
+     * 流水线各级之间队列的容量，决定同时在途的文件数和帧数（只对 Pipeline 有效）
+     */
+    int queueCapacity = 16;
+
+    /**
+     * 每个工作线程的解码器配置。工作线程的解码器总是常驻的，persistent 不起作用；
+     * 线程策略为 Auto 时按 Throughput 处理，每个解码器单线程。
+     * 指定 jpegQscale 后各线程的编码器也常驻，大量同分辨率的图片省去每张新建编码器的开销
+     */
+    DecoderConfig decoder;
+};
+
+
+/**
+ * 流水线中一级的统计
+ */
+struct PipelineStageStats {
+    int threads;                   /* 线程数 */
+    unsigned long long items;      /* 已处理的项数 */
+    unsigned long long busyMicros; /* 各线程处理的总时间（微秒），不含等待队列的时间 */
+};
+
+
+/**
+ * 流水线中一个队列的统计。
+ * 生产者因队列满等待的时间长，说明下游是瓶颈；消费者因队列空等待的时间长，说明上游是瓶颈
+ */
+struct PipelineQueueStats {
+    size_t capacity;                     /* 容量 */
+    size_t depth;                        /* 当前的元素个数 */
+    size_t maxDepth;                     /* 最多时的元素个数 */
+    unsigned long long fullStallMicros;  /* 生产者因队列满等待的总时间（微秒） */
+    unsigned long long emptyStallMicros; /* 消费者因队列空等待的总时间（微秒） */
+};
+
+
+/**
+ * 流水线的统计
+ */
+struct PipelineStats {
+    PipelineStageStats reader;  /* 读取文件 */
+    PipelineStageStats decoder; /* 解码 */
+    PipelineStageStats encoder; /* 编码并保存 */
+    PipelineQueueStats input;   /* 提交 -> 读取 */
+    PipelineQueueStats read;    /* 读取 -> 解码，传递文件内容 */
+    PipelineQueueStats decoded; /* 解码 -> 编码，传递引用计数的 AVFrame */
+};
+
+
+/**
+ * 批量转换服务。
+ * 内部是固定数量的工作线程，每个线程持有常驻的解码器，处理各项时不再重复创建。
+ * Jpeg 编码器只有在 decoder.jpegQscale 大于 0 时才按线程缓存复用；默认使用码率控制，编码器的状态会带到下一张图，
+ * 每一项仍新建一个编码器。
+ * 实例是线程安全的，多个线程（如多个 JNI 线程）可以共用一个实例同时提交。
+ * 实例销毁时会等待已提交的转换（包括异步提交的）全部完成
+ */
+class IConvertService {
+
+public:
+
+    IConvertService() = default;
+
+    virtual ~IConvertService() = default;
+
+    /**
+     * 批量将 H264/H265 文件解码为 Jpeg ，各项分给工作线程并行处理，全部完成后返回
+     * @param items 输入、输出文件路径
+     * @return 各项的转换结果，与 items 一一对应
+     */
+    virtual std::vector<ConvertResult> convertBatch(const std::vector<ConvertItem> &items) = 0;
+
+    /**
+     * 异步将 H264/H265 文件解码为 Jpeg ，立即返回。少量调用线程即可同时提交大量转换
+     * @param item 输入、输出文件路径
+     * @return 转换结果
+     */
+    virtual std::future<ConvertResult> convertAsync(const ConvertItem &item) = 0;
+
+    /**
+     * 异步将 H264/H265 文件解码为 Jpeg ，立即返回，完成后调用回调
+     * @param item     输入、输出文件路径
+     * @param callback 完成时的回调，在服务的工作线程中调用，不应长时间阻塞
+     */
+    virtual void convertAsync(const ConvertItem &item, std::function<void(ConvertResult)> callback) = 0;
+
+    /**
+     * @return 工作线程数
+     */
+    virtual int workerCount() const = 0;
+
+    /**
+     * 获取流水线各级和各队列的统计，用于判断哪一级是瓶颈
+     * @return 不是 Pipeline 调度时全为 0
+     */
+    virtual PipelineStats pipelineStats() const = 0;
+
+    /**
+     * 获取实例，使用全部 CPU 核。注意：不是单例！工作线程随实例一起创建和销毁
+     * @return
+     */
+    static std::shared_ptr<IConvertService> getInstance();
+
+    /**
+     * 按配置获取实例。注意：不是单例！
+     * @param config 服务配置
+     * @return
+     */
+    static std::shared_ptr<IConvertService> getInstance(const ConvertServiceConfig &config);
+};
+
+#endif //H265TOJPEG_ICONVERTSERVICE_H
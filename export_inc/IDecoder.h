@@ -7,6 +7,247 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
+#include "OutputSink.h"
+
+
+/**
+ * 输入的编码格式
+ */
+enum class InputCodec {
+    Auto, /* 自动探测 */
+    H264,
+    H265
+};
+
+
+/**
+ * 解码器的线程策略
+ */
+enum class DecodeThreading {
+    Auto,      /* 按分辨率、码流能否按 slice/WPP 并行以及进程内已打开的解码器数自动选择 Latency 或 Throughput */
+    Latency,   /* slice 线程：多个线程共同解码同一帧，不增加帧延迟，单张大图的延迟最低 */
+    Throughput /* 每个解码器只用一个线程，由多个解码器（多个实例、并行解码、批量转换服务）同时工作提高吞吐 */
+};
+
+
+/**
+ * 解码器配置
+ */
+struct DecoderConfig {
+    /**
+     * 是否常驻（复用解码器上下文）。
+     * 开启后，多次调用之间保留已打开的 AVCodecContext 、AVFrame 和 AVPacket ，只在编码格式或分辨率变化时重建。
+     * 适合用同一个实例连续转换大量同格式、同分辨率的图片。注意：实例不是线程安全的
+     */
+    bool persistent = false;
+
+    /**
+     * 是否对 Annex-B 裸流（.h264/.h265 文件）走快速路径。
+     * 开启后，以起始码开头的输入直接用 av_parser 切分后送入解码器，跳过 avformat 的打开和探测
+     */
+    bool annexBFastPath = true;
+
+    /**
+     * 输入的编码格式。调用方已知格式时指定为 H264 或 H265 ，跳过格式探测，直接使用对应的解复用器和解码器
+     */
+    InputCodec codec = InputCodec::Auto;
+
+    /**
+     * avformat 探测时最多读取的字节数，为 0 时使用 FFmpeg 的默认值（5000000）。最小为 32
+     */
+    long long probeSize = 0;
+
+    /**
+     * avformat_find_stream_info 最多分析的时长（微秒），为 0 时使用 FFmpeg 的默认值（5 秒）
+     */
+    long long analyzeDuration = 0;
+
+    /**
+     * 是否调用 avformat_find_stream_info 。
+     * 对 H264/H265 裸流，解码器能从码流的参数集中得到全部参数，关闭后可省去探测时的试解码
+     */
+    bool findStreamInfo = true;
+
+    /**
+     * 是否缓存裸流文件的关键帧索引。
+     * 开启后，按时间/序号提取、按间隔取帧和并行解码第一次访问某个文件时，把关键帧的位置保存到同目录下的
+     * <文件名>.kfi 中，以文件的长度和修改时间校验。之后的随机访问直接映射索引文件，不再扫描整个码流。
+     * 会在输入文件所在的目录中写文件，需要该目录可写，默认关闭；关闭时索引只在内存中建立
+     */
+    bool keyFrameIndexCache = false;
+
+    /**
+     * 解码器的线程策略，在创建解码器上下文时决定，常驻模式下复用的上下文保持原来的线程数。
+     * 不使用帧线程：帧线程让输出至少延后一帧，对单张图片没有帮助。
+     * slice 线程只对能并行的码流有效：H265 需开启 WPP（FFmpeg 对开启 tiles 的图像退回单线程），H264 需一帧分成多个 slice
+     */
+    DecodeThreading threading = DecodeThreading::Auto;
+
+    /**
+     * Latency 策略（以及 Auto 选择 slice 线程时）的线程数上限，为 0 时使用全部 CPU 核
+     */
+    int decodeThreads = 0;
+
+    /**
+     * 输出图片的最长边（像素），为 0 时保持原始分辨率。
+     * 原图超过时先按比例缩小解码出的 YUV 再编码，适合只需要预览图的场景，编码耗时和输出大小都随之下降。
+     * 原图的宽高正好是目标的整数倍（如 1920x1080 、2560x1440 缩小到 640）时用 SIMD 的盒式滤波，否则用 swscale 的双三次插值
+     */
+    int maxDimension = 0;
+
+    /**
+     * Jpeg 编码的量化参数（1~31 ，越小质量越高、文件越大），为 0 时由码率控制按图像内容选择。
+     * 码率控制会把上一张图的结果带到下一张，编码器不能复用，每张图都重新创建和打开编码器；
+     * 指定固定值后，编码器按分辨率缓存在各线程中复用，大量同分辨率的图片可以省去打开编码器的开销
+     */
+    int jpegQscale = 0;
+};
+
+
+/**
+ * 多帧提取时选取帧的方式
+ */
+enum class FrameSelect {
+    All,      /* 每一帧 */
+    EveryNth, /* 每 interval 帧取一帧 */
+    KeyFrames, /* 只取关键帧，非关键帧由解码器直接丢弃，不做解码 */
+    Interval  /* 每 intervalSeconds 秒取一帧，只解码包含取样点的 GOP */
+};
+
+
+/**
+ * 多帧提取的选项
+ */
+struct ExtractOptions {
+    FrameSelect select = FrameSelect::All;
+
+    /**
+     * select 为 EveryNth 时的间隔，取第 0 、interval 、2*interval ... 帧
+     */
+    int interval = 1;
+
+    /**
+     * select 为 Interval 时的取样间隔（秒），取第 0 、intervalSeconds 、2*intervalSeconds ... 秒的帧
+     */
+    double intervalSeconds = 1.0;
+
+    /**
+     * select 为 Interval 时，是否用离取样点最近的关键帧代替取样点的帧。
+     * 开启后每个取样点只需解码一个关键帧，适合对时间精度要求不高的缩略图。
+     * 只对 Annex-B 裸流（快速路径）有效，其他输入逐帧解码后按取样点挑选
+     */
+    bool snapToKeyFrame = false;
+
+    /**
+     * 最多输出的图片数，达到后立即停止读取，为 0 时不限制
+     */
+    int maxFrames = 0;
+
+    /**
+     * 并行解码的线程数，为 0 时使用全部 CPU 核。
+     * 大于 1 时，Annex-B 裸流按 IDR 帧切分成互不依赖的 GOP 段，每个线程用各自的解码器解码、编码不同的段，
+     * 输出文件的序号与单线程时一致。只对 All 和 EveryNth 有效
+     */
+    int threads = 1;
+};
+
+
+/**
+ * 多帧提取的统计
+ */
+struct ExtractStats {
+    long long decoded; /* 解码出的帧数 */
+    int written;       /* 输出的图片数 */
+};
+
+
+/**
+ * 多分辨率输出中的一级
+ */
+struct PyramidLevel {
+    /**
+     * 输出图片的最长边（像素），为 0 时保持原始分辨率
+     */
+    int maxDimension = 0;
+
+    /**
+     * 输出的 Jpeg 文件路径，sink 为 nullptr 时有效
+     */
+    const char *outputFilePath = nullptr;
+
+    /**
+     * 输出端，由调用方管理生命周期。不为 nullptr 时优先于 outputFilePath
+     */
+    IOutputSink *sink = nullptr;
+};
+
+
+/**
+ * 从解码出的图像中裁剪的区域
+ */
+struct CropRegion {
+    int x = 0;      /* 左上角的横坐标（像素） */
+    int y = 0;      /* 左上角的纵坐标（像素） */
+    int width = 0;  /* 宽度（像素） */
+    int height = 0; /* 高度（像素） */
+
+    /**
+     * 输出图片的最长边（像素），裁剪结果超过时先缩小再编码。为 0 时保持裁剪的大小
+     */
+    int maxDimension = 0;
+
+    /**
+     * 输出的 Jpeg 文件路径，sink 为 nullptr 时有效
+     */
+    const char *outputFilePath = nullptr;
+
+    /**
+     * 输出端，由调用方管理生命周期。不为 nullptr 时优先于 outputFilePath
+     */
+    IOutputSink *sink = nullptr;
+};
+
+
+/**
+ * 直接输出像素时的格式
+ */
+enum class PixelOutput {
+    Native, /* 解码器输出的原始格式（如 yuv420p 、yuv420p10le），不做任何转换和拷贝 */
+    Rgb24,  /* 按 R 、G 、B 顺序打包的 24 位 RGB */
+    Bgr24   /* 按 B 、G 、R 顺序打包的 24 位 RGB（OpenCV 的默认顺序） */
+};
+
+
+/**
+ * 解码出的一帧图像。
+ * 各平面的数据引用解码器输出的帧缓冲（Native）或转换出的 RGB 缓冲，拷贝本结构体只增加引用计数，不拷贝像素，
+ * 最后一份拷贝销毁时释放缓冲。像素只读，可以交给其他线程使用
+ */
+struct DecodedFrame {
+    int width = 0;                      /* 宽度（像素） */
+    int height = 0;                     /* 高度（像素） */
+    int format = -1;                    /* 像素格式，取值同 FFmpeg 的 AVPixelFormat */
+    const char *formatName = nullptr;   /* 像素格式的名称，如 yuv420p 、rgb24 */
+    int planes = 0;                     /* 平面数，YUV 平面格式为 3 ，RGB 为 1 */
+    const unsigned char *data[4] = {};  /* 各平面的数据 */
+    int linesize[4] = {};               /* 各平面每行的字节数，可能大于有效的像素宽度 */
+    std::shared_ptr<void> owner;        /* 持有帧缓冲的引用 */
+};
+
+
+/**
+ * 编码输出的分配统计（进程内所有线程汇总）。
+ * 统计新建的 AVPacket 结构和 ffmpeg 为每张 Jpeg 分配的数据包缓冲：MJPEG 编码器先写入内部缓冲，
+ * 再分配一块与 Jpeg 等大的缓冲拷贝出来，因此稳定运行后每张图片仍有一次申请。不含编码器上下文内部的申请。
+ * 另外统计新建的编码器个数：使用码率控制（DecoderConfig::jpegQscale 为 0）时每张图片新建一个，指定固定值后按规格复用
+ */
+struct AllocationStats {
+    unsigned long long encodes;         /* 编码次数 */
+    unsigned long long heapAllocations; /* 申请内存的次数 */
+    unsigned long long heapBytes;       /* 申请的总字节数 */
+    unsigned long long encoderOpens;    /* 新建并打开的 Jpeg 编码器个数 */
+};
 
 
 /**
@@ -28,12 +269,143 @@ public:
      */
     virtual bool H265ToJpeg(const char *inputFilePath, const char *outputFilePath) = 0;
 
+    /**
+     * 将内存中的 H264/H265 数据解码为 Jpeg 数据，全程不读写文件
+     * @param inputData 输入的 H264/H265 数据
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @param jpegData  输出的 Jpeg 数据
+     * @return
+     */
+    virtual bool H265ToJpeg(const unsigned char *inputData, size_t inputSize, std::vector<unsigned char> &jpegData) = 0;
+
+    /**
+     * 将 H264/H265 文件解码为 Jpeg ，输出到指定的输出端（内存、文件描述符、mmap 文件、回调等）
+     * 整张 Jpeg 编码完成后一次性交给输出端（IOutputSink::writeJpeg），编码器不分块输出，CallbackSink 只回调一次
+     * @param inputFilePath 输入的 H264/H265 文件路径
+     * @param sink          Jpeg 输出端
+     * @return
+     */
+    virtual bool H265ToJpeg(const char *inputFilePath, IOutputSink &sink) = 0;
+
+    /**
+     * 将内存中的 H264/H265 数据解码为 Jpeg ，输出到指定的输出端
+     * @param inputData 输入的 H264/H265 数据
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @param sink      Jpeg 输出端
+     * @return
+     */
+    virtual bool H265ToJpeg(const unsigned char *inputData, size_t inputSize, IOutputSink &sink) = 0;
+
+    /**
+     * 将 H264/H265 解码为多种分辨率的 Jpeg（如原图、1024 、256）。只解码一次，
+     * 从大到小逐级缩小（每一级由上一级缩小而来），再并行编码各级。DecoderConfig::maxDimension 对此无效
+     * @param inputFilePath 输入的 H264/H265 文件路径
+     * @param levels        各级的尺寸和输出，顺序任意
+     * @return 任何一级失败时返回 false
+     */
+    virtual bool H265ToJpegPyramid(const char *inputFilePath, const std::vector<PyramidLevel> &levels) = 0;
+
+    /**
+     * 将内存中的 H264/H265 数据解码为多种分辨率的 Jpeg ，同上
+     * @param inputData 输入的 H264/H265 数据
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @param levels    各级的尺寸和输出，顺序任意
+     * @return 任何一级失败时返回 false
+     */
+    virtual bool H265ToJpegPyramid(const unsigned char *inputData, size_t inputSize,
+                                   const std::vector<PyramidLevel> &levels) = 0;
+
+    /**
+     * 将 H264/H265 解码一次，从图像中裁剪出多个区域，分别编码为 Jpeg 。
+     * 裁剪只移动各平面的数据指针，不拷贝像素；色度平面有下采样时，区域的边界向外扩展到色度像素的边界（如 4:2:0 为偶数），
+     * 超出图像的部分被截掉。DecoderConfig::jpegQscale 大于 0 时，大小相同的区域复用同一个编码器上下文；
+     * 为 0（默认）时码率控制的状态会带到下一张图，每个区域都新建编码器。DecoderConfig::maxDimension 对此无效
+     * @param inputFilePath 输入的 H264/H265 文件路径
+     * @param regions       裁剪的区域和输出，顺序任意
+     * @return 任何一个区域失败时返回 false ，其余区域仍会输出
+     */
+    virtual bool H265ToJpegCrops(const char *inputFilePath, const std::vector<CropRegion> &regions) = 0;
+
+    /**
+     * 将内存中的 H264/H265 数据解码一次，裁剪出多个区域分别编码为 Jpeg ，同上
+     * @param inputData 输入的 H264/H265 数据
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @param regions   裁剪的区域和输出，顺序任意
+     * @return 任何一个区域失败时返回 false ，其余区域仍会输出
+     */
+    virtual bool H265ToJpegCrops(const unsigned char *inputData, size_t inputSize,
+                                 const std::vector<CropRegion> &regions) = 0;
+
+    /**
+     * 将 H264/H265 解码为像素，不做 Jpeg 编码。适合直接处理像素的调用方（如模型推理），省去 Jpeg 的编码和再解码
+     * @param inputFilePath 输入的 H264/H265 文件路径
+     * @param decoded       解码出的图像
+     * @param output        输出的像素格式，Native 时直接引用解码器输出的帧，不做拷贝
+     * @return
+     */
+    virtual bool H265ToFrame(const char *inputFilePath, DecodedFrame &decoded,
+                             PixelOutput output = PixelOutput::Native) = 0;
+
+    /**
+     * 将内存中的 H264/H265 数据解码为像素，不做 Jpeg 编码，同上
+     * @param inputData 输入的 H264/H265 数据
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @param decoded   解码出的图像
+     * @param output    输出的像素格式，Native 时直接引用解码器输出的帧，不做拷贝
+     * @return
+     */
+    virtual bool H265ToFrame(const unsigned char *inputData, size_t inputSize, DecodedFrame &decoded,
+                             PixelOutput output = PixelOutput::Native) = 0;
+
+    /**
+     * 从 H264/H265 视频中提取多帧，分别保存为 Jpeg 。整个视频只打开、解码一遍
+     * @param inputFilePath 输入的 H264/H265 文件路径
+     * @param outputPattern 输出的 Jpeg 文件名模板，需包含一个帧序号（如 /tmp/out_%04d.jpeg ），序号从 1 开始
+     * @param options       选取帧的方式
+     * @param stats         解码、输出的帧数统计，可为 nullptr
+     * @return 输出的图片数，失败返回 -1
+     */
+    virtual int H265ToJpegSequence(const char *inputFilePath, const char *outputPattern,
+                                   const ExtractOptions &options, ExtractStats *stats = nullptr) = 0;
+
+    /**
+     * 将 H264/H265 视频中指定时间的帧解码为 Jpeg 。
+     * 先定位到该时间之前最近的关键帧，再向后解码到目标帧，只需解码一个 GOP 内的帧
+     * @param inputFilePath  输入的 H264/H265 文件路径
+     * @param seconds        目标时间（秒，相对于视频开头）
+     * @param outputFilePath 输出的 Jpeg 文件路径
+     * @return 目标超出视频时长时返回 false
+     */
+    virtual bool H265ToJpegAt(const char *inputFilePath, double seconds, const char *outputFilePath) = 0;
+
+    /**
+     * 将 H264/H265 视频中指定序号的帧解码为 Jpeg 。按帧率换算为时间后定位，同 H265ToJpegAt
+     * @param inputFilePath  输入的 H264/H265 文件路径
+     * @param frameIndex     目标帧序号，从 0 开始
+     * @param outputFilePath 输出的 Jpeg 文件路径
+     * @return 目标超出视频时长时返回 false
+     */
+    virtual bool H265ToJpegAtFrame(const char *inputFilePath, long long frameIndex, const char *outputFilePath) = 0;
+
     /**
      * 获取子类实例。注意：不是单例！
      * @return 子类对象的智能指针
      */
     static std::shared_ptr<IDecoder> getInstance();
 
+    /**
+     * 按配置获取子类实例。注意：不是单例！
+     * @param config 解码器配置
+     * @return 子类对象的智能指针
+     */
+    static std::shared_ptr<IDecoder> getInstance(const DecoderConfig &config);
+
+    /**
+     * 获取编码输出缓冲的分配统计
+     * @return
+     */
+    static AllocationStats getAllocationStats();
+
     /**
      * 释放单例
      */
@@ -0,0 +1,235 @@
+#ifndef H265TOJPEG_OUTPUTSINK_H
+#define H265TOJPEG_OUTPUTSINK_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+/**
+ * Jpeg 输出接口。
+ * 编码器在整张 Jpeg 编码完成后调用一次 writeJpeg() ，把编码结果的缓冲按引用交出。
+ * 默认实现按 begin() -> write() -> end() 的顺序输出，write() 拿到的指针只在调用期间有效；
+ * 需要保留数据的输出端可以重写 writeJpeg() ，持有引用而不拷贝
+ */
+class IOutputSink {
+
+public:
+
+    IOutputSink() = default;
+
+    virtual ~IOutputSink() = default;
+
+    /**
+     * 开始输出一张 Jpeg
+     * @param totalSize Jpeg 的总长度，可用于预分配空间
+     * @return
+     */
+    virtual bool begin(size_t totalSize) = 0;
+
+    /**
+     * 输出一段 Jpeg 数据
+     * @param data 数据
+     * @param size 数据长度
+     * @return
+     */
+    virtual bool write(const unsigned char *data, size_t size) = 0;
+
+    /**
+     * 结束输出
+     * @return
+     */
+    virtual bool end() = 0;
+
+    /**
+     * 输出一张完整的 Jpeg
+     * @param data 编码结果的缓冲，输出端可以一直持有，不会被编码器改写
+     * @param size 数据长度
+     * @return
+     */
+    virtual bool writeJpeg(const std::shared_ptr<const unsigned char> &data, size_t size) {
+        return begin(size) && write(data.get(), size) && end();
+    }
+};
+
+
+/**
+ * 输出到内存。
+ * 编码器交出的 Jpeg 直接持有其缓冲的引用，不做拷贝；通过 begin()/write() 写入的数据放在可增长的缓冲中，
+ * 多次使用时保留已有容量，只在放不下时按倍数扩容，不会越界也不设上限。
+ * writeJpeg() 之后不调用 begin() 直接 write() 时，先把持有的数据拷贝到自己的缓冲中，新数据追加在其后
+ */
+class MemorySink : public IOutputSink {
+
+public:
+
+    MemorySink() = default;
+
+    ~MemorySink() override;
+
+    MemorySink(const MemorySink &obj) = delete;
+
+    MemorySink &operator=(const MemorySink &obj) = delete;
+
+    bool begin(size_t totalSize) override;
+
+    bool write(const unsigned char *data, size_t size) override;
+
+    bool end() override;
+
+    bool writeJpeg(const std::shared_ptr<const unsigned char> &data, size_t size) override;
+
+    /**
+     * 获取输出的数据，在下一次输出或析构前有效
+     * @return
+     */
+    const unsigned char *data() const {
+        return shared ? shared.get() : buf;
+    }
+
+    /**
+     * 获取输出的数据长度
+     * @return
+     */
+    size_t size() const {
+        return len;
+    }
+
+private:
+
+    /**
+     * 保证容量至少为 required
+     * @return
+     */
+    bool reserve(size_t required);
+
+    unsigned char *buf = nullptr;   /* 缓冲 */
+    size_t len = 0;                 /* 数据长度 */
+    size_t cap = 0;                 /* 缓冲容量 */
+    std::shared_ptr<const unsigned char> shared;   /* 编码器交出的缓冲，不为空时数据在这里 */
+};
+
+
+/**
+ * 直接 write() 到文件描述符，不经过 stdio 缓冲
+ */
+class FdSink : public IOutputSink {
+
+public:
+
+    /**
+     * 写入调用方已打开的文件描述符，不负责关闭
+     * @param fd 文件描述符
+     */
+    explicit FdSink(int fd);
+
+    /**
+     * 在 begin() 时创建（或截断）文件并写入，end() 时关闭
+     * @param filePath 文件路径
+     */
+    explicit FdSink(const char *filePath);
+
+    ~FdSink() override;
+
+    FdSink(const FdSink &obj) = delete;
+
+    FdSink &operator=(const FdSink &obj) = delete;
+
+    bool begin(size_t totalSize) override;
+
+    bool write(const unsigned char *data, size_t size) override;
+
+    bool end() override;
+
+private:
+
+    /**
+     * 关闭自己打开的文件
+     */
+    void closeOwnedFd();
+
+    int fd;                 /* 文件描述符 */
+    std::string filePath;   /* 文件路径，为空表示使用调用方的 fd */
+};
+
+
+/**
+ * 写入预先分配好大小的 mmap 文件。
+ * 编码器交出的 Jpeg 按其长度 ftruncate 、映射后一次拷贝完成；
+ * 通过 begin()/write() 写入时，begin() 按总长度映射，超出预分配大小时重新映射扩容
+ */
+class MmapFileSink : public IOutputSink {
+
+public:
+
+    /**
+     * @param filePath 文件路径
+     */
+    explicit MmapFileSink(const char *filePath);
+
+    ~MmapFileSink() override;
+
+    MmapFileSink(const MmapFileSink &obj) = delete;
+
+    MmapFileSink &operator=(const MmapFileSink &obj) = delete;
+
+    bool begin(size_t totalSize) override;
+
+    bool write(const unsigned char *data, size_t size) override;
+
+    bool end() override;
+
+    bool writeJpeg(const std::shared_ptr<const unsigned char> &data, size_t size) override;
+
+private:
+
+    /**
+     * 把文件扩大到 newSize 并重新映射
+     * @return
+     */
+    bool remap(size_t newSize);
+
+    /**
+     * 解除映射并关闭文件
+     */
+    void release();
+
+    std::string filePath;           /* 文件路径 */
+    int fd = -1;                    /* 文件描述符 */
+    unsigned char *map = nullptr;   /* 映射区 */
+    size_t mapSize = 0;             /* 映射区大小 */
+    size_t offset = 0;              /* 已写入的长度 */
+};
+
+
+/**
+ * 把 Jpeg 数据交给调用方的回调函数，不做拷贝。
+ * MJPEG 编码器整张编码完成后才有输出，编码器每张 Jpeg 只回调一次，data 即完整的 Jpeg ；
+ * 调用方自己通过 write() 分块写入时，每块回调一次
+ */
+class CallbackSink : public IOutputSink {
+
+public:
+
+    /**
+     * 数据回调。data 只在回调期间有效；返回 false 表示中止输出
+     */
+    typedef std::function<bool(const unsigned char *data, size_t size)> ChunkCallback;
+
+    /**
+     * @param callback 数据回调
+     */
+    explicit CallbackSink(ChunkCallback callback);
+
+    bool begin(size_t totalSize) override;
+
+    bool write(const unsigned char *data, size_t size) override;
+
+    bool end() override;
+
+private:
+    ChunkCallback callback;    /* 数据回调 */
+};
+
+#endif //H265TOJPEG_OUTPUTSINK_H
@@ -0,0 +1,459 @@
+#include <climits>
+#include "AnnexB.h"
+
+/* 识别编码格式时最多检查的 NAL 单元个数 */
+#define ANNEXB_PROBE_NALS 16
+
+/* 解析码流信息时最多检查的 NAL 单元个数 */
+#define ANNEXB_INFO_NALS 256
+
+/* 解析参数集时最多去除防竞争字节的长度，SPS/PPS 中用到的字段都在开头 */
+#define ANNEXB_RBSP_LIMIT 512
+
+/* H265 的 NAL 类型 */
+#define HEVC_NAL_IDR_W_RADL 19
+#define HEVC_NAL_IDR_N_LP 20
+#define HEVC_NAL_VPS 32
+#define HEVC_NAL_SPS 33
+#define HEVC_NAL_PPS 34
+
+/* H264 的 NAL 类型 */
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR_SLICE 5
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+
+
+namespace {
+
+/**
+ * 按位读取去除了防竞争字节的 RBSP ，读过末尾时返回 0 。放在匿名命名空间中，避免与使用方的同名类冲突
+ */
+class BitReader {
+
+public:
+
+    explicit BitReader(const std::vector<uint8_t> &rbsp) : data(rbsp.data()), bitSize(rbsp.size() * 8), pos(0) {
+    }
+
+    /**
+     * 读取 n 位（n <= 32）
+     */
+    uint32_t bits(int n) {
+        uint32_t value = 0;
+        for (int i = 0; i < n; ++i, ++pos) {
+            uint32_t bit = pos < bitSize ? (data[pos >> 3] >> (7 - (pos & 7))) & 1 : 0;
+            value = (value << 1) | bit;
+        }
+        return value;
+    }
+
+    void skip(size_t n) {
+        pos += n;
+    }
+
+    /**
+     * 无符号指数哥伦布码 ue(v)
+     */
+    uint32_t ue() {
+        int zeros = 0;
+        while (pos < bitSize && bits(1) == 0 && zeros < 32) {
+            ++zeros;
+        }
+        return zeros >= 32 ? 0 : (1u << zeros) - 1 + bits(zeros);
+    }
+
+    /**
+     * 有符号指数哥伦布码 se(v)
+     */
+    int32_t se() {
+        uint32_t value = ue();
+        return (value & 1) ? (int32_t) ((value + 1) / 2) : -(int32_t) (value / 2);
+    }
+
+    /**
+     * @return 是否读过了末尾
+     */
+    bool overrun() const {
+        return pos > bitSize;
+    }
+
+private:
+    const uint8_t *data;
+    size_t bitSize;
+    size_t pos;
+};
+
+}
+
+/**
+ * 去除 NAL 单元中的防竞争字节（00 00 03 中的 03），最多取 ANNEXB_RBSP_LIMIT 字节
+ * @param nal  NAL 头之后的第一个字节
+ * @param end  NAL 单元的结束位置
+ * @param rbsp 去除后的数据
+ */
+static void unescapeRbsp(const uint8_t *nal, const uint8_t *const end, std::vector<uint8_t> &rbsp) {
+    rbsp.clear();
+    int zeros = 0;
+    for (; nal < end && rbsp.size() < ANNEXB_RBSP_LIMIT; ++nal) {
+        if (zeros >= 2 && *nal == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = *nal == 0 ? zeros + 1 : 0;
+        rbsp.push_back(*nal);
+    }
+}
+
+/**
+ * 跳过 H265 的 profile_tier_level
+ */
+static void skipHevcProfileTierLevel(BitReader &reader, const int maxSubLayersMinus1) {
+    // general_profile_space ... general_level_idc
+    reader.skip(88 + 8);
+    bool subLayerProfile[8], subLayerLevel[8];
+    for (int i = 0; i < maxSubLayersMinus1; ++i) {
+        subLayerProfile[i] = reader.bits(1) != 0;
+        subLayerLevel[i] = reader.bits(1) != 0;
+    }
+    if (maxSubLayersMinus1 > 0) {
+        reader.skip(2 * (8 - maxSubLayersMinus1));
+    }
+    for (int i = 0; i < maxSubLayersMinus1; ++i) {
+        reader.skip((subLayerProfile[i] ? 88 : 0) + (subLayerLevel[i] ? 8 : 0));
+    }
+}
+
+/**
+ * 解析 H265 SPS 中的分辨率
+ */
+static bool parseHevcSps(const std::vector<uint8_t> &rbsp, AnnexB::StreamInfo &info) {
+    BitReader reader(rbsp);
+    reader.skip(4); /* sps_video_parameter_set_id */
+    int maxSubLayersMinus1 = (int) reader.bits(3);
+    reader.skip(1); /* sps_temporal_id_nesting_flag */
+    skipHevcProfileTierLevel(reader, maxSubLayersMinus1);
+    reader.ue();    /* sps_seq_parameter_set_id */
+    if (reader.ue() == 3) { /* chroma_format_idc */
+        reader.skip(1); /* separate_colour_plane_flag */
+    }
+    info.width = (int) reader.ue();
+    info.height = (int) reader.ue();
+    return !reader.overrun();
+}
+
+/**
+ * 解析 H265 PPS 中的 tiles_enabled_flag 和 entropy_coding_sync_enabled_flag
+ */
+static bool parseHevcPps(const std::vector<uint8_t> &rbsp, AnnexB::StreamInfo &info) {
+    BitReader reader(rbsp);
+    reader.ue();    /* pps_pic_parameter_set_id */
+    reader.ue();    /* pps_seq_parameter_set_id */
+    reader.skip(1 + 1 + 3 + 1 + 1); /* dependent_slice_segments_enabled_flag ... cabac_init_present_flag */
+    reader.ue();    /* num_ref_idx_l0_default_active_minus1 */
+    reader.ue();    /* num_ref_idx_l1_default_active_minus1 */
+    reader.se();    /* init_qp_minus26 */
+    reader.skip(1 + 1); /* constrained_intra_pred_flag, transform_skip_enabled_flag */
+    if (reader.bits(1)) { /* cu_qp_delta_enabled_flag */
+        reader.ue();    /* diff_cu_qp_delta_depth */
+    }
+    reader.se();    /* pps_cb_qp_offset */
+    reader.se();    /* pps_cr_qp_offset */
+    reader.skip(1 + 1 + 1 + 1); /* pps_slice_chroma_qp_offsets_present_flag ... transquant_bypass_enabled_flag */
+    info.tiles = reader.bits(1) != 0;
+    info.wpp = reader.bits(1) != 0;
+    return !reader.overrun();
+}
+
+/**
+ * 解析 H264 SPS 中的分辨率和 VUI 中的帧率
+ */
+static bool parseH264Sps(const std::vector<uint8_t> &rbsp, AnnexB::StreamInfo &info) {
+    BitReader reader(rbsp);
+    int profileIdc = (int) reader.bits(8);
+    reader.skip(8 + 8); /* constraint_set_flags, level_idc */
+    reader.ue();        /* seq_parameter_set_id */
+    if (profileIdc == 100 || profileIdc == 110 || profileIdc == 122 || profileIdc == 244 || profileIdc == 44 ||
+        profileIdc == 83 || profileIdc == 86 || profileIdc == 118 || profileIdc == 128 || profileIdc == 138 ||
+        profileIdc == 139 || profileIdc == 134 || profileIdc == 135) {
+        uint32_t chromaFormatIdc = reader.ue();
+        if (chromaFormatIdc == 3) {
+            reader.skip(1); /* separate_colour_plane_flag */
+        }
+        reader.ue();    /* bit_depth_luma_minus8 */
+        reader.ue();    /* bit_depth_chroma_minus8 */
+        reader.skip(1); /* qpprime_y_zero_transform_bypass_flag */
+        if (reader.bits(1)) { /* seq_scaling_matrix_present_flag */
+            for (int i = 0; i < (chromaFormatIdc != 3 ? 8 : 12); ++i) {
+                if (!reader.bits(1)) {
+                    continue;
+                }
+                // scaling_list() ，只需跳过
+                int lastScale = 8, nextScale = 8;
+                for (int j = 0; j < (i < 6 ? 16 : 64) && nextScale != 0; ++j) {
+                    nextScale = (lastScale + reader.se() + 256) % 256;
+                    lastScale = nextScale == 0 ? lastScale : nextScale;
+                }
+            }
+        }
+    }
+    reader.ue();    /* log2_max_frame_num_minus4 */
+    uint32_t pocType = reader.ue();
+    if (pocType == 0) {
+        reader.ue(); /* log2_max_pic_order_cnt_lsb_minus4 */
+    } else if (pocType == 1) {
+        reader.skip(1); /* delta_pic_order_always_zero_flag */
+        reader.se();    /* offset_for_non_ref_pic */
+        reader.se();    /* offset_for_top_to_bottom_field */
+        uint32_t cycle = reader.ue();
+        for (uint32_t i = 0; i < cycle && !reader.overrun(); ++i) {
+            reader.se();
+        }
+    }
+    reader.ue();    /* max_num_ref_frames */
+    reader.skip(1); /* gaps_in_frame_num_value_allowed_flag */
+    uint32_t widthInMbs = reader.ue() + 1;
+    uint32_t heightInMapUnits = reader.ue() + 1;
+    uint32_t frameMbsOnly = reader.bits(1);
+    info.width = (int) (widthInMbs * 16);
+    info.height = (int) (heightInMapUnits * 16 * (2 - frameMbsOnly));
+    if (reader.overrun()) {
+        return false;
+    }
+
+    // 帧率在 VUI 的 timing_info 中。h264 parser 不输出帧率，解码器要到解码第一个 slice 时才设置
+    if (!frameMbsOnly) {
+        reader.skip(1); /* mb_adaptive_frame_field_flag */
+    }
+    reader.skip(1);     /* direct_8x8_inference_flag */
+    if (reader.bits(1)) { /* frame_cropping_flag */
+        for (int i = 0; i < 4; ++i) {
+            reader.ue();
+        }
+    }
+    if (!reader.bits(1)) { /* vui_parameters_present_flag */
+        return true;
+    }
+    if (reader.bits(1) && reader.bits(8) == 255) { /* aspect_ratio_info_present_flag, aspect_ratio_idc */
+        reader.skip(16 + 16); /* sar_width, sar_height */
+    }
+    if (reader.bits(1)) { /* overscan_info_present_flag */
+        reader.skip(1);   /* overscan_appropriate_flag */
+    }
+    if (reader.bits(1)) { /* video_signal_type_present_flag */
+        reader.skip(3 + 1); /* video_format, video_full_range_flag */
+        if (reader.bits(1)) { /* colour_description_present_flag */
+            reader.skip(8 + 8 + 8);
+        }
+    }
+    if (reader.bits(1)) { /* chroma_loc_info_present_flag */
+        reader.ue();
+        reader.ue();
+    }
+    if (reader.bits(1)) { /* timing_info_present_flag */
+        uint32_t numUnitsInTick = reader.bits(32);
+        uint32_t timeScale = reader.bits(32);
+        // 一帧是两个场，每个场一个 tick
+        if (!reader.overrun() && numUnitsInTick > 0 && timeScale > 0) {
+            av_reduce(&info.frameRate.num, &info.frameRate.den, timeScale, 2LL * numUnitsInTick, INT_MAX);
+        }
+    }
+    return true;
+}
+
+bool AnnexB::probe(const uint8_t *const data, const size_t size, AVCodecID &codecId) {
+    const uint8_t *end = data + size;
+
+    // 必须以起始码开头，否则交给 avformat 探测
+    if (!hasStartCode(data, size)) {
+        return false;
+    }
+
+    // 裸流一般以参数集开头，只要找到一个能确定格式的参数集即可
+    const uint8_t *nal = findNal(data, end);
+    for (int i = 0; i < ANNEXB_PROBE_NALS && nal < end; ++i) {
+        if (isHevcParameterSet(nal, end)) {
+            codecId = AV_CODEC_ID_HEVC;
+            return true;
+        }
+        if (isH264ParameterSet(nal, end)) {
+            codecId = AV_CODEC_ID_H264;
+            return true;
+        }
+        nal = findNal(nal, end);
+    }
+    return false;
+}
+
+/**
+ * 只检查 NAL 头，按解码顺序逐帧遍历裸流
+ * @tparam Visitor  bool(long long frameIndex, bool isIdr, size_t auStart) ，返回 false 时停止遍历
+ * @param data       数据
+ * @param size       数据长度
+ * @param codecId    编码格式
+ * @param visit      每一帧的回调。auStart 为该帧所在访问单元的起始位置（含前面的参数集、SEI 等）
+ * @param headerSize 码流开头的参数集等数据的长度（第一个图像 NAL 之前的部分）
+ * @return 遍历过的帧数
+ */
+template<typename Visitor>
+static long long scanFrames(const uint8_t *const data, const size_t size, const AVCodecID codecId, Visitor visit,
+                            size_t &headerSize) {
+    const uint8_t *end = data + size;
+    const bool isHevc = codecId == AV_CODEC_ID_HEVC;
+    headerSize = 0;
+
+    long long pictures = 0;   /* 已经开始的帧数 */
+    bool lastIsVcl = false;   /* 上一个 NAL 是否为图像数据 */
+    size_t prefixStart = 0;   /* 当前 NAL 之前连续的非图像 NAL （参数集、SEI 等）的起始位置 */
+    for (const uint8_t *nal = AnnexB::findNal(data, end); nal + 2 < end; nal = AnnexB::findNal(nal, end)) {
+        // NAL 的起始位置，含起始码（4 字节起始码的第一个 0 也算在内）
+        const uint8_t *nalStart = nal - 3;
+        if (nalStart > data && nalStart[-1] == 0) {
+            --nalStart;
+        }
+
+        // 图像 NAL （slice）。一帧可能分成多个 slice ，只有第一个 slice 标志着新的一帧开始
+        bool isVcl, isFirstSlice, isIdr;
+        if (isHevc) {
+            int type = (nal[0] >> 1) & 0x3f;
+            isVcl = type < HEVC_NAL_VPS;
+            isFirstSlice = (nal[2] & 0x80) != 0; /* first_slice_segment_in_pic_flag */
+            isIdr = type == HEVC_NAL_IDR_W_RADL || type == HEVC_NAL_IDR_N_LP;
+        } else {
+            int type = nal[0] & 0x1f;
+            isVcl = type >= H264_NAL_SLICE && type <= H264_NAL_IDR_SLICE;
+            isFirstSlice = (nal[1] & 0x80) != 0; /* first_mb_in_slice == 0 */
+            isIdr = type == H264_NAL_IDR_SLICE;
+        }
+
+        if (!isVcl) {
+            if (lastIsVcl) {
+                prefixStart = nalStart - data;
+            }
+            lastIsVcl = false;
+            continue;
+        }
+
+        if (isFirstSlice) {
+            // 新的一帧从它前面的参数集、SEI 等开始
+            size_t auStart = lastIsVcl ? nalStart - data : prefixStart;
+            if (pictures == 0) {
+                headerSize = nalStart - data;
+            }
+            if (!visit(pictures, isIdr, auStart)) {
+                return pictures;
+            }
+            ++pictures;
+        }
+        lastIsVcl = true;
+    }
+    return pictures;
+}
+
+bool AnnexB::findKeyFrame(const uint8_t *const data, const size_t size, const AVCodecID codecId,
+                          const long long targetFrame, KeyFrame &keyFrame, size_t &headerSize) {
+    keyFrame.offset = 0;
+    keyFrame.frameIndex = 0;
+    long long frames = scanFrames(data, size, codecId, [&](long long frameIndex, bool isIdr, size_t auStart) {
+        // 遍历到目标之后的一帧即可停止
+        if (frameIndex > targetFrame) {
+            return false;
+        }
+        if (isIdr) {
+            keyFrame.offset = auStart;
+            keyFrame.frameIndex = frameIndex;
+        }
+        return true;
+    }, headerSize);
+    return frames > targetFrame;
+}
+
+long long AnnexB::findKeyFrames(const uint8_t *const data, const size_t size, const AVCodecID codecId,
+                                std::vector<KeyFrame> &keyFrames, size_t &headerSize) {
+    keyFrames.clear();
+    return scanFrames(data, size, codecId, [&](long long frameIndex, bool isIdr, size_t auStart) {
+        if (isIdr) {
+            keyFrames.push_back(KeyFrame{auStart, frameIndex});
+        }
+        return true;
+    }, headerSize);
+}
+
+bool AnnexB::probeStreamInfo(const uint8_t *const data, const size_t size, const AVCodecID codecId,
+                             StreamInfo &info) {
+    info.width = 0;
+    info.height = 0;
+    info.wpp = false;
+    info.tiles = false;
+    info.slicesPerPicture = 0;
+    info.frameRate = AVRational{0, 1};
+
+    const uint8_t *end = data + size;
+    const bool isHevc = codecId == AV_CODEC_ID_HEVC;
+    const size_t headerLength = isHevc ? 2 : 1;
+    bool hasSps = false, hasPps = false;
+    std::vector<uint8_t> rbsp;
+
+    const uint8_t *nal = findNal(data, end);
+    for (int i = 0; i < ANNEXB_INFO_NALS && nal + 2 < end; ++i) {
+        const uint8_t *next = findNal(nal, end);
+        const uint8_t *nalEnd = next < end ? next - 3 : end;
+
+        int type = isHevc ? (nal[0] >> 1) & 0x3f : nal[0] & 0x1f;
+        bool isVcl = isHevc ? type < HEVC_NAL_VPS : type >= H264_NAL_SLICE && type <= H264_NAL_IDR_SLICE;
+        if (isVcl) {
+            // 第二帧的第一个 slice ，第一帧已数完
+            bool isFirstSlice = isHevc ? (nal[2] & 0x80) != 0 : (nal[1] & 0x80) != 0;
+            if (isFirstSlice && info.slicesPerPicture > 0) {
+                break;
+            }
+            ++info.slicesPerPicture;
+        } else if (!hasSps && type == (isHevc ? HEVC_NAL_SPS : H264_NAL_SPS)) {
+            // 只用第一个参数集。码流中途更换参数集的情况不影响线程策略的选择
+            unescapeRbsp(nal + headerLength, nalEnd, rbsp);
+            hasSps = isHevc ? parseHevcSps(rbsp, info) : parseH264Sps(rbsp, info);
+        } else if (isHevc && !hasPps && type == HEVC_NAL_PPS) {
+            unescapeRbsp(nal + headerLength, nalEnd, rbsp);
+            hasPps = parseHevcPps(rbsp, info);
+        }
+        nal = next;
+    }
+    return hasSps;
+}
+
+bool AnnexB::hasStartCode(const uint8_t *const data, const size_t size) {
+    return size >= 4 && data[0] == 0 && data[1] == 0 && (data[2] == 1 || (data[2] == 0 && data[3] == 1));
+}
+
+const uint8_t *AnnexB::findNal(const uint8_t *data, const uint8_t *const end) {
+    for (; data + 2 < end; ++data) {
+        if (data[2] > 1) {
+            // 第三个字节大于 1 时，前两个位置都不可能是起始码
+            data += 2;
+        } else if (data[0] == 0 && data[1] == 0 && data[2] == 1) {
+            return data + 3;
+        }
+    }
+    return end;
+}
+
+bool AnnexB::isHevcParameterSet(const uint8_t *const nal, const uint8_t *const end) {
+    if (end - nal < 2 || (nal[0] & 0x80)) {
+        return false;
+    }
+    // forbidden_zero_bit(1) | nal_unit_type(6) | nuh_layer_id(6) | nuh_temporal_id_plus1(3)
+    int type = (nal[0] >> 1) & 0x3f;
+    int layerId = ((nal[0] & 0x01) << 5) | (nal[1] >> 3);
+    int temporalIdPlus1 = nal[1] & 0x07;
+    return type >= HEVC_NAL_VPS && type <= HEVC_NAL_PPS && layerId == 0 && temporalIdPlus1 == 1;
+}
+
+bool AnnexB::isH264ParameterSet(const uint8_t *const nal, const uint8_t *const end) {
+    if (end - nal < 2 || (nal[0] & 0x80)) {
+        return false;
+    }
+    // forbidden_zero_bit(1) | nal_ref_idc(2) | nal_unit_type(5) ，参数集的 nal_ref_idc 不为 0
+    int type = nal[0] & 0x1f;
+    int refIdc = (nal[0] >> 5) & 0x03;
+    return (type == H264_NAL_SPS || type == H264_NAL_PPS) && refIdc != 0;
+}
@@ -0,0 +1,120 @@
+#ifndef H265TOJPEG_ANNEXB_H
+#define H265TOJPEG_ANNEXB_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavcodec/avcodec.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * H264/H265 Annex-B 裸流（以 00 00 01 起始码分隔的 NAL 单元）的识别工具
+ */
+class AnnexB {
+
+public:
+
+    /**
+     * 裸流中的关键帧（IDR 帧）
+     */
+    struct KeyFrame {
+        size_t offset;        /* 所在访问单元的起始位置（含前面的参数集、SEI 等） */
+        long long frameIndex; /* 帧序号，按解码顺序从 0 开始 */
+    };
+
+    /**
+     * 从参数集和第一帧中得到的码流信息，用于选择解码的线程策略
+     */
+    struct StreamInfo {
+        int width;            /* 宽度（编码尺寸，未裁剪），未找到 SPS 时为 0 */
+        int height;           /* 高度 */
+        bool wpp;             /* H265 PPS 的 entropy_coding_sync_enabled_flag ，按 CTU 行并行（WPP） */
+        bool tiles;           /* H265 PPS 的 tiles_enabled_flag */
+        int slicesPerPicture; /* 第一帧的 slice 数 */
+        AVRational frameRate; /* H264 SPS 的 VUI 中的帧率，没有时间信息（或 H265）时为 0/1 */
+    };
+
+    /**
+     * 判断数据是否为 Annex-B 裸流，并根据 NAL 头识别编码格式
+     * @param data    数据
+     * @param size    数据长度
+     * @param codecId 识别出的编码格式（AV_CODEC_ID_HEVC 或 AV_CODEC_ID_H264）
+     * @return 以起始码开头且能识别出编码格式时返回 true
+     */
+    static bool probe(const uint8_t *data, size_t size, AVCodecID &codecId);
+
+    /**
+     * 只检查 NAL 头，找出裸流中所有的 IDR 帧，不做解码
+     * @param data       数据
+     * @param size       数据长度
+     * @param codecId    编码格式（AV_CODEC_ID_HEVC 或 AV_CODEC_ID_H264）
+     * @param keyFrames  找到的 IDR 帧，按帧序号排列
+     * @param headerSize 码流开头的参数集等数据的长度（第一个图像 NAL 之前的部分）
+     * @return 码流的总帧数
+     */
+    static long long findKeyFrames(const uint8_t *data, size_t size, AVCodecID codecId,
+                                   std::vector<KeyFrame> &keyFrames, size_t &headerSize);
+
+    /**
+     * 解析码流开头的 SPS 、PPS 和第一帧的 slice 数，不做解码。H264 还解析 SPS 中的帧率
+     * @param data    数据
+     * @param size    数据长度
+     * @param codecId 编码格式（AV_CODEC_ID_HEVC 或 AV_CODEC_ID_H264）
+     * @param info    码流信息
+     * @return 找到并解析出 SPS 时返回 true
+     */
+    static bool probeStreamInfo(const uint8_t *data, size_t size, AVCodecID codecId, StreamInfo &info);
+
+    /**
+     * 判断数据是否以起始码（00 00 01 或 00 00 00 01）开头
+     * @param data 数据
+     * @param size 数据长度
+     * @return
+     */
+    static bool hasStartCode(const uint8_t *data, size_t size);
+
+    /**
+     * 只检查 NAL 头，查找目标帧之前（含）最近的 IDR 帧，不做解码
+     * @param data        数据
+     * @param size        数据长度
+     * @param codecId     编码格式（AV_CODEC_ID_HEVC 或 AV_CODEC_ID_H264）
+     * @param targetFrame 目标帧序号，按解码顺序从 0 开始
+     * @param keyFrame    找到的 IDR 帧。目标之前没有 IDR 帧时为码流的开头
+     * @param headerSize  码流开头的参数集等数据的长度（第一个图像 NAL 之前的部分）
+     * @return 目标帧超出码流的帧数时返回 false
+     */
+    static bool findKeyFrame(const uint8_t *data, size_t size, AVCodecID codecId, long long targetFrame,
+                             KeyFrame &keyFrame, size_t &headerSize);
+
+    /**
+     * 查找下一个起始码
+     * @param data 起始位置
+     * @param end  结束位置
+     * @return 起始码之后第一个字节（即 NAL 头）的位置，找不到返回 end
+     */
+    static const uint8_t *findNal(const uint8_t *data, const uint8_t *end);
+
+private:
+
+    /**
+     * 按 H265 的 NAL 头识别
+     * @return 是 H265 的参数集（VPS/SPS/PPS）时返回 true
+     */
+    static bool isHevcParameterSet(const uint8_t *nal, const uint8_t *end);
+
+    /**
+     * 按 H264 的 NAL 头识别
+     * @return 是 H264 的参数集（SPS/PPS）时返回 true
+     */
+    static bool isH264ParameterSet(const uint8_t *nal, const uint8_t *end);
+};
+
+#endif //H265TOJPEG_ANNEXB_H
@@ -0,0 +1,255 @@
+#ifndef H265TOJPEG_BOUNDEDQUEUE_H
+#define H265TOJPEG_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/* 阻塞的 push/pop 先自旋的次数，之后休眠等待 */
+#define BOUNDED_QUEUE_SPINS 64
+
+/* 休眠等待的最长时间（微秒）。无锁的 push/pop 不加锁通知，可能错过唤醒，超时后重试 */
+#define BOUNDED_QUEUE_WAIT_MICROS 1000
+
+
+/**
+ * 有界的多生产者多消费者环形队列（Vyukov 算法）。
+ * tryPush/tryPop 不加锁；阻塞的 push/pop 在队列满/空时等待，并统计等待的时间，用于判断流水线中哪一级是瓶颈
+ * @tparam T 元素类型，需可默认构造和移动
+ */
+template<typename T>
+class BoundedQueue {
+
+public:
+
+    /**
+     * 队列的统计
+     */
+    struct Stats {
+        size_t capacity;                       /* 容量 */
+        size_t depth;                          /* 当前元素个数 */
+        size_t maxDepth;                       /* 最多时的元素个数 */
+        unsigned long long fullStallMicros;    /* 生产者因队列满等待的总时间 */
+        unsigned long long emptyStallMicros;   /* 消费者因队列空等待的总时间 */
+    };
+
+    /**
+     * @param capacity 容量，向上取整为 2 的幂
+     */
+    explicit BoundedQueue(size_t capacity) : closed(false), maxDepth(0), fullStallMicros(0), emptyStallMicros(0),
+                                             waiters(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &obj) = delete;
+
+    BoundedQueue &operator=(const BoundedQueue &obj) = delete;
+
+    /**
+     * 入队，不阻塞
+     * @return 队列满或已关闭时返回 false ，value 不变
+     */
+    bool tryPush(T &value) {
+        if (closed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        recordDepth(pos + 1);
+        return true;
+    }
+
+    /**
+     * 出队，不阻塞
+     * @return 队列空时返回 false
+     */
+    bool tryPop(T &value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 入队，队列满时等待。等待中队列被关闭时不再等待
+     * @return 队列已关闭时返回 false ，元素没有入队，由调用方处理
+     */
+    bool push(T value) {
+        bool pushed = tryPush(value);
+        if (!pushed && !closed.load(std::memory_order_acquire)) {
+            auto start = std::chrono::steady_clock::now();
+            wait([&] {
+                pushed = tryPush(value);
+                return pushed || closed.load(std::memory_order_acquire);
+            });
+            fullStallMicros += elapsedMicros(start);
+        }
+        if (pushed) {
+            notify();
+        }
+        return pushed;
+    }
+
+    /**
+     * 出队，队列空时等待
+     * @return 队列已关闭且为空时返回 false
+     */
+    bool pop(T &value) {
+        bool got = tryPop(value);
+        if (!got) {
+            auto start = std::chrono::steady_clock::now();
+            wait([&] {
+                if (closed.load(std::memory_order_acquire)) {
+                    // 关闭后再取一次，关闭前最后入队的元素不会被漏掉
+                    got = tryPop(value);
+                    return true;
+                }
+                got = tryPop(value);
+                return got;
+            });
+            emptyStallMicros += elapsedMicros(start);
+        }
+        if (got) {
+            notify();
+        }
+        return got;
+    }
+
+    /**
+     * 关闭队列。之后入队都失败，等待中的生产者返回 false ；消费者取完剩余的元素后 pop 返回 false
+     */
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(waitMutex);
+        waitCond.notify_all();
+    }
+
+    /**
+     * @return 队列的统计
+     */
+    Stats stats() const {
+        Stats stats;
+        stats.capacity = mask + 1;
+        size_t enqueued = enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeued = dequeuePos.load(std::memory_order_relaxed);
+        stats.depth = enqueued > dequeued ? enqueued - dequeued : 0;
+        stats.maxDepth = maxDepth.load(std::memory_order_relaxed);
+        stats.fullStallMicros = fullStallMicros.load(std::memory_order_relaxed);
+        stats.emptyStallMicros = emptyStallMicros.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+
+    /**
+     * 环形数组的一格。sequence 标记这一格当前可以写入（等于入队位置）还是可以读取（等于入队位置 + 1）
+     */
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    /**
+     * 自旋若干次后休眠，直到 attempt 成功
+     */
+    template<typename Attempt>
+    void wait(Attempt attempt) {
+        for (int i = 0; i < BOUNDED_QUEUE_SPINS; ++i) {
+            if (attempt()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(waitMutex);
+        ++waiters;
+        while (!attempt()) {
+            waitCond.wait_for(lock, std::chrono::microseconds(BOUNDED_QUEUE_WAIT_MICROS));
+        }
+        --waiters;
+    }
+
+    /**
+     * 有线程在等待时唤醒
+     */
+    void notify() {
+        if (waiters.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            waitCond.notify_all();
+        }
+    }
+
+    /**
+     * 记录入队后的最大元素个数
+     */
+    void recordDepth(size_t enqueued) {
+        size_t dequeued = dequeuePos.load(std::memory_order_relaxed);
+        size_t depth = enqueued > dequeued ? enqueued - dequeued : 0;
+        size_t max = maxDepth.load(std::memory_order_relaxed);
+        while (depth > max && !maxDepth.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    static unsigned long long elapsedMicros(std::chrono::steady_clock::time_point start) {
+        return (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::unique_ptr<Cell[]> cells; /* 环形数组 */
+    size_t mask;                   /* 容量 - 1 */
+    std::atomic<size_t> enqueuePos; /* 下一个入队的位置 */
+    std::atomic<size_t> dequeuePos; /* 下一个出队的位置 */
+    std::atomic<bool> closed;      /* 已关闭 */
+    std::atomic<size_t> maxDepth;
+    std::atomic<unsigned long long> fullStallMicros;
+    std::atomic<unsigned long long> emptyStallMicros;
+    std::mutex waitMutex;          /* 休眠等待 */
+    std::condition_variable waitCond;
+    std::atomic<int> waiters;      /* 正在休眠等待的线程数 */
+};
+
+#endif //H265TOJPEG_BOUNDEDQUEUE_H
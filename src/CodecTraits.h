@@ -0,0 +1,50 @@
+#ifndef H265TOJPEG_CODECTRAITS_H
+#define H265TOJPEG_CODECTRAITS_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include "IDecoder.h"
+
+
+/**
+ * 各编码格式在编译期确定的参数。调用方指定了编码格式时，解码路径按此特化，不再做运行时探测
+ * @tparam Codec 编码格式
+ */
+template<InputCodec Codec>
+struct CodecTraits;
+
+template<>
+struct CodecTraits<InputCodec::H265> {
+    static constexpr AVCodecID codecId = AV_CODEC_ID_HEVC;
+
+    /**
+     * 对应的解复用器，只查找一次
+     */
+    static AVInputFormat *inputFormat() {
+        static AVInputFormat *format = av_find_input_format("hevc");
+        return format;
+    }
+};
+
+template<>
+struct CodecTraits<InputCodec::H264> {
+    static constexpr AVCodecID codecId = AV_CODEC_ID_H264;
+
+    /**
+     * 对应的解复用器，只查找一次
+     */
+    static AVInputFormat *inputFormat() {
+        static AVInputFormat *format = av_find_input_format("h264");
+        return format;
+    }
+};
+
+#endif //H265TOJPEG_CODECTRAITS_H
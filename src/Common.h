@@ -12,17 +12,17 @@
 #define DEBUG 0
 #endif
 
-/* 堆缓冲大小（单位：Byte） */
-#define HEAP_SIZE (1024 * 1024 * 2)  // 2MB
-
 /* 栈缓冲大小（单位：Byte） */
 #define STACK_SIZE (1024)  // 1KB
 
+/* 自定义 IO 的缓冲大小（单位：Byte） */
+#define IO_BUF_SIZE (1024 * 32)  // 32KB
+
 
 extern void LOG(const char *format, ...);
 
 /**
- * H265 数据的结构体
+ * H265 数据的结构体。只引用调用方的内存，不负责释放
  */
 class Input {
 public:
@@ -30,40 +30,15 @@ public:
 
     ~Input() {
         LOG("%s", __PRETTY_FUNCTION__);
-        if (h265_data) {
-            free(h265_data);
-            h265_data = nullptr;
-        }
+        h265_data = nullptr;
         offset = 0;
         size = 0;
     }
 
 public:
-    char *h265_data;
-    int offset;
-    int size;
-};
-
-
-/**
- * Jpeg 数据的结构体
- */
-class Output {
-public:
-    Output() = default;
-
-    ~Output() {
-        LOG("%s", __PRETTY_FUNCTION__);
-        if (jpeg_data) {
-            free(jpeg_data);
-            jpeg_data = nullptr;
-        }
-        offset = 0;
-    }
-
-public:
-    char *jpeg_data;
-    int offset;
+    const unsigned char *h265_data;
+    size_t offset;
+    size_t size;
 };
 
 #endif //H265TOJPEG_COMMON_H
@@ -0,0 +1,400 @@
+#include "ConvertService.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Encoder.h"
+
+/**
+ * 获取单调时钟时间戳（微秒级）
+ * @return
+ */
+static unsigned long long steadyMicros() {
+    return (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+std::shared_ptr<IConvertService> IConvertService::getInstance() {
+    return getInstance(ConvertServiceConfig());
+}
+
+std::shared_ptr<IConvertService> IConvertService::getInstance(const ConvertServiceConfig &config) {
+    if (DEBUG) {
+        LOG("%s | workers=%d", __PRETTY_FUNCTION__, config.workers);
+    }
+    return std::make_shared<ConvertService>(config);
+}
+
+ConvertService::ConvertService(const ConvertServiceConfig &config) : decoderConfig(config.decoder) {
+    decoderConfig.persistent = true;
+    // 各工作线程已经并行处理不同的项，解码器常驻，第一次打开时的负载不代表之后的情况
+    if (decoderConfig.threading == DecodeThreading::Auto) {
+        decoderConfig.threading = DecodeThreading::Throughput;
+    }
+    splitEncode = config.splitEncode;
+    stopping = false;
+
+    int count = config.workers > 0 ? config.workers : (int) std::thread::hardware_concurrency();
+    count = std::max(1, count);
+
+    // 工作窃取：每个工作线程一个常驻的解码器，解码任务按当前线程的序号取用
+    if (config.scheduling == ConvertScheduling::WorkStealing) {
+        for (int i = 0; i < count; ++i) {
+            decoders.emplace_back(new Decoder(decoderConfig));
+        }
+        scheduler.reset(new TaskScheduler(count));
+        return;
+    }
+
+    if (config.scheduling == ConvertScheduling::Pipeline) {
+        startPipeline(config, count);
+        return;
+    }
+
+    workers.reserve((size_t) count);
+    for (int i = 0; i < count; ++i) {
+        workers.emplace_back(&ConvertService::workerLoop, this);
+    }
+}
+
+ConvertService::~ConvertService() {
+    // 先等调度器执行完剩余的任务，任务中还会用到调度器和解码器
+    if (scheduler) {
+        scheduler->stop();
+    }
+
+    // 关闭流水线的入口，各级处理完剩余的项后依次退出
+    if (inputQueue) {
+        inputQueue->close();
+        for (Stage *stage : {&readers, &decoderStage, &encoders}) {
+            for (auto &thread : stage->threads) {
+                thread.join();
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+int ConvertService::workerCount() const {
+    if (scheduler) {
+        return scheduler->workerCount();
+    }
+    if (inputQueue) {
+        return (int) (readers.threads.size() + decoderStage.threads.size() + encoders.threads.size());
+    }
+    return (int) workers.size();
+}
+
+/**
+ * 转换队列的统计
+ */
+template<typename Queue>
+static PipelineQueueStats queueStats(const Queue &queue) {
+    typename Queue::Stats stats = queue.stats();
+    PipelineQueueStats result;
+    result.capacity = stats.capacity;
+    result.depth = stats.depth;
+    result.maxDepth = stats.maxDepth;
+    result.fullStallMicros = stats.fullStallMicros;
+    result.emptyStallMicros = stats.emptyStallMicros;
+    return result;
+}
+
+PipelineStageStats ConvertService::Stage::stats() const {
+    PipelineStageStats result;
+    result.threads = (int) threads.size();
+    result.items = items;
+    result.busyMicros = busyMicros;
+    return result;
+}
+
+PipelineStats ConvertService::pipelineStats() const {
+    PipelineStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (inputQueue) {
+        stats.reader = readers.stats();
+        stats.decoder = decoderStage.stats();
+        stats.encoder = encoders.stats();
+        stats.input = queueStats(*inputQueue);
+        stats.read = queueStats(*readQueue);
+        stats.decoded = queueStats(*decodedQueue);
+    }
+    return stats;
+}
+
+std::vector<ConvertResult> ConvertService::convertBatch(const std::vector<ConvertItem> &items) {
+    if (items.empty()) {
+        return std::vector<ConvertResult>();
+    }
+
+    Batch batch;
+    batch.results.assign(items.size(), ConvertResult::Failed);
+    batch.done = 0;
+
+    // 批次在栈上，等全部项完成后才返回，工作线程不会访问到已销毁的批次
+    for (size_t i = 0; i < items.size(); ++i) {
+        submit(Job{&items[i], [this, &batch, i](ConvertResult result) { finishItem(&batch, i, result); }});
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    batch.finished.wait(lock, [&batch] { return batch.done == batch.results.size(); });
+    return std::move(batch.results);
+}
+
+std::future<ConvertResult> ConvertService::convertAsync(const ConvertItem &item) {
+    auto promise = std::make_shared<std::promise<ConvertResult>>();
+    std::future<ConvertResult> future = promise->get_future();
+    convertAsync(item, [promise](ConvertResult result) { promise->set_value(result); });
+    return future;
+}
+
+void ConvertService::convertAsync(const ConvertItem &item, std::function<void(ConvertResult)> callback) {
+    // 复制一份，由回调持有到转换完成
+    auto owned = std::make_shared<ConvertItem>(item);
+    submit(Job{owned.get(), [owned, callback](ConvertResult result) {
+        if (callback) {
+            callback(result);
+        }
+    }});
+}
+
+void ConvertService::submit(Job job) {
+    // 工作窃取：每一项一个解码任务，由调度器分给各工作线程
+    if (scheduler) {
+        scheduler->submit([this, job] { decodeTask(job); });
+        return;
+    }
+
+    // 流水线：入口的队列满时等待，限制在途的项数
+    if (inputQueue) {
+        pushItem(*inputQueue, new PipelineItem{std::move(job), std::vector<unsigned char>(), nullptr});
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    available.notify_one();
+}
+
+void ConvertService::workerLoop() {
+    // 解码器在工作线程中创建，在各项之间复用。编码器只有指定了 jpegQscale 时才由线程私有的缓存复用
+    Decoder decoder(decoderConfig);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        available.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+
+        lock.unlock();
+        job.done(convertOne(decoder, *job.item));
+        lock.lock();
+    }
+}
+
+void ConvertService::decodeTask(const Job &job) {
+    Decoder &decoder = *decoders[scheduler->currentWorker()];
+    if (!splitEncode) {
+        job.done(convertOne(decoder, *job.item));
+        return;
+    }
+
+    ConvertResult result = checkItem(*job.item);
+    if (result != ConvertResult::Ok) {
+        job.done(result);
+        return;
+    }
+    AVFrame *frame = decoder.decodeFrame(job.item->inputFilePath.c_str());
+    if (!frame) {
+        job.done(ConvertResult::Failed);
+        return;
+    }
+
+    // 编码任务压入当前线程的队列，空闲的线程可以把它窃取过去
+    const int maxDimension = decoderConfig.maxDimension;
+    const int qscale = decoderConfig.jpegQscale;
+    scheduler->submit([job, frame, maxDimension, qscale] {
+        job.done(encodeOne(frame, *job.item, maxDimension, qscale));
+    });
+}
+
+void ConvertService::startPipeline(const ConvertServiceConfig &config, const int workers) {
+    size_t capacity = (size_t) std::max(1, config.queueCapacity);
+    inputQueue.reset(new PipelineQueue(capacity));
+    readQueue.reset(new PipelineQueue(capacity));
+    decodedQueue.reset(new PipelineQueue(capacity));
+
+    int half = std::max(1, workers / 2);
+    int readerCount = std::max(1, config.readerThreads);
+    int decoderCount = config.decoderThreads > 0 ? config.decoderThreads : half;
+    int encoderCount = config.encoderThreads > 0 ? config.encoderThreads : half;
+
+    // 先设置好各级的线程数，避免先启动的线程退出时误判为最后一个
+    readers.running = readerCount;
+    decoderStage.running = decoderCount;
+    encoders.running = encoderCount;
+    for (int i = 0; i < readerCount; ++i) {
+        readers.threads.emplace_back(&ConvertService::readerLoop, this);
+    }
+    for (int i = 0; i < decoderCount; ++i) {
+        decoderStage.threads.emplace_back(&ConvertService::decoderLoop, this);
+    }
+    for (int i = 0; i < encoderCount; ++i) {
+        encoders.threads.emplace_back(&ConvertService::encoderLoop, this);
+    }
+}
+
+void ConvertService::readerLoop() {
+    PipelineItem *item;
+    while (inputQueue->pop(item)) {
+        unsigned long long start = steadyMicros();
+        const ConvertItem &convertItem = *item->job.item;
+        ConvertResult result = checkItem(convertItem);
+        if (result == ConvertResult::Ok && !readFile(convertItem.inputFilePath, item->data)) {
+            result = ConvertResult::InputNotFound;
+        }
+        readers.busyMicros += steadyMicros() - start;
+        ++readers.items;
+
+        if (result != ConvertResult::Ok) {
+            item->job.done(result);
+            delete item;
+            continue;
+        }
+        pushItem(*readQueue, item);
+    }
+    leaveStage(readers, readQueue.get());
+}
+
+void ConvertService::decoderLoop() {
+    // 解码器在线程中创建，在各项之间复用
+    Decoder decoder(decoderConfig);
+
+    PipelineItem *item;
+    while (readQueue->pop(item)) {
+        unsigned long long start = steadyMicros();
+        item->frame = decoder.decodeFrame(item->data.data(), item->data.size());
+        std::vector<unsigned char>().swap(item->data);
+        decoderStage.busyMicros += steadyMicros() - start;
+        ++decoderStage.items;
+
+        if (!item->frame) {
+            item->job.done(ConvertResult::Failed);
+            delete item;
+            continue;
+        }
+        pushItem(*decodedQueue, item);
+    }
+    leaveStage(decoderStage, decodedQueue.get());
+}
+
+void ConvertService::encoderLoop() {
+    PipelineItem *item;
+    while (decodedQueue->pop(item)) {
+        unsigned long long start = steadyMicros();
+        ConvertResult result = encodeOne(item->frame, *item->job.item, decoderConfig.maxDimension,
+                                         decoderConfig.jpegQscale);
+        encoders.busyMicros += steadyMicros() - start;
+        ++encoders.items;
+
+        item->job.done(result);
+        delete item;
+    }
+    leaveStage(encoders, nullptr);
+}
+
+void ConvertService::pushItem(PipelineQueue &queue, PipelineItem *item) {
+    if (queue.push(item)) {
+        return;
+    }
+    // 队列已关闭（服务正在销毁），这一项不会再被处理，直接以失败结束
+    LOG("%s | 队列已关闭，转换失败：%s", __PRETTY_FUNCTION__, item->job.item->inputFilePath.c_str());
+    av_frame_free(&item->frame);
+    item->job.done(ConvertResult::Failed);
+    delete item;
+}
+
+void ConvertService::leaveStage(Stage &stage, PipelineQueue *const next) {
+    if (--stage.running == 0 && next) {
+        next->close();
+    }
+}
+
+bool ConvertService::readFile(const std::string &filePath, std::vector<unsigned char> &data) {
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    data.resize((size_t) fileStat.st_size);
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t n = read(fd, data.data() + offset, data.size() - offset);
+        if (n <= 0) {
+            break;
+        }
+        offset += (size_t) n;
+    }
+    close(fd);
+    data.resize(offset);
+    return !data.empty();
+}
+
+void ConvertService::finishItem(Batch *const batch, const size_t i, const ConvertResult result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch->results[i] = result;
+    if (++batch->done == batch->results.size()) {
+        batch->finished.notify_one();
+    }
+}
+
+ConvertResult ConvertService::checkItem(const ConvertItem &item) {
+    if (item.inputFilePath.empty() || item.outputFilePath.empty()) {
+        return ConvertResult::InvalidArgument;
+    }
+    if (access(item.inputFilePath.c_str(), R_OK) != 0) {
+        return ConvertResult::InputNotFound;
+    }
+    return ConvertResult::Ok;
+}
+
+ConvertResult ConvertService::convertOne(Decoder &decoder, const ConvertItem &item) {
+    ConvertResult result = checkItem(item);
+    if (result != ConvertResult::Ok) {
+        return result;
+    }
+    return decoder.H265ToJpeg(item.inputFilePath.c_str(), item.outputFilePath.c_str()) ? ConvertResult::Ok
+                                                                                         : ConvertResult::Failed;
+}
+
+ConvertResult ConvertService::encodeOne(AVFrame *frame, const ConvertItem &item, const int maxDimension,
+                                        const int qscale) {
+    // 指定了 jpegQscale 时使用执行编码任务的线程的编码器缓存，否则每项新建一个编码器
+    Encoder encoder(item.outputFilePath.c_str());
+    bool isOk = encoder.yuv2Jpeg(frame, maxDimension, qscale);
+    if (!isOk) {
+        LOG("Yuv 编码为 Jpeg 失败！");
+    }
+    av_frame_free(&frame);
+    return isOk ? ConvertResult::Ok : ConvertResult::Failed;
+}
@@ -0,0 +1,205 @@
+#ifndef H265TOJPEG_CONVERTSERVICE_H
+#define H265TOJPEG_CONVERTSERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "Decoder.h"
+#include "IConvertService.h"
+#include "TaskScheduler.h"
+
+
+/**
+ * 批量转换服务
+ */
+class ConvertService : public IConvertService {
+
+public:
+
+    explicit ConvertService(const ConvertServiceConfig &config);
+
+    ~ConvertService() override;
+
+    ConvertService(const ConvertService &obj) = delete;
+
+    ConvertService &operator=(const ConvertService &obj) = delete;
+
+    std::vector<ConvertResult> convertBatch(const std::vector<ConvertItem> &items) override;
+
+    std::future<ConvertResult> convertAsync(const ConvertItem &item) override;
+
+    void convertAsync(const ConvertItem &item, std::function<void(ConvertResult)> callback) override;
+
+    int workerCount() const override;
+
+    PipelineStats pipelineStats() const override;
+
+private:
+
+    /**
+     * 一项完成时的回调，在工作线程中调用
+     */
+    typedef std::function<void(ConvertResult)> Completion;
+
+    /**
+     * 待转换的一项
+     */
+    struct Job {
+        const ConvertItem *item; /* 输入、输出文件路径，在 done 被调用前有效 */
+        Completion done;         /* 完成时的回调 */
+    };
+
+    /**
+     * 一次 convertBatch 提交的各项
+     */
+    struct Batch {
+        std::vector<ConvertResult> results; /* 各项的结果 */
+        size_t done;                        /* 已完成的项数 */
+        std::condition_variable finished;   /* 全部完成时通知提交的线程 */
+    };
+
+    /**
+     * 在流水线中传递的一项
+     */
+    struct PipelineItem {
+        Job job;                          /* 待转换的一项 */
+        std::vector<unsigned char> data;  /* 读取的文件内容，解码后释放 */
+        AVFrame *frame;                   /* 解码出的帧，编码后释放 */
+    };
+
+    /**
+     * 流水线中的一级
+     */
+    struct Stage {
+        std::vector<std::thread> threads;           /* 线程 */
+        std::atomic<int> running;                   /* 还在运行的线程数，最后一个退出时关闭下游的队列 */
+        std::atomic<unsigned long long> items;      /* 已处理的项数 */
+        std::atomic<unsigned long long> busyMicros; /* 处理的总时间 */
+
+        Stage() : running(0), items(0), busyMicros(0) {
+        }
+
+        PipelineStageStats stats() const;
+    };
+
+    typedef BoundedQueue<PipelineItem *> PipelineQueue;
+
+    /**
+     * 把一项交给工作线程
+     * @param job 待转换的一项
+     */
+    void submit(Job job);
+
+    /**
+     * Fifo 调度的工作线程：持有常驻的解码器，按提交顺序依次领取下一项
+     */
+    void workerLoop();
+
+    /**
+     * WorkStealing 调度的解码任务：用当前工作线程的解码器解码一项。拆分编码时再提交一个编码任务
+     * @param job 待转换的一项
+     */
+    void decodeTask(const Job &job);
+
+    /**
+     * 创建流水线各级的线程
+     * @param config  服务配置
+     * @param workers 工作线程数
+     */
+    void startPipeline(const ConvertServiceConfig &config, int workers);
+
+    /**
+     * 流水线的读取线程：把输入文件读入内存
+     */
+    void readerLoop();
+
+    /**
+     * 流水线的解码线程：持有常驻的解码器，从内存中解码出帧
+     */
+    void decoderLoop();
+
+    /**
+     * 流水线的编码线程：编码为 Jpeg 并保存
+     */
+    void encoderLoop();
+
+    /**
+     * 把一项放入流水线的队列，队列满时等待。队列已关闭时该项以失败结束并释放
+     * @param queue 队列
+     * @param item  待处理的项
+     */
+    static void pushItem(PipelineQueue &queue, PipelineItem *item);
+
+    /**
+     * 流水线中一级的线程退出。最后一个退出时关闭下游的队列，下游处理完剩余的项后也依次退出
+     * @param stage 所在的一级
+     * @param next  下游的队列
+     */
+    static void leaveStage(Stage &stage, PipelineQueue *next);
+
+    /**
+     * 把整个文件读入内存
+     * @param filePath 文件路径
+     * @param data     文件内容
+     * @return
+     */
+    static bool readFile(const std::string &filePath, std::vector<unsigned char> &data);
+
+    /**
+     * 记录批次中一项的结果，全部完成时通知提交的线程
+     * @param batch  所属批次
+     * @param i      项的下标
+     * @param result 结果
+     */
+    void finishItem(Batch *batch, size_t i, ConvertResult result);
+
+    /**
+     * 检查一项的输入、输出路径
+     * @param item 输入、输出文件路径
+     * @return 可以转换时返回 Ok
+     */
+    static ConvertResult checkItem(const ConvertItem &item);
+
+    /**
+     * 转换一项
+     * @param decoder 工作线程的解码器
+     * @param item    输入、输出文件路径
+     * @return
+     */
+    static ConvertResult convertOne(Decoder &decoder, const ConvertItem &item);
+
+    /**
+     * 把解码出的帧编码为 Jpeg 并保存，然后释放帧
+     * @param frame        解码出的帧
+     * @param item         输入、输出文件路径
+     * @param maxDimension 输出图片的最长边，为 0 时保持原始分辨率
+     * @param qscale       Jpeg 编码的量化参数，为 0 时由码率控制选择
+     * @return
+     */
+    static ConvertResult encodeOne(AVFrame *frame, const ConvertItem &item, int maxDimension, int qscale);
+
+    DecoderConfig decoderConfig;      /* 工作线程的解码器配置 */
+    bool splitEncode;                 /* 是否把解码、编码拆成两个任务 */
+    std::vector<std::thread> workers; /* Fifo 调度的工作线程 */
+    std::unique_ptr<TaskScheduler> scheduler; /* WorkStealing 调度器，Fifo 调度时为空 */
+    std::vector<std::unique_ptr<Decoder>> decoders; /* WorkStealing 调度时各工作线程的解码器，按序号取用 */
+    std::mutex mutex;                 /* 保护 jobs 、stopping 以及各批次的计数 */
+    std::condition_variable available; /* 有新的项或即将停止时通知工作线程 */
+    std::deque<Job> jobs;             /* Fifo 调度时待领取的项，按提交顺序排列 */
+    bool stopping;                    /* 析构中，工作线程处理完剩余的项后退出 */
+    std::unique_ptr<PipelineQueue> inputQueue;   /* 流水线：提交 -> 读取，Pipeline 调度以外为空 */
+    std::unique_ptr<PipelineQueue> readQueue;    /* 流水线：读取 -> 解码 */
+    std::unique_ptr<PipelineQueue> decodedQueue; /* 流水线：解码 -> 编码 */
+    Stage readers;                    /* 流水线的读取线程 */
+    Stage decoderStage;               /* 流水线的解码线程 */
+    Stage encoders;                   /* 流水线的编码线程 */
+};
+
+#endif //H265TOJPEG_CONVERTSERVICE_H
@@ -2,9 +2,41 @@
 // Created by lixiaoqing on 2021/5/21.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <fcntl.h>
 #include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "AnnexB.h"
+#include "CodecTraits.h"
 #include "Decoder.h"
 #include "Encoder.h"
+#include "EncoderCache.h"
+#include "ScaleCache.h"
+#include "TaskScheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/pixdesc.h"
+#ifdef __cplusplus
+}
+#endif
+
+
+/* 码流中没有帧率信息时使用的帧率，与 FFmpeg 裸流解复用器的默认值一致 */
+#define DEFAULT_FRAME_RATE 25
+
+/* Auto 线程策略下使用 slice 线程的最小像素数，更小的图像单线程解码已足够快，多线程的同步开销不划算 */
+#define AUTO_LATENCY_MIN_PIXELS (1920 * 1080)
+
+/* 进程内已创建的解码器上下文数，Auto 线程策略据此估计并发的负载 */
+static std::atomic<int> codecContexts(0);
 
 
 // 单例实现的 Decoder 对象
@@ -33,97 +65,1210 @@ void LOG(const char *format, ...) {
     char now[size];
     strftime(now, size, "%Y-%m-%d %H:%M:%S", timeInfo);
 
-    printf("%s | %s\n", now, log);
-}
+    printf("%s | %s\n", now, log);
+}
+
+/**
+ * 读内存数据的回调函数
+ * @param opaque   Input 数据
+ * @param buf      ffmpeg 提供的缓冲
+ * @param buf_size 缓冲大小
+ * @return 读到的字节数，读完返回 AVERROR_EOF
+ */
+int readCallback(void *opaque, uint8_t *buf, int buf_size) {
+    Input *inputData = (Input *) opaque;
+    size_t remain = inputData->size - inputData->offset;
+    if (remain == 0) {
+        return AVERROR_EOF;
+    }
+    size_t readSize = FFMIN((size_t) buf_size, remain);
+    memcpy(buf, inputData->h265_data + inputData->offset, readSize);
+    inputData->offset += readSize;
+    return (int) readSize;
+}
+
+/**
+ * 定位内存数据的回调函数
+ * @param opaque Input 数据
+ * @param offset 偏移量
+ * @param whence SEEK_SET/SEEK_CUR/SEEK_END/AVSEEK_SIZE
+ * @return 新的位置，失败返回负值
+ */
+int64_t seekCallback(void *opaque, int64_t offset, int whence) {
+    Input *inputData = (Input *) opaque;
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return (int64_t) inputData->size;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = (int64_t) inputData->offset + offset;
+            break;
+        case SEEK_END:
+            pos = (int64_t) inputData->size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > (int64_t) inputData->size) {
+        return AVERROR(EINVAL);
+    }
+    inputData->offset = (size_t) pos;
+    return pos;
+}
+
+std::shared_ptr<IDecoder> IDecoder::getInstance() {
+    if (DEBUG) {
+        LOG("%s", __PRETTY_FUNCTION__);
+    }
+    auto decoder = std::make_shared<Decoder>();
+    return decoder;
+//    // 双检锁
+//    if (decoder == nullptr) {
+//        std::unique_lock<std::mutex> lock(singletonMutex);
+//        if (decoder == nullptr) {
+//            decoder = new Decoder();
+//        }
+//    }
+//    return decoder;
+}
+
+std::shared_ptr<IDecoder> IDecoder::getInstance(const DecoderConfig &config) {
+    if (DEBUG) {
+        LOG("%s | persistent=%d", __PRETTY_FUNCTION__, config.persistent);
+    }
+    return std::make_shared<Decoder>(config);
+}
+
+AllocationStats IDecoder::getAllocationStats() {
+    EncoderCache::Stats cacheStats = EncoderCache::stats();
+    AllocationStats stats;
+    stats.encodes = cacheStats.encodes;
+    stats.heapAllocations = cacheStats.heapAllocations;
+    stats.heapBytes = cacheStats.heapBytes;
+    stats.encoderOpens = cacheStats.encoderOpens;
+    return stats;
+}
+
+//void IDecoder::releaseInstance() {
+//    if (DEBUG) {
+//        LOG("%s", __PRETTY_FUNCTION__);
+//    }
+//    if (decoder) {
+//        delete decoder;
+//        decoder = nullptr;
+//    }
+//}
+
+
+Decoder::Decoder() : Decoder(DecoderConfig()) {
+}
+
+Decoder::Decoder(const DecoderConfig &config) : config(config) {
+    LOG("%s", __PRETTY_FUNCTION__);
+    fmtCtx = nullptr;    /* ffmpeg 的全局上下文，所有 ffmpeg 都需要 */
+    codecCtx = nullptr;  /* ffmpeg 编解码上下文 */
+    frame = nullptr;     /* ffmpeg 单帧缓存 */
+    packet = nullptr;    /* ffmpeg 单帧数据包 */
+    ioCtx = nullptr;     /* 自定义 IO 上下文，仅在解码内存数据时使用 */
+    streamIndex = -1;    /* 视频流的索引 */
+    frameDiscard = AVDISCARD_DEFAULT; /* 解码时丢弃帧的策略 */
+    decodedFrames = 0;   /* 本次输入已解码的帧数 */
+    parserCtx = nullptr; /* Annex-B 裸流的 parser */
+    rawData = nullptr;   /* Annex-B 裸流数据 */
+    rawSize = 0;         /* Annex-B 裸流数据的长度 */
+    rawOffset = 0;       /* Annex-B 裸流已送入 parser 的长度 */
+    rawSkipFrom = 0;     /* Annex-B 裸流中跳过的范围 */
+    rawSkipTo = 0;
+    rawCodecId = AV_CODEC_ID_NONE;
+    mappedFile = nullptr; /* mmap 的输入文件 */
+    mappedSize = 0;      /* mmap 的长度 */
+}
+
+Decoder::~Decoder() {
+    if (DEBUG) {
+        LOG("%s", __PRETTY_FUNCTION__);
+    }
+    // 释放 ffmpeg 资源
+    release();
+}
+
+void Decoder::release() {
+    if (DEBUG) {
+        LOG("%s", __PRETTY_FUNCTION__);
+    }
+    releaseInput();
+    releaseCodec();
+}
+
+void Decoder::releaseInput() {
+    if (fmtCtx) {
+        // 关闭 ffmpeg 上下文
+        avformat_close_input(&fmtCtx);
+        fmtCtx = nullptr;
+    }
+
+    if (ioCtx) {
+        // 释放自定义 IO 上下文及其缓冲。缓冲可能已被 ffmpeg 重新分配，所以要从 ioCtx 中取
+        av_freep(&ioCtx->buffer);
+        avio_context_free(&ioCtx);
+        ioCtx = nullptr;
+    }
+
+    if (inputCursor) {
+        inputCursor.reset();
+    }
+
+    if (parserCtx) {
+        av_parser_close(parserCtx);
+        parserCtx = nullptr;
+    }
+
+    if (mappedFile) {
+        munmap(mappedFile, mappedSize);
+        mappedFile = nullptr;
+        mappedSize = 0;
+    }
+    rawData = nullptr;
+    rawSize = 0;
+    rawOffset = 0;
+    rawCodecId = AV_CODEC_ID_NONE;
+    rawPath.clear();
+    keyFrameIndex.reset();
+    streamIndex = -1;
+}
+
+void Decoder::releaseCodec() {
+    if (codecCtx) {
+        // 关闭解码器
+        avcodec_free_context(&codecCtx);
+        --codecContexts;
+//        avcodec_close(codecCtx);
+        codecCtx = nullptr;
+    }
+    
+    if (frame) {
+//        av_free(frame);
+        av_frame_free(&frame);
+        frame = nullptr;
+    }
+    
+    if (packet) {
+//        // 释放 AVPacket 中的 data
+//        av_packet_unref(packet);
+        // 释放 AVPacket
+        av_packet_free(&packet);
+        packet = nullptr;
+    }
+}
+
+void Decoder::finishInput() {
+    // 常驻模式下保留解码器上下文、AVFrame 和 AVPacket ，供下一次调用复用
+    if (config.persistent) {
+        releaseInput();
+    } else {
+        release();
+    }
+}
+
+bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outputFilePath) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || outputFilePath == nullptr || strlen(inputFilePath) == 0 ||
+        strlen(outputFilePath) == 0) {
+        LOG("输入或输出的文件路径为空，请核查！输入文件:%s, 输出文件:%s", inputFilePath, outputFilePath);
+        return false;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return false;
+    }
+
+    // 编码为 Jpeg 并保存到文件
+    Encoder encoder(outputFilePath);
+    return decodeToEncoder(encoder);
+}
+
+AVFrame *Decoder::decodeFrame(const char *const inputFilePath) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || strlen(inputFilePath) == 0) {
+        LOG("输入的文件路径为空，请核查！");
+        return nullptr;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return nullptr;
+    }
+    return takeFirstFrame();
+}
+
+AVFrame *Decoder::decodeFrame(const unsigned char *const inputData, const size_t inputSize) {
+
+    // 合法性检查
+    if (inputData == nullptr || inputSize == 0) {
+        LOG("输入的 H265 数据为空，请核查！inputSize=%zu", inputSize);
+        return nullptr;
+    }
+
+    // 以自定义 IO 的方式打开内存中的数据
+    if (!openInput(inputData, inputSize)) {
+        return nullptr;
+    }
+    return takeFirstFrame();
+}
+
+AVFrame *Decoder::takeFirstFrame() {
+    if (!decodeFirstFrame()) {
+        return nullptr;
+    }
+
+    // 帧数据是引用计数的，转移给调用方后，释放或复用解码器都不影响这一帧
+    AVFrame *decoded = av_frame_alloc();
+    if (decoded) {
+        av_frame_move_ref(decoded, frame);
+    } else {
+        LOG("%s line=%d | Error in av_frame_alloc()", __PRETTY_FUNCTION__, __LINE__);
+        av_frame_unref(frame);
+    }
+
+    // 释放资源
+    finishInput();
+    return decoded;
+}
+
+bool Decoder::H265ToJpeg(const unsigned char *const inputData, const size_t inputSize,
+                         std::vector<unsigned char> &jpegData) {
+
+    // 合法性检查
+    if (inputData == nullptr || inputSize == 0) {
+        LOG("输入的 H265 数据为空，请核查！inputSize=%zu", inputSize);
+        return false;
+    }
+
+    // 以自定义 IO 的方式打开内存中的数据
+    if (!openInput(inputData, inputSize)) {
+        return false;
+    }
+
+    // 编码为 Jpeg ，结果保留在内存中
+    Encoder encoder;
+    bool isOk = decodeToEncoder(encoder);
+    if (isOk) {
+        jpegData.assign(encoder.getJpegData(), encoder.getJpegData() + encoder.getJpegSize());
+    }
+    return isOk;
+}
+
+bool Decoder::H265ToJpeg(const char *const inputFilePath, IOutputSink &sink) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || strlen(inputFilePath) == 0) {
+        LOG("输入的文件路径为空，请核查！");
+        return false;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return false;
+    }
+
+    // 编码为 Jpeg 并交给输出端
+    Encoder encoder(&sink);
+    return decodeToEncoder(encoder);
+}
+
+bool Decoder::H265ToJpeg(const unsigned char *const inputData, const size_t inputSize, IOutputSink &sink) {
+
+    // 合法性检查
+    if (inputData == nullptr || inputSize == 0) {
+        LOG("输入的 H265 数据为空，请核查！inputSize=%zu", inputSize);
+        return false;
+    }
+
+    // 以自定义 IO 的方式打开内存中的数据
+    if (!openInput(inputData, inputSize)) {
+        return false;
+    }
+
+    // 编码为 Jpeg 并交给输出端
+    Encoder encoder(&sink);
+    return decodeToEncoder(encoder);
+}
+
+bool Decoder::H265ToJpegPyramid(const char *const inputFilePath, const std::vector<PyramidLevel> &levels) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || strlen(inputFilePath) == 0) {
+        LOG("输入的文件路径为空，请核查！");
+        return false;
+    }
+    if (!checkPyramidLevels(levels)) {
+        return false;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return false;
+    }
+    return decodeToPyramid(levels);
+}
+
+bool Decoder::H265ToJpegPyramid(const unsigned char *const inputData, const size_t inputSize,
+                                const std::vector<PyramidLevel> &levels) {
+
+    // 合法性检查
+    if (inputData == nullptr || inputSize == 0) {
+        LOG("输入的 H265 数据为空，请核查！inputSize=%zu", inputSize);
+        return false;
+    }
+    if (!checkPyramidLevels(levels)) {
+        return false;
+    }
+
+    // 以自定义 IO 的方式打开内存中的数据
+    if (!openInput(inputData, inputSize)) {
+        return false;
+    }
+    return decodeToPyramid(levels);
+}
+
+bool Decoder::checkPyramidLevels(const std::vector<PyramidLevel> &levels) {
+    if (levels.empty()) {
+        LOG("没有指定输出的分辨率，请核查！");
+        return false;
+    }
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const PyramidLevel &level = levels[i];
+        if (level.maxDimension < 0 ||
+            (level.sink == nullptr && (level.outputFilePath == nullptr || strlen(level.outputFilePath) == 0))) {
+            LOG("第 %zu 级的尺寸或输出为空，请核查！maxDimension=%d", i, level.maxDimension);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Decoder::H265ToJpegCrops(const char *const inputFilePath, const std::vector<CropRegion> &regions) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || strlen(inputFilePath) == 0) {
+        LOG("输入的文件路径为空，请核查！");
+        return false;
+    }
+    if (!checkCropRegions(regions)) {
+        return false;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return false;
+    }
+    return decodeToCrops(regions);
+}
+
+bool Decoder::H265ToJpegCrops(const unsigned char *const inputData, const size_t inputSize,
+                              const std::vector<CropRegion> &regions) {
+
+    // 合法性检查
+    if (inputData == nullptr || inputSize == 0) {
+        LOG("输入的 H265 数据为空，请核查！inputSize=%zu", inputSize);
+        return false;
+    }
+    if (!checkCropRegions(regions)) {
+        return false;
+    }
+
+    // 以自定义 IO 的方式打开内存中的数据
+    if (!openInput(inputData, inputSize)) {
+        return false;
+    }
+    return decodeToCrops(regions);
+}
+
+bool Decoder::checkCropRegions(const std::vector<CropRegion> &regions) {
+    if (regions.empty()) {
+        LOG("没有指定裁剪的区域，请核查！");
+        return false;
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+        const CropRegion &region = regions[i];
+        if (region.width <= 0 || region.height <= 0 || region.maxDimension < 0 ||
+            (region.sink == nullptr && (region.outputFilePath == nullptr || strlen(region.outputFilePath) == 0))) {
+            LOG("第 %zu 个裁剪区域的大小或输出为空，请核查！%dx%d maxDimension=%d", i, region.width, region.height,
+                region.maxDimension);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Decoder::H265ToFrame(const char *const inputFilePath, DecodedFrame &decoded, const PixelOutput output) {
+    decoded = DecodedFrame();
+    return exportFrame(decodeFrame(inputFilePath), output, decoded);
+}
+
+bool Decoder::H265ToFrame(const unsigned char *const inputData, const size_t inputSize, DecodedFrame &decoded,
+                          const PixelOutput output) {
+    decoded = DecodedFrame();
+    return exportFrame(decodeFrame(inputData, inputSize), output, decoded);
+}
+
+int Decoder::H265ToJpegSequence(const char *const inputFilePath, const char *const outputPattern,
+                                const ExtractOptions &options, ExtractStats *const stats) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || outputPattern == nullptr || strlen(inputFilePath) == 0) {
+        LOG("输入文件路径或输出文件名模板为空，请核查！输入文件:%s, 输出文件:%s", inputFilePath, outputPattern);
+        return -1;
+    }
+    char outputFilePath[STACK_SIZE];
+    if (av_get_frame_filename2(outputFilePath, STACK_SIZE, outputPattern, 1, 0) < 0) {
+        LOG("输出文件名模板中需要包含一个帧序号（如 %%04d），请核查！输出文件:%s", outputPattern);
+        return -1;
+    }
+    if (options.select == FrameSelect::EveryNth && options.interval < 1) {
+        LOG("取帧间隔必须大于 0 ，请核查！interval=%d", options.interval);
+        return -1;
+    }
+    if (options.select == FrameSelect::Interval && !(options.intervalSeconds > 0)) {
+        LOG("取帧间隔必须大于 0 ，请核查！intervalSeconds=%f", options.intervalSeconds);
+        return -1;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath)) {
+        return -1;
+    }
+
+    // 只取关键帧时，非关键帧由解码器直接丢弃，省去这些帧的解码
+    frameDiscard = options.select == FrameSelect::KeyFrames ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    int count = decodeSequence(outputPattern, options);
+    frameDiscard = AVDISCARD_DEFAULT;
+
+    if (stats) {
+        stats->decoded = decodedFrames;
+        stats->written = count < 0 ? 0 : count;
+    }
+    return count;
+}
+
+int Decoder::decodeSequence(const char *const outputPattern, const ExtractOptions &options) {
+
+    // 裸流输出全部帧或每 N 帧时，按 GOP 切分后多线程并行解码
+    if (rawData && options.threads != 1 &&
+        (options.select == FrameSelect::All || options.select == FrameSelect::EveryNth)) {
+        int written = decodeParallel(outputPattern, options);
+        if (written >= 0) {
+            finishInput();
+        }
+        return written;
+    }
+
+    if (!openStream()) {
+        return -1;
+    }
+
+    // 裸流按间隔取帧时，只解码包含取样点的 GOP
+    int written = options.select == FrameSelect::Interval && rawData ? sampleRawFrames(outputPattern, options) :
+                  decodeAllFrames(outputPattern, options);
+    if (written < 0) {
+        return -1;
+    }
+
+    if (DEBUG) {
+        LOG("%s | 解码 %lld 帧，输出 %d 张", __PRETTY_FUNCTION__, decodedFrames, written);
+    }
+
+    // 释放资源
+    finishInput();
+
+    return written;
+}
+
+int Decoder::decodeAllFrames(const char *const outputPattern, const ExtractOptions &options) {
+
+    // 按间隔取帧时，把取样时间换算为帧序号
+    AVRational frameRate = AVRational{DEFAULT_FRAME_RATE, 1};
+    if (options.select == FrameSelect::Interval && fmtCtx) {
+        AVRational rate = av_guess_frame_rate(fmtCtx, fmtCtx->streams[streamIndex], nullptr);
+        if (rate.num > 0 && rate.den > 0) {
+            frameRate = rate;
+        }
+    }
+    int sample = 0;             /* 下一个取样点的序号 */
+    long long sampleFrame = 0;  /* 下一个取样点对应的帧序号 */
+    long long decoded = 0;  /* 已解码的帧数 */
+    int written = 0;        /* 已输出的图片数 */
+    int ret = 0;
+    while ((options.maxFrames <= 0 || written < options.maxFrames) && (ret = receiveFrame()) == 0) {
+        bool selected;
+        switch (options.select) {
+            case FrameSelect::EveryNth:
+                selected = decoded % options.interval == 0;
+                break;
+            case FrameSelect::Interval:
+                // 间隔小于一帧时，多个取样点落在同一帧上，只输出一次
+                selected = sampleFrame == decoded;
+                while (sampleFrame <= decoded) {
+                    sampleFrame = secondsToFrame(++sample * options.intervalSeconds, frameRate);
+                }
+                break;
+            default:
+                selected = true;
+                break;
+        }
+        ++decoded;
+        if (!selected) {
+            av_frame_unref(frame);
+            continue;
+        }
+
+        if (!writeSequenceFrame(outputPattern, ++written)) {
+            return -1;
+        }
+    }
+    if (ret < 0 && ret != AVERROR_EOF) {
+        release();
+        return -1;
+    }
+    return written;
+}
+
+int Decoder::sampleRawFrames(const char *const outputPattern, const ExtractOptions &options) {
+    AVRational frameRate;
+    if (!rawFrameRate(frameRate)) {
+        return -1;
+    }
+
+    const KeyFrameIndex &index = rawKeyFrameIndex();
+    long long totalFrames = index.frameCount();
+
+    long long nextFrame = -1;  /* 下一个解码出的帧的序号，-1 表示尚未定位 */
+    long long lastTarget = -1; /* 上一个输出的帧的序号 */
+    int written = 0;           /* 已输出的图片数 */
+    for (long long sample = 0; options.maxFrames <= 0 || written < options.maxFrames; ++sample) {
+        long long target = secondsToFrame(sample * options.intervalSeconds, frameRate);
+        if (target >= totalFrames) {
+            break;
+        }
+
+        // 取样点之前最近的关键帧
+        size_t k = index.find(target);
+        AnnexB::KeyFrame keyFrame = index.at(k);
+
+        // 吸附到最近的关键帧（前后均可）时，只需解码关键帧本身
+        if (options.snapToKeyFrame) {
+            if (k + 1 < index.size() && index.at(k + 1).frameIndex - target < target - keyFrame.frameIndex) {
+                keyFrame = index.at(k + 1);
+            }
+            target = keyFrame.frameIndex;
+        }
+
+        // 间隔小于一帧，或吸附到了同一个关键帧时，只输出一次
+        if (target <= lastTarget) {
+            continue;
+        }
+        lastTarget = target;
+
+        // 关键帧在当前位置之后时跳过去，否则（同一个 GOP 内）继续向后解码
+        if (nextFrame < 0 || keyFrame.frameIndex > nextFrame) {
+            if (!jumpToKeyFrame(keyFrame, index.headerSize())) {
+                return -1;
+            }
+            nextFrame = keyFrame.frameIndex;
+        }
+        if (!decodeToFrame(nextFrame, target)) {
+            return -1;
+        }
+        nextFrame = target + 1;
+
+        if (!writeSequenceFrame(outputPattern, ++written)) {
+            return -1;
+        }
+    }
+    return written;
+}
+
+int Decoder::decodeParallel(const char *const outputPattern, const ExtractOptions &options) {
+    decodedFrames = 0;
+
+    // 按 IDR 帧把码流切分成互不依赖的 GOP 段，索引的第一项总是码流的开头
+    const KeyFrameIndex &index = rawKeyFrameIndex();
+
+    // 限制了输出张数时，最后一张对应的帧之后的段不需要解码
+    long long lastFrame = LLONG_MAX;
+    if (options.maxFrames > 0) {
+        lastFrame = (long long) (options.maxFrames - 1) * (options.select == FrameSelect::EveryNth ? options.interval : 1);
+    }
+
+    unsigned int threads = options.threads > 0 ? (unsigned int) options.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min(threads, (unsigned int) index.size()));
+    if (DEBUG) {
+        LOG("%s | %zu 个 GOP 段，%u 个线程", __PRETTY_FUNCTION__, index.size(), threads);
+    }
+
+    // 各线程依次领取下一个段。每个线程一个常驻的解码器，拥有各自的 AVCodecContext ，在段之间复用
+    std::atomic<size_t> nextSegment(0);
+    std::atomic<bool> failed(false);
+    std::atomic<int> written(0);
+    std::atomic<long long> decoded(0);
+    auto work = [&]() {
+        DecoderConfig workerConfig = config;
+        workerConfig.persistent = true;
+        // 已经按 GOP 段并行，每个解码器再开 slice 线程只会争抢 CPU 核
+        if (workerConfig.threading == DecodeThreading::Auto) {
+            workerConfig.threading = DecodeThreading::Throughput;
+        }
+        Decoder worker(workerConfig);
+        size_t i;
+        while (!failed && (i = nextSegment++) < index.size() && index.at(i).frameIndex <= lastFrame) {
+            size_t segmentEnd = i + 1 < index.size() ? index.at(i + 1).offset : rawSize;
+            int count = worker.decodeSegment(rawData, segmentEnd, rawCodecId, index.headerSize(), index.at(i),
+                                             lastFrame, outputPattern, options);
+            decoded += worker.decodedFrames;
+            if (count < 0) {
+                failed = true;
+                break;
+            }
+            written += count;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    decodedFrames = decoded;
+    if (failed) {
+        release();
+        return -1;
+    }
+    return written;
+}
+
+int Decoder::decodeSegment(const uint8_t *const data, const size_t segmentEnd, const AVCodecID codecId,
+                           const size_t headerSize, const AnnexB::KeyFrame &keyFrame, const long long lastFrame,
+                           const char *const outputPattern, const ExtractOptions &options) {
+
+    // 只切分到下一个 IDR 帧之前，parser 在段的末尾冲刷出最后一帧
+    rawData = data;
+    rawSize = segmentEnd;
+    rawCodecId = codecId;
+    decodedFrames = 0;
+    if (!openRawStream() || !jumpToKeyFrame(keyFrame, headerSize)) {
+        return -1;
+    }
+
+    // IDR 帧之后的帧不会引用之前的帧，按解码顺序计数即可得到全局的帧序号
+    long long frameIndex = keyFrame.frameIndex;
+    int written = 0;
+    int ret;
+    while (frameIndex <= lastFrame && (ret = receiveFrame()) == 0) {
+        long long current = frameIndex++;
+        if (options.select == FrameSelect::EveryNth && current % options.interval != 0) {
+            av_frame_unref(frame);
+            continue;
+        }
+
+        // 文件按全局的序号命名，与顺序解码的输出一致
+        long long number = options.select == FrameSelect::EveryNth ? current / options.interval + 1 : current + 1;
+        if (!writeSequenceFrame(outputPattern, (int) number)) {
+            return -1;
+        }
+        ++written;
+    }
+    if (frameIndex <= lastFrame && ret != AVERROR_EOF) {
+        release();
+        return -1;
+    }
+
+    // 保留解码器，供下一个段复用
+    finishInput();
+    return written;
+}
+
+bool Decoder::writeSequenceFrame(const char *const outputPattern, const int number) {
+    // 编码为 Jpeg 并保存到按序号命名的文件中
+    char outputFilePath[STACK_SIZE];
+    av_get_frame_filename2(outputFilePath, STACK_SIZE, outputPattern, number, 0);
+    Encoder encoder(outputFilePath);
+    bool isOk = encoder.yuv2Jpeg(frame, config.maxDimension, config.jpegQscale);
+    av_frame_unref(frame);
+    if (!isOk) {
+        LOG("Yuv 编码为 Jpeg 失败！第 %d 张", number);
+        release();
+    }
+    return isOk;
+}
+
+bool Decoder::H265ToJpegAt(const char *const inputFilePath, const double seconds,
+                           const char *const outputFilePath) {
+    if (seconds < 0) {
+        LOG("目标时间不能为负数，请核查！seconds=%f", seconds);
+        return false;
+    }
+    return seekToJpeg(inputFilePath, seconds, -1, outputFilePath);
+}
+
+bool Decoder::H265ToJpegAtFrame(const char *const inputFilePath, const long long frameIndex,
+                                const char *const outputFilePath) {
+    if (frameIndex < 0) {
+        LOG("目标帧序号不能为负数，请核查！frameIndex=%lld", frameIndex);
+        return false;
+    }
+    return seekToJpeg(inputFilePath, 0, frameIndex, outputFilePath);
+}
+
+bool Decoder::seekToJpeg(const char *const inputFilePath, const double seconds, const long long frameIndex,
+                         const char *const outputFilePath) {
+
+    // 合法性检查
+    if (inputFilePath == nullptr || outputFilePath == nullptr || strlen(inputFilePath) == 0 ||
+        strlen(outputFilePath) == 0) {
+        LOG("输入或输出的文件路径为空，请核查！输入文件:%s, 输出文件:%s", inputFilePath, outputFilePath);
+        return false;
+    }
+
+    // 打开输入文件
+    if (!openInput(inputFilePath) || !openStream()) {
+        return false;
+    }
+
+    // 解码到目标帧
+    if (!(rawData ? seekRawFrame(seconds, frameIndex) : seekFormatFrame(seconds, frameIndex))) {
+        return false;
+    }
+
+    // 编码为 Jpeg 并保存到文件
+    Encoder encoder(outputFilePath);
+    bool isOk = encoder.yuv2Jpeg(frame, config.maxDimension, config.jpegQscale);
+    if (!isOk) {
+        LOG("Yuv 编码为 Jpeg 失败！");
+    }
+    av_frame_unref(frame);
+
+    // 释放资源
+    finishInput();
+
+    return isOk;
+}
+
+bool Decoder::seekRawFrame(const double seconds, long long frameIndex) {
+
+    // 按时间定位时先换算为帧序号
+    if (frameIndex < 0) {
+        AVRational frameRate;
+        if (!rawFrameRate(frameRate)) {
+            return false;
+        }
+        frameIndex = secondsToFrame(seconds, frameRate);
+    }
+
+    // 找到目标之前最近的 IDR 帧。文件输入使用（可缓存的）关键帧索引，否则只扫描到目标处
+    AnnexB::KeyFrame keyFrame;
+    size_t headerSize;
+    bool found;
+    if (config.keyFrameIndexCache && !rawPath.empty()) {
+        const KeyFrameIndex &index = rawKeyFrameIndex();
+        found = frameIndex < index.frameCount();
+        keyFrame = index.at(index.find(frameIndex));
+        headerSize = index.headerSize();
+    } else {
+        found = AnnexB::findKeyFrame(rawData, rawSize, rawCodecId, frameIndex, keyFrame, headerSize);
+    }
+    if (!found) {
+        LOG("%s line=%d | 目标超出视频的帧数，frameIndex=%lld", __PRETTY_FUNCTION__, __LINE__, frameIndex);
+        release();
+        return false;
+    }
+    if (DEBUG) {
+        LOG("%s | 目标帧：%lld ，从第 %lld 帧（位置 %zu）开始解码", __PRETTY_FUNCTION__, frameIndex,
+            keyFrame.frameIndex, keyFrame.offset);
+    }
+
+    if (!jumpToKeyFrame(keyFrame, headerSize)) {
+        return false;
+    }
+    return decodeToFrame(keyFrame.frameIndex, frameIndex);
+}
+
+bool Decoder::rawFrameRate(AVRational &frameRate) {
+    // h264 parser 不输出帧率，直接解析 SPS 中的时间信息
+    AnnexB::StreamInfo info;
+    if (rawCodecId == AV_CODEC_ID_H264 && AnnexB::probeStreamInfo(rawData, rawSize, rawCodecId, info) &&
+        info.frameRate.num > 0) {
+        frameRate = info.frameRate;
+        return true;
+    }
+
+    // 其他情况由 parser 在切分第一帧时解析参数集中的时间信息。切分出的数据包不送入解码器，之后需要重新定位
+    if (readPacket() < 0) {
+        release();
+        return false;
+    }
+    av_packet_unref(packet);
+    frameRate = codecCtx->framerate.num > 0 && codecCtx->framerate.den > 0 ?
+                codecCtx->framerate : AVRational{DEFAULT_FRAME_RATE, 1};
+    return true;
+}
+
+long long Decoder::secondsToFrame(const double seconds, const AVRational frameRate) {
+    // 取该时刻正在显示的帧。加上一个很小的值，避免浮点误差使整数帧向下取整
+    return (long long) (seconds * av_q2d(frameRate) + 1e-6);
+}
+
+const KeyFrameIndex &Decoder::rawKeyFrameIndex() {
+    if (!keyFrameIndex.isOpen()) {
+        keyFrameIndex.open(config.keyFrameIndexCache && !rawPath.empty() ? rawPath.c_str() : nullptr, rawData, rawSize,
+                           rawCodecId);
+    }
+    return keyFrameIndex;
+}
+
+bool Decoder::jumpToKeyFrame(const AnnexB::KeyFrame &keyFrame, const size_t headerSize) {
+    // 清空解码器中缓存的帧和参考帧
+    avcodec_flush_buffers(codecCtx);
+
+    // 从 IDR 帧处重新切分。参数集可能只在码流开头出现，所以先切分开头的参数集，再跳到 IDR 帧处，两者合成一个数据包
+    if (keyFrame.offset <= headerSize) {
+        return resetRawParser(keyFrame.offset);
+    }
+    if (!resetRawParser(0)) {
+        return false;
+    }
+    rawSkipFrom = headerSize;
+    rawSkipTo = keyFrame.offset;
+    return true;
+}
+
+bool Decoder::seekFormatFrame(const double seconds, const long long frameIndex) {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
+    AVStream *stream = fmtCtx->streams[streamIndex];
+    AVRational frameRate = av_guess_frame_rate(fmtCtx, stream, nullptr);
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        frameRate = AVRational{DEFAULT_FRAME_RATE, 1};
+    }
+
+    // 没有时间戳的码流无法定位，只能从头解码并计数
+    const long long targetFrame = frameIndex >= 0 ? frameIndex : secondsToFrame(seconds, frameRate);
+    if (stream->start_time == AV_NOPTS_VALUE) {
+        return decodeToFrame(0, targetFrame);
+    }
+
+    // 把目标换算成视频流时基下的时间戳
+    int64_t targetTs = frameIndex >= 0 ?
+                       av_rescale_q(frameIndex, av_inv_q(frameRate), stream->time_base) :
+                       av_rescale_q((int64_t) (seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+    targetTs += stream->start_time;
+    int64_t frameDuration = av_rescale_q(1, av_inv_q(frameRate), stream->time_base);
+
+    /**
+     * int av_seek_frame(AVFormatContext *s, int stream_index, int64_t timestamp, int flags);
+     * 定位到指定的时间戳（stream_index 对应流的时基）
+     *   flags: AVSEEK_FLAG_BACKWARD 表示定位到时间戳之前（含）最近的关键帧
+     */
+
+    int ret = av_seek_frame(fmtCtx, streamIndex, targetTs, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        av_strerror(ret, errorBuf, STACK_SIZE);
+        LOG("%s line=%d | av_seek_frame failed, ret=%d, error=%s", __PRETTY_FUNCTION__, __LINE__, ret, errorBuf);
+        release();
+        return false;
+    }
+
+    // 向后解码，直到时间戳到达目标的帧。时间戳经过时基换算可能有误差，允许半帧的偏差
+    bool firstFrame = true;
+    while ((ret = receiveFrame()) == 0) {
+        // 流有起始时间但解码出的帧没有时间戳时无法比较，回到开头逐帧计数
+        if (firstFrame && frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+            av_frame_unref(frame);
+            return decodeFromStart(targetFrame);
+        }
+        firstFrame = false;
+        if (frame->best_effort_timestamp + frameDuration / 2 >= targetTs) {
+            return true;
+        }
+        av_frame_unref(frame);
+    }
+
+    if (ret == AVERROR_EOF) {
+        LOG("%s line=%d | 目标超出视频的时长，targetTs=%lld", __PRETTY_FUNCTION__, __LINE__, targetTs);
+    }
+    release();
+    return false;
+}
+
+bool Decoder::decodeFromStart(const long long targetFrame) {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
+    // 先按时间戳回到开头，不支持时按字节位置
+    AVStream *stream = fmtCtx->streams[streamIndex];
+    int ret = av_seek_frame(fmtCtx, streamIndex, stream->start_time, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        ret = av_seek_frame(fmtCtx, streamIndex, 0, AVSEEK_FLAG_BYTE);
+    }
+    if (ret < 0) {
+        av_strerror(ret, errorBuf, STACK_SIZE);
+        LOG("%s line=%d | av_seek_frame failed, ret=%d, error=%s", __PRETTY_FUNCTION__, __LINE__, ret, errorBuf);
+        release();
+        return false;
+    }
+
+    // 丢弃解码器中定位之前的数据
+    avcodec_flush_buffers(codecCtx);
+    return decodeToFrame(0, targetFrame);
+}
+
+bool Decoder::decodeToFrame(long long currentFrame, const long long targetFrame) {
+    int ret;
+    while ((ret = receiveFrame()) == 0) {
+        if (currentFrame++ == targetFrame) {
+            return true;
+        }
+        av_frame_unref(frame);
+    }
+
+    if (ret == AVERROR_EOF) {
+        LOG("%s line=%d | 目标超出视频的帧数，frameIndex=%lld", __PRETTY_FUNCTION__, __LINE__, targetFrame);
+    }
+    release();
+    return false;
+}
+
+bool Decoder::resetRawParser(const size_t offset) {
+
+    /**
+     * AVCodecParserContext *av_parser_init(int codec_id);
+     * 创建对应编码格式的 parser ，用于把裸流切分成一帧一帧的数据包
+     */
+
+    if (parserCtx) {
+        av_parser_close(parserCtx);
+    }
+    parserCtx = av_parser_init(rawCodecId);
+    if (!parserCtx) {
+        LOG("%s line=%d | av_parser_init failed, codecId=%d", __PRETTY_FUNCTION__, __LINE__, rawCodecId);
+        release();
+        return false;
+    }
+    rawOffset = offset;
+    rawSkipFrom = 0;
+    rawSkipTo = 0;
+    return true;
+}
+
+bool Decoder::decodeToEncoder(Encoder &encoder) {
+
+    // 解码出第一帧
+    if (!decodeFirstFrame()) {
+        return false;
+    }
+
+    // 编码为 Jpeg
+    bool isOk = encoder.yuv2Jpeg(frame, config.maxDimension, config.jpegQscale);
+    if (!isOk) {
+        LOG("Yuv 编码为 Jpeg 失败！");
+    }
+    av_frame_unref(frame);
+
+    // 释放资源
+    finishInput();
+
+    return isOk;
+}
+
+bool Decoder::decodeToPyramid(const std::vector<PyramidLevel> &levels) {
+
+    // 解码出第一帧
+    if (!decodeFirstFrame()) {
+        return false;
+    }
+
+    // 从大到小逐级缩小，每一级由上一级缩小而来：需要读取的数据逐级减少，上一级刚写出的数据也多半还在缓存中。
+    // 缩小的结果属于当前线程的 ScaleCache ，各级取一份引用，交给其他线程编码期间不会被淘汰或释放
+    const size_t count = levels.size();
+    std::vector<int> widths(count), heights(count);
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        Encoder::thumbnailSize(frame->width, frame->height, levels[i].maxDimension, widths[i], heights[i]);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return (long long) widths[a] * heights[a] > (long long) widths[b] * heights[b];
+    });
+    std::vector<AVFrame *> scaled(count, nullptr);
+    const AVFrame *previous = frame;
+    bool isOk = true;
+    for (size_t i : order) {
+        const AVFrame *result = previous;
+        if (widths[i] != previous->width || heights[i] != previous->height) {
+            result = ScaleCache::current().convert(previous, widths[i], heights[i], (AVPixelFormat) previous->format);
+        }
+        scaled[i] = result ? av_frame_clone(result) : nullptr;
+        if (!scaled[i]) {
+            LOG("%s line=%d | 缩小到 %dx%d 失败", __PRETTY_FUNCTION__, __LINE__, widths[i], heights[i]);
+            isOk = false;
+            break;
+        }
+        previous = scaled[i];
+    }
+
+    // 各级互不依赖，最大的一级在当前线程编码，其余交给工作线程。工作线程在调用之间复用，各自的编码器上下文缓存一直有效
+    if (isOk) {
+        std::atomic<bool> failed(false);
+        auto encode = [&](size_t i) {
+            const PyramidLevel &level = levels[i];
+            std::unique_ptr<Encoder> encoder(level.sink ? new Encoder(level.sink) : new Encoder(level.outputFilePath));
+            if (!encoder->yuv2Jpeg(scaled[i], 0, config.jpegQscale)) {
+                LOG("Yuv 编码为 Jpeg 失败！第 %zu 级，%dx%d", i, widths[i], heights[i]);
+                failed = true;
+            }
+        };
+
+        std::mutex doneMutex;
+        std::condition_variable done;
+        size_t pending = count - 1;
+
+        // 工作线程数取决于级数，不超过 CPU 核数 - 1 。级数比上次多时重建，避免一直沿用第一次调用时的线程数
+        int workers = std::max(1, std::min((int) pending, (int) std::thread::hardware_concurrency() - 1));
+        if (pending > 0 && (!levelEncoders || levelEncoders->workerCount() < workers)) {
+            levelEncoders.reset(new TaskScheduler(workers));
+        }
+        for (size_t n = 1; n < count; ++n) {
+            size_t i = order[n];
+            levelEncoders->submit([&, i] {
+                encode(i);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--pending == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+        encode(order[0]);
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&] { return pending == 0; });
+        isOk = !failed;
+    }
 
-std::shared_ptr<IDecoder> IDecoder::getInstance() {
-    if (DEBUG) {
-        LOG("%s", __PRETTY_FUNCTION__);
+    for (auto &level : scaled) {
+        av_frame_free(&level);
     }
-    auto decoder = std::make_shared<Decoder>();
-    return decoder;
-//    // 双检锁
-//    if (decoder == nullptr) {
-//        std::unique_lock<std::mutex> lock(singletonMutex);
-//        if (decoder == nullptr) {
-//            decoder = new Decoder();
-//        }
-//    }
-//    return decoder;
+    av_frame_unref(frame);
+
+    // 释放资源
+    finishInput();
+    return isOk;
 }
 
-//void IDecoder::releaseInstance() {
-//    if (DEBUG) {
-//        LOG("%s", __PRETTY_FUNCTION__);
-//    }
-//    if (decoder) {
-//        delete decoder;
-//        decoder = nullptr;
-//    }
-//}
+bool Decoder::decodeToCrops(const std::vector<CropRegion> &regions) {
 
+    // 解码出第一帧
+    if (!decodeFirstFrame()) {
+        return false;
+    }
 
-Decoder::Decoder() {
-    LOG("%s", __PRETTY_FUNCTION__);
-    fmtCtx = nullptr;    /* ffmpeg 的全局上下文，所有 ffmpeg 都需要 */
-    codecCtx = nullptr;  /* ffmpeg 编解码上下文 */
-    frame = nullptr;     /* ffmpeg 单帧缓存 */
-    packet = nullptr;    /* ffmpeg 单帧数据包 */
-}
+    // 大小相同的区域排在一起连续编码。指定了 jpegQscale 时复用当前线程 EncoderCache 中同一个编码器上下文，
+    // 区域的大小种类多于缓存容量时也不会反复创建；码率控制（默认）时每个区域都新建编码器，保证与单独转换的结果相同
+    std::vector<size_t> order(regions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (regions[a].width != regions[b].width) {
+            return regions[a].width < regions[b].width;
+        }
+        return regions[a].height < regions[b].height;
+    });
 
-Decoder::~Decoder() {
-    if (DEBUG) {
-        LOG("%s", __PRETTY_FUNCTION__);
+    // 某个区域失败时继续处理其余区域
+    bool isOk = true;
+    for (size_t i : order) {
+        const CropRegion &region = regions[i];
+        AVFrame *cropped = cropFrame(frame, region);
+        if (!cropped) {
+            isOk = false;
+            continue;
+        }
+        std::unique_ptr<Encoder> encoder(region.sink ? new Encoder(region.sink) : new Encoder(region.outputFilePath));
+        if (!encoder->yuv2Jpeg(cropped, region.maxDimension, config.jpegQscale)) {
+            LOG("Yuv 编码为 Jpeg 失败！第 %zu 个裁剪区域，%dx%d", i, cropped->width, cropped->height);
+            isOk = false;
+        }
+        av_frame_free(&cropped);
     }
-    // 释放 ffmpeg 资源
-    release();
+    av_frame_unref(frame);
+
+    // 释放资源
+    finishInput();
+    return isOk;
 }
 
-void Decoder::release() {
-    if (DEBUG) {
-        LOG("%s", __PRETTY_FUNCTION__);
-    }
-    
-    if (fmtCtx) {
-        // 关闭 ffmpeg 上下文
-        avformat_close_input(&fmtCtx);
-        fmtCtx = nullptr;
+AVFrame *Decoder::cropFrame(const AVFrame *const src, const CropRegion &region) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) src->format);
+    if (!desc) {
+        LOG("%s line=%d | 未知的像素格式 %d", __PRETTY_FUNCTION__, __LINE__, src->format);
+        return nullptr;
     }
-    
-    if (codecCtx) {
-        // 关闭解码器
-        avcodec_free_context(&codecCtx);
-//        avcodec_close(codecCtx);
-        codecCtx = nullptr;
+
+    // 色度平面有下采样时，左上角向下取整、右下角向上取整到色度像素的边界，亮度和色度平面才能指向同一块区域
+    const int alignX = 1 << desc->log2_chroma_w;
+    const int alignY = 1 << desc->log2_chroma_h;
+    const int left = std::max(0, region.x) / alignX * alignX;
+    const int top = std::max(0, region.y) / alignY * alignY;
+    const int right = (int) std::min((long long) src->width,
+                                     ((long long) region.x + region.width + alignX - 1) / alignX * alignX);
+    const int bottom = (int) std::min((long long) src->height,
+                                      ((long long) region.y + region.height + alignY - 1) / alignY * alignY);
+    if (right <= left || bottom <= top) {
+        LOG("%s line=%d | 裁剪区域在图像之外，请核查！(%d, %d) %dx%d ，图像 %dx%d", __PRETTY_FUNCTION__, __LINE__,
+            region.x, region.y, region.width, region.height, src->width, src->height);
+        return nullptr;
     }
-    
-    if (frame) {
-//        av_free(frame);
-        av_frame_free(&frame);
-        frame = nullptr;
+
+    // 新帧引用原帧的缓冲，由 av_frame_apply_cropping 按各平面的下采样比例移动数据指针并修改宽高。
+    // 左上角已经对齐到色度像素，不需要它再为内存对齐向左扩展区域
+    AVFrame *cropped = av_frame_clone(src);
+    if (!cropped) {
+        LOG("%s line=%d | Error in av_frame_clone()", __PRETTY_FUNCTION__, __LINE__);
+        return nullptr;
     }
-    
-    if (packet) {
-//        // 释放 AVPacket 中的 data
-//        av_packet_unref(packet);
-        // 释放 AVPacket
-        av_packet_free(&packet);
-        packet = nullptr;
+    cropped->crop_left = (size_t) left;
+    cropped->crop_top = (size_t) top;
+    cropped->crop_right = (size_t) (src->width - right);
+    cropped->crop_bottom = (size_t) (src->height - bottom);
+    int ret = av_frame_apply_cropping(cropped, AV_FRAME_CROP_UNALIGNED);
+    if (ret < 0) {
+        LOG("%s line=%d | av_frame_apply_cropping failed, ret=%d", __PRETTY_FUNCTION__, __LINE__, ret);
+        av_frame_free(&cropped);
+        return nullptr;
     }
+    return cropped;
 }
 
-bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outputFilePath) {
-
-    // 合法性检查
-    if (inputFilePath == nullptr || outputFilePath == nullptr || strlen(inputFilePath) == 0 ||
-        strlen(outputFilePath) == 0) {
-        LOG("输入或输出的文件路径为空，请核查！输入文件:%s, 输出文件:%s", inputFilePath, outputFilePath);
-        return false;
-    }
+bool Decoder::openInput(const char *const inputFilePath) {
 
     // 用于打印错误日志
     char errorBuf[STACK_SIZE];
 
+    // Annex-B 裸流直接映射到内存，由 parser 切分，不经过 avformat
+    if (config.annexBFastPath && openRawInput(inputFilePath)) {
+        return true;
+    }
+
     /**
      * int avformat_open_input(AVFormatContext **ps, const char *url, ff_const59 AVInputFormat *fmt, AVDictionary **options);
      * 打开输入文件，初始化输入视频码流的 AVFormatContext
@@ -134,7 +1279,67 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
      *   options: 附加选项，一般可为 NULL
      */
 
-    int ret = avformat_open_input(&fmtCtx, inputFilePath, nullptr, nullptr);
+    AVDictionary *options = formatOptions();
+    int ret = avformat_open_input(&fmtCtx, inputFilePath, inputFormat(), &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_strerror(ret, errorBuf, STACK_SIZE);
+        LOG("%s line=%d | Error in avformat_open_input(), ret=%d, error=%s", __PRETTY_FUNCTION__, __LINE__, ret,
+            errorBuf);
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+bool Decoder::openInput(const unsigned char *const inputData, const size_t inputSize) {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
+    // Annex-B 裸流直接由 parser 切分，不经过 avformat
+    if (config.annexBFastPath && detectRawCodec(inputData, inputSize)) {
+        rawData = inputData;
+        rawSize = inputSize;
+        return true;
+    }
+
+    inputCursor = std::make_shared<Input>();
+    inputCursor->h265_data = inputData;
+    inputCursor->offset = 0;
+    inputCursor->size = inputSize;
+
+    // IO Buffer ，之后由 AVIOContext 负责管理
+    auto ioBuf = (unsigned char *) av_malloc(IO_BUF_SIZE);
+    if (!ioBuf) {
+        LOG("%s line=%d | av_malloc failed", __PRETTY_FUNCTION__, __LINE__);
+        release();
+        return false;
+    }
+
+    // 初始化 AVIOContext 。读数据时从 inputCursor 中拷贝
+    ioCtx = avio_alloc_context(ioBuf, IO_BUF_SIZE, 0, inputCursor.get(), readCallback, nullptr, seekCallback);
+    if (!ioCtx) {
+        LOG("%s line=%d | avio_alloc_context failed.", __PRETTY_FUNCTION__, __LINE__);
+        av_free(ioBuf);
+        release();
+        return false;
+    }
+
+    fmtCtx = avformat_alloc_context();
+    if (!fmtCtx) {
+        LOG("%s line=%d | avformat_alloc_context failed.", __PRETTY_FUNCTION__, __LINE__);
+        release();
+        return false;
+    }
+    fmtCtx->pb = ioCtx;
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // 启用自定义 IO 后， url 参数无效
+    AVDictionary *options = formatOptions();
+    int ret = avformat_open_input(&fmtCtx, nullptr, inputFormat(), &options);
+    av_dict_free(&options);
     if (ret < 0) {
         av_strerror(ret, errorBuf, STACK_SIZE);
         LOG("%s line=%d | Error in avformat_open_input(), ret=%d, error=%s", __PRETTY_FUNCTION__, __LINE__, ret,
@@ -143,6 +1348,44 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
         return false;
     }
 
+    return true;
+}
+
+bool Decoder::openStream() {
+    decodedFrames = 0;
+
+    // Annex-B 裸流直接用 parser 切分，跳过 avformat
+    return rawData ? openRawStream() : openFormatStream();
+}
+
+bool Decoder::decodeFirstFrame() {
+    if (!openStream()) {
+        return false;
+    }
+
+    int ret = receiveFrame();
+    if (ret == AVERROR_EOF) {
+        LOG("%s line=%d | 码流中没有可解码的帧", __PRETTY_FUNCTION__, __LINE__);
+    }
+    if (ret < 0) {
+        release();
+        return false;
+    }
+
+    if (DEBUG && fmtCtx) {
+        struct AVRational frameRate = av_guess_frame_rate(fmtCtx, fmtCtx->streams[streamIndex], frame);
+        LOG("帧率：num=%d, den=%d", frameRate.num, frameRate.den);
+        LOG("帧时间戳：%lld", frame->pts);
+    }
+
+    return true;
+}
+
+bool Decoder::openFormatStream() {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
     /**
      * int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options);
      * 探测码流格式。读取检查媒体文件的数据包以获取具体的流信息，如媒体存入的编码格式。失败返回负值
@@ -150,7 +1393,8 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
      *   options: 额外选项，包含一些配置选项
      */
 
-    ret = avformat_find_stream_info(fmtCtx, nullptr);
+    // 关闭时直接使用解复用器给出的流信息，分辨率等参数由解码器从码流中获取
+    int ret = config.findStreamInfo ? avformat_find_stream_info(fmtCtx, nullptr) : 0;
     if (ret < 0) {
         av_strerror(ret, errorBuf, STACK_SIZE);
         LOG("%s line=%d | Error in find stream, ret=%d, error=%s", __PRETTY_FUNCTION__, __LINE__, ret, errorBuf);
@@ -159,28 +1403,57 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
     }
 
     // 获取视频流的索引
-    int streamType = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
-    if (streamType < 0) {
-        LOG("Error in find best stream type, streamType=%d", streamType);
+    streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        LOG("Error in find best stream type, streamType=%d", streamIndex);
         release();
         return false;
     }
 
     // 获取流对应的解码器参数
-    AVCodecParameters * codecPar = fmtCtx->streams[streamType]->codecpar;
+    AVCodecParameters * codecPar = fmtCtx->streams[streamIndex]->codecpar;
 
     if (DEBUG) {
-        struct AVRational base = fmtCtx->streams[streamType]->time_base;
+        struct AVRational base = fmtCtx->streams[streamIndex]->time_base;
         LOG("时基：num=%d, den=%d", base.num, base.den);
     }
 
+    // 常驻模式下，编码格式和分辨率都没有变化时复用已打开的解码器，只需清空其内部缓存
+    if (canReuseCodec(codecPar->codec_id, codecPar->width, codecPar->height)) {
+        avcodec_flush_buffers(codecCtx);
+    } else if (!openCodec(codecPar->codec_id, codecPar)) {
+        return false;
+    }
+
+    // 只解码关键帧时，由解码器直接丢弃非关键帧
+    codecCtx->skip_frame = frameDiscard;
+
+    return prepareFrameAndPacket();
+}
+
+bool Decoder::canReuseCodec(const AVCodecID codecId, const int width, const int height) const {
+    if (!config.persistent || !codecCtx || codecCtx->codec_id != codecId) {
+        return false;
+    }
+    // 分辨率未知时（Annex-B 裸流）只比较编码格式，分辨率变化由解码器根据码流中的参数集自行处理
+    return (width == 0 && height == 0) || (codecCtx->width == width && codecCtx->height == height);
+}
+
+bool Decoder::openCodec(const AVCodecID codecId, const AVCodecParameters *const codecPar) {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
+    // 编码格式或分辨率发生变化，旧的解码器不再可用
+    releaseCodec();
+
     /**
      * AVCodec *avcodec_find_decoder(enum AVCodecID id);
      * 根据解码器 ID 查找一个匹配的已注册解码器。未找到返回 NULL
      */
 
     // 对找到的视频流解码器
-    AVCodec * codec = avcodec_find_decoder(codecPar->codec_id);
+    AVCodec * codec = avcodec_find_decoder(codecId);
     if (!codec) {
         LOG("%s line=%d | avcodec_find_decoder failed.", __PRETTY_FUNCTION__, __LINE__);
         release();
@@ -198,9 +1471,10 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
         release();
         return false;
     }
+    ++codecContexts;
 
-    // 替换解码器上下文参数。将视频流信息拷贝到 AVCodecContext 中
-    ret = avcodec_parameters_to_context(codecCtx, codecPar);
+    // 替换解码器上下文参数。将视频流信息拷贝到 AVCodecContext 中。裸流没有流信息，参数由解码器从码流中获取
+    int ret = codecPar ? avcodec_parameters_to_context(codecCtx, codecPar) : 0;
     if (ret < 0) {
         av_strerror(ret, errorBuf, STACK_SIZE);
         LOG("avcodec_parameters_to_context failed, ret=%d, error=%s", ret, errorBuf);
@@ -245,6 +1519,11 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
      *   codec: 输入的 AVCodec
      */
 
+    // 线程策略，必须在打开解码器之前设置
+    int threads = decodeThreadCount(codecId, codecPar);
+    codecCtx->thread_count = threads;
+    codecCtx->thread_type = threads > 1 ? FF_THREAD_SLICE : 0;
+
     // 打开解码器
     ret = avcodec_open2(codecCtx, codec, NULL);
     if (ret < 0) {
@@ -258,8 +1537,54 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
         LOG("codecCtx->width=%d, codecCtx->height=%d", codecCtx->width, codecCtx->height);
     }
 
+    return true;
+}
+
+int Decoder::decodeThreadCount(const AVCodecID codecId, const AVCodecParameters *const codecPar) const {
+    const int cores = std::max(1, (int) std::thread::hardware_concurrency());
+    const int limit = config.decodeThreads > 0 ? config.decodeThreads : cores;
+    if (config.threading == DecodeThreading::Throughput) {
+        return 1;
+    }
+    if (config.threading == DecodeThreading::Latency) {
+        return limit;
+    }
+
+    // Auto：各解码器平分 CPU 核（含本解码器），分不到 2 个核时多线程只会互相争抢
+    const int share = cores / std::max(1, codecContexts.load());
+    if (share < 2) {
+        return 1;
+    }
+
+    // 从参数集得到分辨率和 WPP/tiles 标志。裸流直接解析，其他输入只在 extradata 是 Annex-B 格式时能解析
+    AnnexB::StreamInfo info;
+    bool known = false;
+    if (rawData) {
+        known = AnnexB::probeStreamInfo(rawData, rawSize, codecId, info);
+    } else if (codecPar && AnnexB::hasStartCode(codecPar->extradata, (size_t) codecPar->extradata_size)) {
+        known = AnnexB::probeStreamInfo(codecPar->extradata, (size_t) codecPar->extradata_size, codecId, info);
+    }
+    if (!known) {
+        return 1;
+    }
+
+    // H265 的 slice 线程按 WPP 的 CTU 行并行，FFmpeg 对开启 tiles 的图像退回单线程；H264 按 slice 并行
+    bool parallel = codecId == AV_CODEC_ID_HEVC ? info.wpp && !info.tiles : info.slicesPerPicture > 1;
+    bool large = (long long) info.width * info.height >= AUTO_LATENCY_MIN_PIXELS;
+    int threads = parallel && large ? std::min(limit, share) : 1;
+    if (DEBUG) {
+        LOG("%s | %dx%d, wpp=%d, tiles=%d, slices=%d, contexts=%d, threads=%d", __PRETTY_FUNCTION__, info.width,
+            info.height, info.wpp, info.tiles, info.slicesPerPicture, codecContexts.load(), threads);
+    }
+    return threads;
+}
+
+bool Decoder::prepareFrameAndPacket() {
+
     // 初始化 AVFrame ，用默认值填充字段
-    frame = av_frame_alloc();
+    if (!frame) {
+        frame = av_frame_alloc();
+    }
     if (!frame) {
         LOG("%s line=%d | Error in allocate the frame", __PRETTY_FUNCTION__, __LINE__);
         release();
@@ -271,9 +1596,12 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
      * 申请 AVPacket
      */
 
-    packet = av_packet_alloc();
+    if (!packet) {
+        packet = av_packet_alloc();
+    }
     if (!packet) {
         LOG("%s line=%d | av_packet_alloc failed.", __PRETTY_FUNCTION__, __LINE__);
+        release();
         return false;
     }
 
@@ -286,76 +1614,267 @@ bool Decoder::H265ToJpeg(const char *const inputFilePath, const char *const outp
     packet->data = nullptr;
     packet->size = 0;
 
-    /**
-     * int av_read_frame(AVFormatContext *s, AVPacket *pkt);
-     *   s  : 输入的 AVFormatContext
-     *   pkt: 输出的 AVPacket
-     * 返回流的下一帧。此函数返回存储在文件中的内容，不对有效的帧进行验证，不会省略有效帧之间的无效数据，以便给解码器最大可用于解码的信息。
-     * 成功返回 >=0 （>0 是文件末尾），失败返回负值
-     */
+    return true;
+}
 
-    // 读取码流数据中的一帧视频帧。从输入文件中读取一个 AVPacket 数据包, 存储到 packet 中。一个 packet 是一帧压缩数据（I + P + P + ...）？
-    ret = av_read_frame(fmtCtx, packet);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("av_read_frame failed, ret=%d, error=%s", ret, errorBuf);
-        release();
+bool Decoder::exportFrame(AVFrame *picture, const PixelOutput output, DecodedFrame &decoded) {
+    if (!picture) {
+        return false;
+    }
+
+    // 转换为 RGB 时输出到新申请的帧，不能用 ScaleCache 缓存的输出帧：调用方持有的图像不能被下一次转换覆盖
+    if (output != PixelOutput::Native) {
+        AVFrame *rgb = av_frame_alloc();
+        if (!rgb) {
+            LOG("%s line=%d | Error in av_frame_alloc()", __PRETTY_FUNCTION__, __LINE__);
+            av_frame_free(&picture);
+            return false;
+        }
+        rgb->width = picture->width;
+        rgb->height = picture->height;
+        rgb->format = output == PixelOutput::Rgb24 ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24;
+        int ret = av_frame_get_buffer(rgb, 32);
+        bool isOk = ret >= 0 && ScaleCache::current().convert(picture, rgb);
+        if (!isOk) {
+            LOG("%s line=%d | 转换为 RGB 失败，ret=%d", __PRETTY_FUNCTION__, __LINE__, ret);
+            av_frame_free(&rgb);
+        }
+        av_frame_free(&picture);
+        if (!isOk) {
+            return false;
+        }
+        picture = rgb;
+    }
+
+    // 只引用帧缓冲，不拷贝像素。最后一份 DecodedFrame 销毁时释放
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) picture->format);
+    decoded.width = picture->width;
+    decoded.height = picture->height;
+    decoded.format = picture->format;
+    decoded.formatName = desc ? desc->name : nullptr;
+    decoded.planes = std::max(0, av_pix_fmt_count_planes((AVPixelFormat) picture->format));
+    for (int i = 0; i < 4; ++i) {
+        decoded.data[i] = picture->data[i];
+        decoded.linesize[i] = picture->linesize[i];
+    }
+    decoded.owner = std::shared_ptr<void>(picture, [](void *owned) {
+        AVFrame *frame = (AVFrame *) owned;
+        av_frame_free(&frame);
+    });
+    return true;
+}
+
+bool Decoder::openRawInput(const char *const inputFilePath) {
+    int fd = open(inputFilePath, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    // 只读映射整个文件，映射建立后即可关闭文件描述符
+    void *addr = mmap(nullptr, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    mappedFile = addr;
+    mappedSize = (size_t) fileStat.st_size;
+
+    if (!detectRawCodec((const uint8_t *) mappedFile, mappedSize)) {
+        // 不是裸流，交给 avformat 处理
+        releaseInput();
         return false;
     }
+    rawData = (const uint8_t *) mappedFile;
+    rawSize = mappedSize;
+    rawPath = inputFilePath;
+    return true;
+}
 
+bool Decoder::openRawStream() {
     if (DEBUG) {
-        LOG("packet->pts=%lld", packet->pts);
+        LOG("%s | Annex-B 裸流，codecId=%d, size=%zu", __PRETTY_FUNCTION__, rawCodecId, rawSize);
     }
 
-    if (packet->stream_index != streamType) {
-        LOG("%s | 读取的数据包类型不正确", __PRETTY_FUNCTION__);
-        release();
+    // 常驻模式下编码格式不变时复用已打开的解码器
+    if (canReuseCodec(rawCodecId, 0, 0)) {
+        avcodec_flush_buffers(codecCtx);
+    } else if (!openCodec(rawCodecId, nullptr)) {
         return false;
     }
 
-    /**
-     * int avcodec_send_packet(AVCodecContext *avctx, const AVPacket *packet);
-     * 将原始分组数据包发送给解码器
-     * avctx: 编解码器上下文
-     * packet:
-     */
+    // 只解码关键帧时，由解码器直接丢弃非关键帧
+    codecCtx->skip_frame = frameDiscard;
 
-    // 将数据包发送到解码器中
-    ret = avcodec_send_packet(codecCtx, packet);
-    av_packet_unref(packet);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("Error in the send packet, ret=%d, error=%s", ret, errorBuf);
-        release();
+    if (!prepareFrameAndPacket()) {
         return false;
     }
 
+    return resetRawParser(0);
+}
 
-    /**
-     * int avcodec_receive_frame(AVCodecContext *avctx, AVFrame *frame);
-     * 从解码器返回解码输出数据
-     * avctx: 编解码器上下文
-     * frame:
-     */
+int Decoder::readPacket() {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+    int ret;
+
+    if (!rawData) {
+        /**
+         * int av_read_frame(AVFormatContext *s, AVPacket *pkt);
+         *   s  : 输入的 AVFormatContext
+         *   pkt: 输出的 AVPacket
+         * 返回流的下一帧。此函数返回存储在文件中的内容，不对有效的帧进行验证，不会省略有效帧之间的无效数据，以便给解码器最大可用于解码的信息。
+         * 成功返回 >=0 （>0 是文件末尾），失败返回负值
+         */
+
+        while ((ret = av_read_frame(fmtCtx, packet)) >= 0) {
+            if (DEBUG) {
+                LOG("packet->pts=%lld", packet->pts);
+            }
+            if (packet->stream_index == streamIndex) {
+                return 0;
+            }
+            // 跳过其他流的数据包
+            av_packet_unref(packet);
+        }
+        if (ret != AVERROR_EOF) {
+            av_strerror(ret, errorBuf, STACK_SIZE);
+            LOG("av_read_frame failed, ret=%d, error=%s", ret, errorBuf);
+        }
+        return ret;
+    }
+
+    while (true) {
+        // 跳过定位时不需要的数据
+        if (rawOffset == rawSkipFrom) {
+            rawOffset = rawSkipTo;
+        }
+
+        // 数据全部送完后，再以空数据调用一次，取出 parser 中缓存的最后一帧
+        const size_t remain = (rawOffset < rawSkipFrom ? rawSkipFrom : rawSize) - rawOffset;
+        const bool flushParser = remain == 0;
+        uint8_t *pktData = nullptr;
+        int pktSize = 0;
+        int len = av_parser_parse2(parserCtx, codecCtx, &pktData, &pktSize, flushParser ? nullptr : rawData + rawOffset,
+                                   flushParser ? 0 : (int) FFMIN(remain, (size_t) INT_MAX),
+                                   AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        if (len < 0) {
+            av_strerror(len, errorBuf, STACK_SIZE);
+            LOG("av_parser_parse2 failed, ret=%d, error=%s", len, errorBuf);
+            return len;
+        }
+        rawOffset += len;
 
-    // 从解码器获取解码后的帧，循环获取数据（一个分组数据包可能存在多帧数据）
-    while (avcodec_receive_frame(codecCtx, frame) == 0) {
-//            frame->pts = av_rescale_q(av_gettime(), (AVRational){1, 1200000}, fmtCtx->streams[streamType]->time_base);
-        if (DEBUG) {
-            struct AVRational frameRate = av_guess_frame_rate(fmtCtx, fmtCtx->streams[streamType], frame);
-            LOG("帧率：num=%d, den=%d", frameRate.num, frameRate.den);
-            LOG("帧时间戳：%lld", frame->pts);
+        if (pktSize > 0) {
+            // 数据包指向 parser 的缓冲（不是引用计数的），avcodec_send_packet 会自行拷贝
+            packet->data = pktData;
+            packet->size = pktSize;
+            return 0;
         }
-        ret = Encoder(outputFilePath).yuv2Jpeg(frame);
+        if (flushParser) {
+            return AVERROR_EOF;
+        }
+    }
+}
+
+int Decoder::receiveFrame() {
+
+    // 用于打印错误日志
+    char errorBuf[STACK_SIZE];
+
+    while (true) {
+
+        /**
+         * int avcodec_receive_frame(AVCodecContext *avctx, AVFrame *frame);
+         * 从解码器返回解码输出数据
+         * avctx: 编解码器上下文
+         * frame:
+         */
+
+        // 先取解码器中已有的帧，拿到一帧就返回，不再读取后面的数据
+        int ret = avcodec_receive_frame(codecCtx, frame);
         if (ret == 0) {
-            LOG("Yuv 编码为 Jpeg 失败！ret=%d", ret);
+            ++decodedFrames;
+            return ret;
+        }
+        if (ret == AVERROR_EOF) {
+            return ret;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            av_strerror(ret, errorBuf, STACK_SIZE);
+            LOG("Error in receive frame, ret=%d, error=%s", ret, errorBuf);
+            return ret;
+        }
+
+        // 解码器需要更多数据。参数集可能单独成包，帧级多线程的解码器也会延迟输出，
+        // 所以一个数据包不一定能得到一帧。输入读完后送入空包，冲刷出解码器中缓存的帧
+        ret = readPacket();
+        if (ret < 0 && ret != AVERROR_EOF) {
+            return ret;
+        }
+
+        /**
+         * int avcodec_send_packet(AVCodecContext *avctx, const AVPacket *packet);
+         * 将原始分组数据包发送给解码器
+         * avctx: 编解码器上下文
+         * packet: 为 NULL 时进入冲刷模式，之后解码器输出所有缓存的帧
+         */
+
+        // 每次送入前都已取空解码器的输出，所以这里不会出现 EAGAIN
+        ret = avcodec_send_packet(codecCtx, ret == AVERROR_EOF ? nullptr : packet);
+        av_packet_unref(packet);
+        if (ret < 0 && ret != AVERROR_EOF) {
+            av_strerror(ret, errorBuf, STACK_SIZE);
+            LOG("Error in the send packet, ret=%d, error=%s", ret, errorBuf);
+            return ret;
         }
-        av_frame_unref(frame);
-        break;
     }
+}
 
-    // 释放资源
-    release();
+bool Decoder::detectRawCodec(const uint8_t *const data, const size_t size) {
+    switch (config.codec) {
+        case InputCodec::H265:
+            return detectRawCodec<CodecTraits<InputCodec::H265>>(data, size);
+        case InputCodec::H264:
+            return detectRawCodec<CodecTraits<InputCodec::H264>>(data, size);
+        default:
+            return AnnexB::probe(data, size, rawCodecId);
+    }
+}
+
+template<typename Traits>
+bool Decoder::detectRawCodec(const uint8_t *const data, const size_t size) {
+    // 编码格式已知，只需确认以起始码开头，不再逐个检查 NAL 头
+    if (!AnnexB::hasStartCode(data, size)) {
+        return false;
+    }
+    rawCodecId = Traits::codecId;
+    return true;
+}
+
+AVInputFormat *Decoder::inputFormat() const {
+    switch (config.codec) {
+        case InputCodec::H265:
+            return CodecTraits<InputCodec::H265>::inputFormat();
+        case InputCodec::H264:
+            return CodecTraits<InputCodec::H264>::inputFormat();
+        default:
+            return nullptr;
+    }
+}
 
-    return ret;
+AVDictionary *Decoder::formatOptions() const {
+    AVDictionary *options = nullptr;
+    if (config.probeSize > 0) {
+        av_dict_set_int(&options, "probesize", config.probeSize, 0);
+    }
+    if (config.analyzeDuration > 0) {
+        av_dict_set_int(&options, "analyzeduration", config.analyzeDuration, 0);
+    }
+    return options;
 }
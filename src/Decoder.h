@@ -21,7 +21,16 @@ extern "C" {
 
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
+#include "AnnexB.h"
+#include "Common.h"
 #include "IDecoder.h"
+#include "KeyFrameIndex.h"
+
+class Encoder;
+
+class TaskScheduler;
 
 
 /**
@@ -31,6 +40,8 @@ class Decoder : public IDecoder {
 public:
     Decoder();
 
+    explicit Decoder(const DecoderConfig &config);
+
     ~Decoder() override;
 
     Decoder(const Decoder &obj) = delete;
@@ -46,18 +57,488 @@ public:
      */
     bool H265ToJpeg(const char *inputFilePath, const char *outputFilePath) override;
 
+    /**
+     * 内存中的 H265 数据转 Jpeg 数据
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @param jpegData  输出的 Jpeg 数据
+     * @return
+     */
+    bool H265ToJpeg(const unsigned char *inputData, size_t inputSize, std::vector<unsigned char> &jpegData) override;
+
+    /**
+     * H265 文件转 Jpeg ，输出到指定的输出端
+     * @param inputFilePath 输入的 H265 文件路径
+     * @param sink          Jpeg 输出端
+     * @return
+     */
+    bool H265ToJpeg(const char *inputFilePath, IOutputSink &sink) override;
+
+    /**
+     * 内存中的 H265 数据转 Jpeg ，输出到指定的输出端
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @param sink      Jpeg 输出端
+     * @return
+     */
+    bool H265ToJpeg(const unsigned char *inputData, size_t inputSize, IOutputSink &sink) override;
+
+    /**
+     * H265 帧转多种分辨率的 Jpeg ，只解码一次
+     * @param inputFilePath 输入的 H265 文件路径
+     * @param levels        各级的尺寸和输出
+     * @return
+     */
+    bool H265ToJpegPyramid(const char *inputFilePath, const std::vector<PyramidLevel> &levels) override;
+
+    /**
+     * 内存中的 H265 数据转多种分辨率的 Jpeg ，只解码一次
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @param levels    各级的尺寸和输出
+     * @return
+     */
+    bool H265ToJpegPyramid(const unsigned char *inputData, size_t inputSize,
+                           const std::vector<PyramidLevel> &levels) override;
+
+    /**
+     * H265 帧中的多个区域分别转 Jpeg ，只解码一次
+     * @param inputFilePath 输入的 H265 文件路径
+     * @param regions       裁剪的区域和输出
+     * @return
+     */
+    bool H265ToJpegCrops(const char *inputFilePath, const std::vector<CropRegion> &regions) override;
+
+    /**
+     * 内存中的 H265 数据中的多个区域分别转 Jpeg ，只解码一次
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @param regions   裁剪的区域和输出
+     * @return
+     */
+    bool H265ToJpegCrops(const unsigned char *inputData, size_t inputSize,
+                         const std::vector<CropRegion> &regions) override;
+
+    /**
+     * H265 帧解码为像素
+     * @param inputFilePath 输入的 H265 文件路径
+     * @param decoded       解码出的图像
+     * @param output        输出的像素格式
+     * @return
+     */
+    bool H265ToFrame(const char *inputFilePath, DecodedFrame &decoded, PixelOutput output) override;
+
+    /**
+     * 内存中的 H265 数据解码为像素
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @param decoded   解码出的图像
+     * @param output    输出的像素格式
+     * @return
+     */
+    bool H265ToFrame(const unsigned char *inputData, size_t inputSize, DecodedFrame &decoded,
+                     PixelOutput output) override;
+
+    /**
+     * H265 视频提取多帧转 Jpeg
+     * @param inputFilePath 输入的 H265 文件路径
+     * @param outputPattern 输出的 Jpeg 文件名模板，需包含一个帧序号
+     * @param options       选取帧的方式
+     * @param stats         解码、输出的帧数统计，可为 nullptr
+     * @return 输出的图片数，失败返回 -1
+     */
+    int H265ToJpegSequence(const char *inputFilePath, const char *outputPattern,
+                           const ExtractOptions &options, ExtractStats *stats = nullptr) override;
+
+    /**
+     * H265 视频中指定时间的帧转 Jpeg
+     * @param inputFilePath  输入的 H265 文件路径
+     * @param seconds        目标时间（秒）
+     * @param outputFilePath 输出的 Jpeg 文件路径
+     * @return
+     */
+    bool H265ToJpegAt(const char *inputFilePath, double seconds, const char *outputFilePath) override;
+
+    /**
+     * H265 视频中指定序号的帧转 Jpeg
+     * @param inputFilePath  输入的 H265 文件路径
+     * @param frameIndex     目标帧序号
+     * @param outputFilePath 输出的 Jpeg 文件路径
+     * @return
+     */
+    bool H265ToJpegAtFrame(const char *inputFilePath, long long frameIndex, const char *outputFilePath) override;
+
+    /**
+     * 只解码 H265 文件的第一帧，不做编码。用于把解码和编码拆成两个任务，编码可以在其他线程中进行
+     * @param inputFilePath 输入的 H265 文件路径
+     * @return 解码出的帧，由调用方用 av_frame_free 释放。失败返回 nullptr
+     */
+    AVFrame *decodeFrame(const char *inputFilePath);
+
+    /**
+     * 只解码内存中 H265 数据的第一帧，不做编码
+     * @param inputData 输入的 H265 数据，解码期间需保持有效
+     * @param inputSize 输入数据的长度（单位：Byte）
+     * @return 解码出的帧，由调用方用 av_frame_free 释放。失败返回 nullptr
+     */
+    AVFrame *decodeFrame(const unsigned char *inputData, size_t inputSize);
+
 private:
 
+    /**
+     * 打开输入文件，初始化 fmtCtx
+     * @param inputFilePath 输入的 H265 文件路径
+     * @return
+     */
+    bool openInput(const char *inputFilePath);
+
+    /**
+     * 以自定义 IO 的方式打开内存数据，初始化 fmtCtx
+     * @param inputData 输入的 H265 数据
+     * @param inputSize 输入数据的长度
+     * @return
+     */
+    bool openInput(const unsigned char *inputData, size_t inputSize);
+
+    /**
+     * 探测码流并打开解码器，之后可以用 receiveFrame 逐帧解码
+     * @return
+     */
+    bool openStream();
+
+    /**
+     * 用 avformat 探测码流并打开解码器
+     * @return
+     */
+    bool openFormatStream();
+
+    /**
+     * 打开 Annex-B 裸流对应的解码器和 parser ，不经过 avformat 的探测
+     * @return
+     */
+    bool openRawStream();
+
+    /**
+     * 读取视频流的下一个数据包，保存在 packet 中。裸流由 parser 切分，否则由 av_read_frame 读取
+     * @return 成功返回 0 ，读完返回 AVERROR_EOF ，出错返回其他负值（已打印日志）
+     */
+    int readPacket();
+
+    /**
+     * 解码出下一帧，保存在 frame 中。按需读取数据包，输入读完后冲刷解码器
+     * @return 成功返回 0 ，没有更多的帧返回 AVERROR_EOF ，出错返回其他负值（已打印日志）
+     */
+    int receiveFrame();
+
+    /**
+     * 定位到目标时间或目标帧，转为 Jpeg 并保存到文件
+     * @param inputFilePath  输入的 H265 文件路径
+     * @param seconds        目标时间（秒），frameIndex 小于 0 时有效
+     * @param frameIndex     目标帧序号，小于 0 时按 seconds 定位
+     * @param outputFilePath 输出的 Jpeg 文件路径
+     * @return
+     */
+    bool seekToJpeg(const char *inputFilePath, double seconds, long long frameIndex, const char *outputFilePath);
+
+    /**
+     * Annex-B 裸流没有时间戳，按 NAL 头找到目标之前最近的 IDR 帧，从该位置开始切分、解码到目标帧，结果保存在 frame 中
+     * @param seconds    目标时间（秒），frameIndex 小于 0 时有效
+     * @param frameIndex 目标帧序号，小于 0 时按 seconds 定位
+     * @return
+     */
+    bool seekRawFrame(double seconds, long long frameIndex);
+
+    /**
+     * 用 av_seek_frame 定位到目标之前最近的关键帧，向后解码到目标帧，结果保存在 frame 中。
+     * 码流或解码出的帧没有时间戳时从头解码并计数
+     * @param seconds    目标时间（秒），frameIndex 小于 0 时有效
+     * @param frameIndex 目标帧序号，小于 0 时按 seconds 定位
+     * @return
+     */
+    bool seekFormatFrame(double seconds, long long frameIndex);
+
+    /**
+     * 回到视频流的开头，清空解码器，再逐帧解码到目标帧，结果保存在 frame 中
+     * @param targetFrame 目标帧序号
+     * @return
+     */
+    bool decodeFromStart(long long targetFrame);
+
+    /**
+     * 获取裸流的帧率。H264 直接解析 SPS 中的时间信息，其他情况会切分出第一帧来解析参数集，之后需要用 jumpToKeyFrame 重新定位
+     * @param frameRate 帧率，码流中没有时间信息时为默认的 25
+     * @return
+     */
+    bool rawFrameRate(AVRational &frameRate);
+
+    /**
+     * 把时间换算为该时刻正在显示的帧的序号
+     * @param seconds   时间（秒）
+     * @param frameRate 帧率
+     * @return
+     */
+    static long long secondsToFrame(double seconds, AVRational frameRate);
+
+    /**
+     * 裸流的关键帧索引，第一次调用时加载（优先使用索引文件）
+     * @return
+     */
+    const KeyFrameIndex &rawKeyFrameIndex();
+
+    /**
+     * 清空解码器，从裸流中的 IDR 帧处重新开始切分
+     * @param keyFrame   IDR 帧
+     * @param headerSize 码流开头的参数集的长度，会先于 IDR 帧送入解码器
+     * @return
+     */
+    bool jumpToKeyFrame(const AnnexB::KeyFrame &keyFrame, size_t headerSize);
+
+    /**
+     * 逐帧解码并计数，直到目标帧，结果保存在 frame 中
+     * @param currentFrame 下一个解码出的帧的序号
+     * @param targetFrame  目标帧序号
+     * @return
+     */
+    bool decodeToFrame(long long currentFrame, long long targetFrame);
+
+    /**
+     * 重新创建 parser ，从裸流的指定位置开始切分，不跳过数据
+     * @param offset 开始切分的位置
+     * @return
+     */
+    bool resetRawParser(size_t offset);
+
+    /**
+     * 探测码流、打开解码器并解码出第一帧，结果保存在 frame 中
+     * @return
+     */
+    bool decodeFirstFrame();
+
+    /**
+     * 逐帧解码整个视频，按选项选取帧并保存为 Jpeg ，结束后释放本次输入的资源
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param options       选取帧的方式
+     * @return 输出的图片数，失败返回 -1
+     */
+    int decodeSequence(const char *outputPattern, const ExtractOptions &options);
+
+    /**
+     * 逐帧解码整个视频，按选项选取帧并保存为 Jpeg
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param options       选取帧的方式
+     * @return 输出的图片数，失败返回 -1 （已释放资源）
+     */
+    int decodeAllFrames(const char *outputPattern, const ExtractOptions &options);
+
+    /**
+     * 裸流按时间间隔取帧。根据 NAL 头找出所有 IDR 帧，只解码包含取样点的 GOP ，
+     * 取样点在当前 GOP 内时继续向后解码，否则跳到取样点之前最近的 IDR 帧
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param options       选取帧的方式
+     * @return 输出的图片数，失败返回 -1 （已释放资源）
+     */
+    int sampleRawFrames(const char *outputPattern, const ExtractOptions &options);
+
+    /**
+     * 裸流按 IDR 帧切分成互不依赖的 GOP 段，多个线程各自解码、编码不同的段
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param options       选取帧的方式（All 或 EveryNth）
+     * @return 输出的图片数，失败返回 -1 （已释放资源）
+     */
+    int decodeParallel(const char *outputPattern, const ExtractOptions &options);
+
+    /**
+     * 解码一个 GOP 段并保存为 Jpeg 。由 decodeParallel 的工作线程调用，每个线程一个 Decoder
+     * @param data          裸流数据
+     * @param segmentEnd    段的结束位置（下一个 IDR 帧所在访问单元的起始位置）
+     * @param codecId       编码格式
+     * @param headerSize    码流开头的参数集的长度
+     * @param keyFrame      段开头的 IDR 帧
+     * @param lastFrame     需要解码的最后一帧的序号
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param options       选取帧的方式
+     * @return 输出的图片数，失败返回 -1 （已释放资源）
+     */
+    int decodeSegment(const uint8_t *data, size_t segmentEnd, AVCodecID codecId, size_t headerSize,
+                      const AnnexB::KeyFrame &keyFrame, long long lastFrame, const char *outputPattern,
+                      const ExtractOptions &options);
+
+    /**
+     * 把 frame 编码为 Jpeg ，保存到按序号命名的文件中
+     * @param outputPattern 输出的 Jpeg 文件名模板
+     * @param number        文件的序号
+     * @return 失败时释放资源
+     */
+    bool writeSequenceFrame(const char *outputPattern, int number);
+
+    /**
+     * 解码出第一帧并交给编码器，结束后释放本次输入的资源
+     * @param encoder Jpeg 编码器
+     * @return
+     */
+    bool decodeToEncoder(Encoder &encoder);
+
+    /**
+     * 解码出第一帧，逐级缩小后并行编码为各级的 Jpeg ，结束后释放本次输入的资源
+     * @param levels 各级的尺寸和输出
+     * @return
+     */
+    bool decodeToPyramid(const std::vector<PyramidLevel> &levels);
+
+    /**
+     * 检查多分辨率输出的参数
+     * @param levels 各级的尺寸和输出
+     * @return
+     */
+    static bool checkPyramidLevels(const std::vector<PyramidLevel> &levels);
+
+    /**
+     * 解码出第一帧，裁剪出各个区域分别编码为 Jpeg ，结束后释放本次输入的资源
+     * @param regions 裁剪的区域和输出
+     * @return
+     */
+    bool decodeToCrops(const std::vector<CropRegion> &regions);
+
+    /**
+     * 检查裁剪区域的参数
+     * @param regions 裁剪的区域和输出
+     * @return
+     */
+    static bool checkCropRegions(const std::vector<CropRegion> &regions);
+
+    /**
+     * 不拷贝像素地裁剪一帧：新帧引用原帧的缓冲，各平面的数据指针移动到区域的左上角。
+     * 区域对齐到色度像素的边界，并截掉超出图像的部分
+     * @param src    原帧
+     * @param region 裁剪的区域
+     * @return 裁剪出的帧，由调用方用 av_frame_free 释放。区域在图像之外或失败时返回 nullptr
+     */
+    static AVFrame *cropFrame(const AVFrame *src, const CropRegion &region);
+
+    /**
+     * 解码出第一帧，转移给调用方
+     * @return 解码出的帧，由调用方用 av_frame_free 释放。失败返回 nullptr （已释放资源）
+     */
+    AVFrame *takeFirstFrame();
+
+    /**
+     * 把解码出的帧转为对外的图像，按需转换为 RGB
+     * @param picture 解码出的帧，所有权转移给 decoded ，失败时释放
+     * @param output  输出的像素格式
+     * @param decoded 解码出的图像
+     * @return
+     */
+    static bool exportFrame(AVFrame *picture, PixelOutput output, DecodedFrame &decoded);
+
+    /**
+     * 以 mmap 的方式打开 Annex-B 裸流文件
+     * @param inputFilePath 输入的 H265 文件路径
+     * @return 不是裸流或打开失败时返回 false ，此时应交给 avformat 处理
+     */
+    bool openRawInput(const char *inputFilePath);
+
+    /**
+     * 判断输入是否为 Annex-B 裸流，并确定编码格式（保存在 rawCodecId 中）。
+     * 指定了编码格式时分派到对应的特化实现
+     * @param data 数据
+     * @param size 数据长度
+     * @return
+     */
+    bool detectRawCodec(const uint8_t *data, size_t size);
+
+    /**
+     * 编码格式已知时的特化实现
+     * @tparam Traits 编码格式对应的 CodecTraits
+     */
+    template<typename Traits>
+    bool detectRawCodec(const uint8_t *data, size_t size);
+
+    /**
+     * 指定了编码格式时返回对应的解复用器，用于跳过 avformat 的格式探测
+     * @return 自动探测时返回 nullptr
+     */
+    AVInputFormat *inputFormat() const;
+
+    /**
+     * 根据配置生成 avformat_open_input 的附加选项（probesize 、analyzeduration）
+     * @return 由调用方释放
+     */
+    AVDictionary *formatOptions() const;
+
+    /**
+     * 判断已打开的解码器能否直接用于新的码流
+     * @param codecId 新码流的编码格式
+     * @param width   新码流的宽度，未知时为 0
+     * @param height  新码流的高度，未知时为 0
+     * @return 常驻模式下编码格式和分辨率都相同时返回 true
+     */
+    bool canReuseCodec(AVCodecID codecId, int width, int height) const;
+
+    /**
+     * 重新创建并打开解码器
+     * @param codecId  编码格式
+     * @param codecPar 码流的解码器参数，裸流没有时为 nullptr
+     * @return
+     */
+    bool openCodec(AVCodecID codecId, const AVCodecParameters *codecPar);
+
+    /**
+     * 按线程策略决定解码器的线程数，在打开解码器之前调用
+     * @param codecId  编码格式
+     * @param codecPar 码流的解码器参数，裸流没有时为 nullptr
+     * @return 1 表示单线程，大于 1 时使用 slice 线程
+     */
+    int decodeThreadCount(AVCodecID codecId, const AVCodecParameters *codecPar) const;
+
+    /**
+     * 申请 frame 和 packet （已申请时直接复用）
+     * @return
+     */
+    bool prepareFrameAndPacket();
+
     /**
      * 释放资源
      */
     void release();
 
+    /**
+     * 释放与单次输入相关的资源（fmtCtx 、自定义 IO ）
+     */
+    void releaseInput();
+
+    /**
+     * 释放解码器相关的资源（codecCtx 、frame 、packet ）
+     */
+    void releaseCodec();
+
+    /**
+     * 单次转换结束后释放资源。常驻模式下保留解码器相关的资源
+     */
+    void finishInput();
+
 private:
+    DecoderConfig config;    /* 解码器配置 */
     AVFormatContext *fmtCtx; /* ffmpeg 的全局上下文，所有 ffmpeg 都需要 */
     AVCodecContext *codecCtx;    /* ffmpeg 编解码上下文 */
     AVFrame *frame;          /* ffmpeg 单帧缓存 */
     AVPacket *packet;        /* ffmpeg 单帧数据包 */
+    AVIOContext *ioCtx;      /* 自定义 IO 上下文，仅在解码内存数据时使用 */
+    std::shared_ptr<Input> inputCursor; /* 内存数据的读取位置 */
+    int streamIndex;         /* 视频流的索引 */
+    AVDiscard frameDiscard;  /* 解码时丢弃帧的策略，只取关键帧时为 AVDISCARD_NONKEY */
+    long long decodedFrames; /* 本次输入已解码的帧数 */
+    AVCodecParserContext *parserCtx; /* Annex-B 裸流的 parser */
+    const uint8_t *rawData;  /* Annex-B 裸流数据，不为空时走 parser 快速路径 */
+    size_t rawSize;          /* Annex-B 裸流数据的长度 */
+    size_t rawOffset;        /* Annex-B 裸流已送入 parser 的长度 */
+    size_t rawSkipFrom;      /* 切分到此位置时跳到 rawSkipTo ，用于从 IDR 帧处开始解码 */
+    size_t rawSkipTo;
+    AVCodecID rawCodecId;    /* Annex-B 裸流的编码格式 */
+    void *mappedFile;        /* mmap 的输入文件 */
+    size_t mappedSize;       /* mmap 的长度 */
+    std::string rawPath;     /* Annex-B 裸流的文件路径，输入是内存数据时为空 */
+    KeyFrameIndex keyFrameIndex; /* Annex-B 裸流的关键帧索引，第一次随机访问时加载 */
+    std::unique_ptr<TaskScheduler> levelEncoders; /* 并行编码多分辨率输出的工作线程，第一次使用时创建，在调用之间复用，级数变多时重建 */
 };
 
 #endif  // H265TOJPEG_DECODER_H
\ No newline at end of file
@@ -2,12 +2,18 @@
 // Created by lixiaoqing on 2021/5/21.
 //
 
+#include <algorithm>
 #include "Encoder.h"
-
-/**
- * Jpeg 数据结构
- */
-//Output * outputData = nullptr;
+#include "EncoderCache.h"
+#include "ScaleCache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/pixdesc.h"
+#ifdef __cplusplus
+}
+#endif
 
 /**
  * 日志
@@ -18,33 +24,73 @@ extern void LOG(const char *format, ...);
 
 
 /**
- * 写文件的回调函数
- * @param opaque
- * @param buf
- * @param buf_size
- * @return
+ * 选择 Jpeg 编码器输入的像素格式。
+ * 8 位的 4:2:0/4:2:2/4:4:4 平面格式与对应的 YUVJ 格式内存布局相同，直接编码；
+ * 其他格式（10 位、半平面等）先用 swscale 转换为采样方式最接近的 8 位平面格式。
+ * 转换保持原来的取值范围，与直接编码的 8 位帧一致
+ * @param format     帧的像素格式
+ * @param range      帧的取值范围
+ * @param jpegFormat 编码器输入的像素格式（YUVJ420P/YUVJ422P/YUVJ444P）
+ * @return 需要转换时返回转换的目标格式，可以直接编码时返回 AV_PIX_FMT_NONE
  */
-int writeCallback(void *opaque, uint8_t *buf, int buf_size) {
-    Output *outputData = (Output *) opaque;
-    memcpy(outputData->jpeg_data + outputData->offset, buf, buf_size);
-    outputData->offset += buf_size;
-    if (DEBUG) {
-        LOG("%s | data->offset=%d, buf_size=%d", __PRETTY_FUNCTION__, outputData->offset, buf_size);
+static AVPixelFormat selectJpegFormat(const AVPixelFormat format, const AVColorRange range,
+                                      AVPixelFormat &jpegFormat) {
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            jpegFormat = AV_PIX_FMT_YUVJ420P;
+            return AV_PIX_FMT_NONE;
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+            jpegFormat = AV_PIX_FMT_YUVJ422P;
+            return AV_PIX_FMT_NONE;
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+            jpegFormat = AV_PIX_FMT_YUVJ444P;
+            return AV_PIX_FMT_NONE;
+        default:
+            break;
+    }
+
+    // 按色度的采样方式选择，没有色度（灰度）时按 4:2:0
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    jpegFormat = AV_PIX_FMT_YUVJ420P;
+    if (desc && desc->nb_components >= 3 && desc->log2_chroma_h == 0) {
+        jpegFormat = desc->log2_chroma_w == 0 ? AV_PIX_FMT_YUVJ444P : AV_PIX_FMT_YUVJ422P;
+    }
+
+    // RGB 和全范围的输入转换为全范围的 YUVJ ，限制范围的输入转换为同样是限制范围的 YUV
+    bool fullRange = range == AVCOL_RANGE_JPEG || (desc && (desc->flags & AV_PIX_FMT_FLAG_RGB));
+    if (fullRange) {
+        return jpegFormat;
+    }
+    switch (jpegFormat) {
+        case AV_PIX_FMT_YUVJ444P:
+            return AV_PIX_FMT_YUV444P;
+        case AV_PIX_FMT_YUVJ422P:
+            return AV_PIX_FMT_YUV422P;
+        default:
+            return AV_PIX_FMT_YUV420P;
     }
-    return buf_size;
 }
 
 
-Encoder::Encoder(const char * const outputFilePath) {
-    this->outputFilePath = outputFilePath;
-    pIOCtx = nullptr;      /* ffmpeg 字节流 IO 上下文 */
-    pFormatCtx = nullptr;  /* ffmpeg 的全局上下文，所有 ffmpeg 都需要 */
+Encoder::Encoder() : Encoder((IOutputSink *) nullptr) {
+}
+
+Encoder::Encoder(const char * const outputFilePath) : Encoder((IOutputSink *) nullptr) {
+    if (outputFilePath == nullptr || strlen(outputFilePath) == 0) {
+        LOG("Jpeg 文件路径为空，请核查！");
+    }
+    // 路径为空时 FdSink 打开失败，编码会返回 false
+    fileSink.reset(new FdSink(outputFilePath));
+    sink = fileSink.get();
+}
+
+Encoder::Encoder(IOutputSink * const sink) {
+    this->sink = sink;
     pCodeCtx = nullptr;    /* ffmpeg 编解码上下文 */
-    pCodec = nullptr;      /* ffmpeg 编解码器 */
-    pCodecPars = nullptr;  /* ffmpeg 编解码器参数 */
-    pStream = nullptr;     /* ffmpeg 视频流 */
-    packet = nullptr;      /* ffmpeg 单帧数据包 */
-    ioBuf = nullptr;       /* IO Buffer */
+    jpegPacket = nullptr;  /* 编码后的 Jpeg 数据包 */
 }
 
 Encoder::~Encoder() {
@@ -52,311 +98,158 @@ Encoder::~Encoder() {
         LOG("%s", __PRETTY_FUNCTION__);
     }
     release();
+    EncoderCache::current().releasePacket(jpegPacket);
+    jpegPacket = nullptr;
 }
 
 void Encoder::release() {
     if (DEBUG) {
         LOG("%s", __PRETTY_FUNCTION__);
     }
-//    if (outputData) {
-//        delete outputData;
-//        outputData = nullptr;
-//    }
-    if (ioBuf) {
-        // 释放 IO Buffer
-        av_freep(&ioBuf);
-        ioBuf = nullptr;
-    }
-    if (pIOCtx) {
-        // 释放 IO 上下文
-        avio_context_free(&pIOCtx);
-        pIOCtx = nullptr;
-    }
-    if (pFormatCtx) {
-        // 关闭 ffmpeg 上下文
-        avformat_close_input(&pFormatCtx);
-        pFormatCtx = nullptr;
-    }
     if (pCodeCtx) {
-        // 关闭解码器
-        avcodec_free_context(&pCodeCtx);
+        // 归还给 EncoderCache ，缓存的编码器留待复用，其他的释放
+        EncoderCache::current().release(pCodeCtx);
         pCodeCtx = nullptr;
     }
-    if (packet) {
-        // 释放数据包
-        av_packet_free(&packet);
-        packet = nullptr;
-    }
-    if (pCodec) {
-        pCodec = nullptr;
-    }
-    if (pCodecPars) {
-        pCodecPars = nullptr;
-    }
-    if (pStream) {
-        pStream = nullptr;
-    }
-    if (outputFilePath) {
-        outputFilePath = nullptr;
-    }
 }
 
-bool Encoder::yuv2Jpeg(AVFrame *pFrame) {
+bool Encoder::yuv2Jpeg(AVFrame *pFrame, const int maxDimension, const int qscale) {
 
     // 用于输出错误日志
     char errorBuf[STACK_SIZE];
 
-    // IO Buffer
-    ioBuf = (unsigned char *)av_malloc(HEAP_SIZE);
-    if (!ioBuf) {
-        LOG("%s line=%d | av_malloc failed", __PRETTY_FUNCTION__, __LINE__);
-        release();
-        return false;
-    }
-
-    // 构建输出数据的结构
-    bool isOk = constructOutputData();
-    if (!isOk) {
-        LOG("constructOutputData failed.");
-        return false;
-    }
-
-    // 初始化 AVIOContext。将 outputData 中数据写入到 outBuf 中
-    pIOCtx = avio_alloc_context(ioBuf, HEAP_SIZE, 1, outputData.get(), NULL, writeCallback, NULL);
-    if (!pIOCtx) {
-        LOG("%s line=%d | avio_alloc_context failed.", __PRETTY_FUNCTION__, __LINE__);
-        release();
-        return false;
-    }
-
-    /**
-     * int avformat_alloc_output_context2(AVFormatContext **ctx, ff_const59 AVOutputFormat *oformat,
-                                   const char *format_name, const char *filename);
-     * 初始化一个用于输出的 AVFormatContext 结构体
-     * 参考：https://blog.csdn.net/leixiaohua1020/article/details/41198929
-     */
-
-    // 打开输出文件，初始化输出视频码流的 AVFormatContext
-    int ret = avformat_alloc_output_context2(&pFormatCtx, NULL, "mjpeg", NULL);
-    if(ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("avformat_alloc_output_context2 failed, ret=%d, error=%s", ret, errorBuf);
-        release();
-        return false;
-    }
-
-    pFormatCtx->pb    = pIOCtx;
-    pFormatCtx->flags = AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
-
-    // 创建输出码流的 AVStream
-    pStream = avformat_new_stream(pFormatCtx, NULL);
-    if (pStream == NULL) {
-        LOG("avformat_new_stream failed");
-        release();
-        return false;
-    }
-
-    pCodecPars             = pStream->codecpar;
-    pCodecPars->codec_id   = pFormatCtx->oformat->video_codec;
-    pCodecPars->codec_type = AVMEDIA_TYPE_VIDEO;
-    pCodecPars->format     = AV_PIX_FMT_YUVJ420P;
-    pCodecPars->width      = pFrame->width;
-    pCodecPars->height     = pFrame->height;
-
     if(DEBUG) {
         LOG("解码后原始数据类型：%d", pFrame->format);  // format 是 AVPixelFormat 类型
         LOG("是否是关键帧：%d", pFrame->key_frame);
         LOG("帧类型：%d", pFrame->pict_type);
         LOG("帧时间戳：%lld", pFrame->pts);
-        LOG("codec_id=%d", pCodecPars->codec_id);
         LOG("pFrame->width=%d, pFrame->height=%d", pFrame->width, pFrame->height);
     }
 
-    // 通过 id 查找一个匹配的已经注册的音视频编码器
-    pCodec = avcodec_find_encoder(pCodecPars->codec_id);
-    if (!pCodec) {
-        LOG("Could not find encoder");
-        release();
-        return false;
-    }
-
-    // 申请 AVCodecContext 空间
-    pCodeCtx = avcodec_alloc_context3(pCodec);
+    // 编码器不支持的像素格式先转换，需要缩略图时先缩小（与格式转换一起完成）。
+    // 转换上下文和输出帧由当前线程缓存，相同规格的帧无需重复创建
+    AVPixelFormat pixFmt;
+    AVPixelFormat convertFormat = selectJpegFormat((AVPixelFormat) pFrame->format, pFrame->color_range, pixFmt);
+    int dstWidth, dstHeight;
+    thumbnailSize(pFrame->width, pFrame->height, maxDimension, dstWidth, dstHeight);
+    if (convertFormat != AV_PIX_FMT_NONE || dstWidth != pFrame->width || dstHeight != pFrame->height) {
+        if (convertFormat == AV_PIX_FMT_NONE) {
+            convertFormat = (AVPixelFormat) pFrame->format;
+        }
+        pFrame = ScaleCache::current().convert(pFrame, dstWidth, dstHeight, convertFormat);
+        if (!pFrame) {
+            LOG("%s line=%d | 像素格式转换失败", __PRETTY_FUNCTION__, __LINE__);
+            release();
+            return false;
+        }
+    }
+
+    // 固定量化参数时从当前线程的缓存中取出已打开的 Jpeg 编码器，相同规格的帧无需重复创建和打开
+    pCodeCtx = EncoderCache::current().acquire(pFrame->width, pFrame->height, pixFmt, qscale);
     if (!pCodeCtx) {
-        fprintf(stderr, "Could not allocate video codec context\n");
+        LOG("%s line=%d | 获取 Jpeg 编码器失败", __PRETTY_FUNCTION__, __LINE__);
         release();
         return false;
     }
 
-    // 替换编码器 AVCodecContext 上下文参数
-    ret = avcodec_parameters_to_context(pCodeCtx, pCodecPars);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to copy %s codec pCodecPars to decoder context\n",
-                av_get_media_type_string(AVMEDIA_TYPE_VIDEO));
-        release();
-        return false;
+    // 从当前线程借出数据包，上一次编码的结果在这里释放
+    EncoderCache &cache = EncoderCache::current();
+    if (jpegPacket) {
+        av_packet_unref(jpegPacket);
+    } else {
+        jpegPacket = cache.acquirePacket();
     }
-
-    // 设置时基。该字段解码时无需设置，编码时需要用户手动指定
-    pCodeCtx->time_base = (AVRational) {1, 25};
-
-    // 打开编码器
-    ret = avcodec_open2(pCodeCtx, pCodec, NULL);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("Could not open codec, ret=%d, error=%s", ret, errorBuf);
+    if (!jpegPacket) {
+        LOG("%s line=%d | 申请数据包失败", __PRETTY_FUNCTION__, __LINE__);
         release();
         return false;
     }
 
-    /**
-     * int avformat_write_header(AVFormatContext *s, AVDictionary **options);
-     * 把流头信息写入到媒体文件中。成功返回 0
-     *   s      : ffmpeg 上下文
-     *   options: 额外选项
-     */
+    // 缓存的编码器被复用，时间戳必须单调递增；单张 Jpeg 不需要时间戳，编码时先去掉
+    const int64_t pts = pFrame->pts;
+    pFrame->pts = AV_NOPTS_VALUE;
 
-    // 写视频文件头
-    ret = avformat_write_header(pFormatCtx, NULL);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("avformat_write_header failed, ret=%d, error=%s", ret, errorBuf);
-        release();
-        return false;
-    }
-
-    /**
-     * AVPacket *av_packet_alloc(void);
-     * 创建 AVPacket
-     */
-
-    packet = av_packet_alloc();
-    if (!packet) {
-        LOG("av_packet_alloc failed");
-        release();
-        return false;
-    }
-
-    // 给AVPacket分配足够大的空间
-    ret = av_new_packet(packet, pFrame->width * pFrame->height * 3);
-    if (ret != 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("av_new_packet failed, ret=%d, error=%s", ret, errorBuf);
-        release();
-        return false;
+    // 编码数据。固定量化参数模式下，编码器从帧上读取质量
+    const int quality = pFrame->quality;
+    if (pCodeCtx->flags & AV_CODEC_FLAG_QSCALE) {
+        pFrame->quality = pCodeCtx->global_quality;
     }
-
-    // 编码数据
-    ret = avcodec_send_frame(pCodeCtx, pFrame);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("Could not avcodec_send_frame, ret=%d, error=%s", ret, errorBuf);
-        release();
-        return false;
+    int ret = avcodec_send_frame(pCodeCtx, pFrame);
+    if (ret >= 0) {
+        // MJPEG 没有延迟，送入一帧即可取出一个数据包。数据包引用 ffmpeg 分配的缓冲，直接作为输出，不再拷贝
+        ret = avcodec_receive_packet(pCodeCtx, jpegPacket);
     }
+    pFrame->pts = pts;
+    pFrame->quality = quality;
 
-    // 得到编码后数据
-    ret = avcodec_receive_packet(pCodeCtx, packet);
-    if (ret < 0) {
-        av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("avcodec_receive_packet failed, ret=%d, error=%s", ret, errorBuf);
-        release();
-        return false;
-    }
-
-//    pkt.pts = av_rescale_q(pkt.pts, pCodeCtx->time_base, pStream->time_base);
-//    av_packet_rescale_ts(&pkt, pCodeCtx->time_base, pStream->time_base);
-
-    /**
-     * int av_write_frame(AVFormatContext *s, AVPacket *pkt);
-     * 输出一帧音视频数据
-     *   s  : AVFormatContext 输出上下文
-     *   pkt: 待输出的 AVPacket
-     */
-
-    // 写视频数据
-    ret = av_write_frame(pFormatCtx, packet);
     if (ret < 0) {
         av_strerror(ret, errorBuf, STACK_SIZE);
-        LOG("av_write_frame failed, ret=%d, error=%s", ret, errorBuf);
+        LOG("Could not encode frame, ret=%d, error=%s", ret, errorBuf);
+        cache.discard(pCodeCtx);
+        pCodeCtx = nullptr;
+        av_packet_unref(jpegPacket);
         release();
         return false;
     }
+    EncoderCache::record(jpegPacket);
 
-    // 强制清除缓存中的数据
-    avio_flush(pIOCtx);
-
-    // 写视频文件尾
-    ret = av_write_trailer(pFormatCtx);
-    if (ret < 0) {
-        LOG("av_write_trailer fail, ret = %d", ret);
+    // 把数据包的缓冲按引用交给输出端，不做拷贝。未指定输出端时，数据保留在 jpegPacket 中
+    if (sink && !writeToSink()) {
+        LOG("%s line=%d | 输出 Jpeg 数据出错！", __PRETTY_FUNCTION__, __LINE__);
         release();
         return false;
     }
 
-    // 将 jpeg 数据写入文件
-    isOk = saveJpegtoFile(this->outputFilePath);
-    if (!isOk) {
-        LOG("%s line=%d | 保存 Jpeg 文件出错！Jpeg 文件路径：%s", __PRETTY_FUNCTION__, __LINE__, this->outputFilePath);
-        return false;
-    }
-
-    // 此处无需调用 release(), 因为此类在析构时会自动调用 release()
+    // 数据包保留到下一次编码或析构，供 getJpegData() 使用
     release();
 
     return true;
 }
 
-/**
- * 构建输出数据
- * @return
- */
-bool Encoder::constructOutputData() {
-    char *outputBuf = (char *) malloc(HEAP_SIZE * sizeof(char));
-    if (!outputBuf) {
-        LOG("%s line=%d | malloc failed.", __PRETTY_FUNCTION__, __LINE__);
-        return false;
-    }
+const uint8_t *Encoder::getJpegData() const {
+    return jpegPacket ? jpegPacket->data : nullptr;
+}
 
-    memset(outputBuf, 0, HEAP_SIZE);
+int Encoder::getJpegSize() const {
+    return jpegPacket ? jpegPacket->size : 0;
+}
 
-//    outputData = new Output();
-    outputData = std::make_shared<Output>();
-    if (!outputData) {
-        LOG("%s line=%d | malloc failed.", __PRETTY_FUNCTION__, __LINE__);
-        free(outputBuf);
-        outputBuf = nullptr;
+bool Encoder::writeToSink() {
+    // 输出端拿到的是数据包缓冲的一个引用，可以在 Encoder 析构后继续持有
+    if (av_packet_make_refcounted(jpegPacket) < 0) {
         return false;
     }
-
-    outputData->jpeg_data = outputBuf;
-    outputData->offset = 0;
-
-    return true;
-}
-
-bool Encoder::saveJpegtoFile(const char * const filePath) {
-
-    if (filePath == nullptr || strlen(filePath) == 0) {
-        LOG("Jpeg 文件路径为空，请核查！");
+    AVBufferRef *ref = av_buffer_ref(jpegPacket->buf);
+    if (!ref) {
         return false;
     }
+    std::shared_ptr<const unsigned char> data(jpegPacket->data, [ref](const unsigned char *) mutable {
+        av_buffer_unref(&ref);
+    });
+    return sink->writeJpeg(data, (size_t) jpegPacket->size);
+}
 
-    FILE *fp_write = fopen(filePath, "wb+");
-    if (!fp_write) {
-        LOG("%s line=%d | Open file error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath, errno);
-        return false;
+void Encoder::thumbnailSize(const int width, const int height, const int maxDimension, int &dstWidth,
+                            int &dstHeight) {
+    dstWidth = width;
+    dstHeight = height;
+    const int longest = std::max(width, height);
+    if (maxDimension <= 0 || longest <= maxDimension) {
+        return;
     }
 
-    // 将 jpeg 数据写到文件
-    size_t ret = fwrite(outputData->jpeg_data, 1, outputData->offset, fp_write);
-    if (ret == 0) {
-        LOG("%s line=%d | fwrite error! Jpeg 文件路径：%s", __PRETTY_FUNCTION__, __LINE__, filePath);
-        fclose(fp_write);
-        return false;
+    // 整数倍缩小
+    int factor = (longest + maxDimension - 1) / maxDimension;
+    if (longest % maxDimension == 0 && width % factor == 0 && height % factor == 0) {
+        dstWidth = width / factor;
+        dstHeight = height / factor;
+        return;
     }
 
-    LOG("保存 Jpeg 数据到文件: %s", filePath);
-    fclose(fp_write);
-    return true;
-}
\ No newline at end of file
+    // 其他比例
+    dstWidth = std::max(2, (int) (((long long) width * maxDimension / longest + 1) & ~1LL));
+    dstHeight = std::max(2, (int) (((long long) height * maxDimension / longest + 1) & ~1LL));
+    dstWidth = std::min(dstWidth, maxDimension);
+    dstHeight = std::min(dstHeight, maxDimension);
+}
+
@@ -21,6 +21,7 @@ extern "C" {
 
 #include <memory>
 #include "Common.h"
+#include "OutputSink.h"
 
 
 /**
@@ -30,57 +31,76 @@ class Encoder {
 
 public:
 
+    /**
+     * 构造函数。不指定输出，编码结果通过 getJpegData() 获取
+     */
+    Encoder();
+
     /**
      * 构造函数
      * @param outputFilePath 输出文件的路径
      */
     explicit Encoder(const char * outputFilePath);
 
+    /**
+     * 构造函数
+     * @param sink 输出端，由调用方管理生命周期。为 nullptr 时编码结果通过 getJpegData() 获取
+     */
+    explicit Encoder(IOutputSink * sink);
+
     ~Encoder();
 
     /**
      * 将 yuv 编码为 Jpeg 并保存
-     * @param pFrame YUV 帧数据
+     * @param pFrame       YUV 帧数据
+     * @param maxDimension 输出图片的最长边（像素），超过时先按比例缩小再编码。为 0 时保持原始分辨率
+     * @param qscale       量化参数（1~31），为 0 时由码率控制选择
      * @return
      */
-    bool yuv2Jpeg(AVFrame *pFrame);
-
-private:
+    bool yuv2Jpeg(AVFrame *pFrame, int maxDimension = 0, int qscale = 0);
 
     /**
-     * 释放资源
+     * 获取编码后的 Jpeg 数据。MJPEG 编码器输出的数据包就是一张完整的 Jpeg ，这里直接返回数据包的内容，不做拷贝
+     * @return 数据在下一次编码或 Encoder 析构前有效
      */
-    void release();
+    const uint8_t *getJpegData() const;
 
     /**
-     * 将 jpeg 数据保存到文件
-     * @param filePath Jpeg 文件路径
+     * 获取编码后的 Jpeg 数据长度
      * @return
      */
-    bool saveJpegtoFile(const char * filePath);
+    int getJpegSize() const;
 
     /**
-     * 构建输出数据
-     * @return
+     * 计算缩略图的尺寸：按比例缩小到最长边不超过 maxDimension 。
+     * 原图的宽高正好是目标的整数倍时取该倍数，可以走 SIMD 的盒式滤波；否则四舍五入到偶数，便于色度平面对齐
+     * @param width        原图宽度
+     * @param height       原图高度
+     * @param maxDimension 最长边，为 0 时不缩小
+     * @param dstWidth     缩略图宽度
+     * @param dstHeight    缩略图高度
      */
-    bool constructOutputData();
+    static void thumbnailSize(int width, int height, int maxDimension, int &dstWidth, int &dstHeight);
 
 private:
 
     /**
-     * Jpeg 数据结构
+     * 释放资源
+     */
+    void release();
+
+    /**
+     * 将 jpeg 数据包的缓冲按引用交给输出端
+     * @return
      */
-    std::shared_ptr<Output> outputData;
-
-    const char * outputFilePath;    /* 输出文件的路径 */
-    unsigned char *ioBuf;           /* IO Buffer */
-    AVIOContext *pIOCtx;            /* ffmpeg 字节流 IO 上下文 */
-    AVFormatContext *pFormatCtx;    /* ffmpeg 的全局上下文，所有 ffmpeg 都需要 */
-    AVCodecContext *pCodeCtx;       /* ffmpeg 编解码上下文 */
-    AVCodec *pCodec;                /* ffmpeg 编解码器 */
-    AVCodecParameters *pCodecPars;  /* ffmpeg 编解码器参数 */
-    AVStream *pStream;              /* ffmpeg 视频流 */
-    AVPacket *packet;               /* ffmpeg 单帧数据包 */
+    bool writeToSink();
+
+private:
+
+    IOutputSink *sink;              /* 输出端 */
+    std::unique_ptr<FdSink> fileSink; /* 按文件路径输出时自己创建的输出端 */
+    AVCodecContext *pCodeCtx;       /* ffmpeg 编解码上下文，从 EncoderCache 取出 */
+    AVPacket *jpegPacket;           /* 编码后的 Jpeg 数据包，从 EncoderCache 借出，缓冲由 ffmpeg 按引用计数管理 */
 
 };
 
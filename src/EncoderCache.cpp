@@ -0,0 +1,177 @@
+#include "EncoderCache.h"
+
+std::atomic<unsigned long long> EncoderCache::encodeCount(0);
+std::atomic<unsigned long long> EncoderCache::allocationCount(0);
+std::atomic<unsigned long long> EncoderCache::allocationBytes(0);
+std::atomic<unsigned long long> EncoderCache::openCount(0);
+
+EncoderCache &EncoderCache::current() {
+    // 线程退出时自动析构，释放该线程缓存的所有编码器
+    static thread_local EncoderCache cache;
+    return cache;
+}
+
+EncoderCache::Stats EncoderCache::stats() {
+    Stats stats;
+    stats.encodes = encodeCount.load(std::memory_order_relaxed);
+    stats.heapAllocations = allocationCount.load(std::memory_order_relaxed);
+    stats.heapBytes = allocationBytes.load(std::memory_order_relaxed);
+    stats.encoderOpens = openCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void EncoderCache::record(const AVPacket *const packet) {
+    encodeCount.fetch_add(1, std::memory_order_relaxed);
+    if (packet->buf) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add((unsigned long long) packet->buf->size, std::memory_order_relaxed);
+    }
+}
+
+EncoderCache::~EncoderCache() {
+    for (auto &item : contexts) {
+        avcodec_free_context(&item.second.codecCtx);
+    }
+    contexts.clear();
+    for (AVPacket *packet : packets) {
+        av_packet_free(&packet);
+    }
+    packets.clear();
+}
+
+AVCodecContext *EncoderCache::acquire(const int width, const int height, const AVPixelFormat pixFmt,
+                                      const int qscale) {
+    // 码率控制的编码器不能复用，每张图新建一个
+    if (qscale <= 0) {
+        return open(width, height, pixFmt, 0);
+    }
+
+    Key key = {width, height, pixFmt, qscale};
+    auto it = contexts.find(key);
+    if (it != contexts.end()) {
+        it->second.lastUsed = ++useTick;
+        return it->second.codecCtx;
+    }
+
+    AVCodecContext *codecCtx = open(width, height, pixFmt, qscale);
+    if (!codecCtx) {
+        return nullptr;
+    }
+
+    // 缓存已满时淘汰最久没有使用的一个，避免分辨率种类很多时无限增长，常用的分辨率一直保留
+    if (contexts.size() >= ENCODER_CACHE_CAPACITY) {
+        evictLeastRecentlyUsed();
+    }
+    contexts[key] = {codecCtx, ++useTick};
+    return codecCtx;
+}
+
+void EncoderCache::release(AVCodecContext *codecCtx) {
+    if (codecCtx && !(codecCtx->flags & AV_CODEC_FLAG_QSCALE)) {
+        avcodec_free_context(&codecCtx);
+    }
+}
+
+void EncoderCache::discard(AVCodecContext *codecCtx) {
+    for (auto it = contexts.begin(); it != contexts.end(); ++it) {
+        if (it->second.codecCtx == codecCtx) {
+            avcodec_free_context(&it->second.codecCtx);
+            contexts.erase(it);
+            return;
+        }
+    }
+    // 不在缓存中的直接释放
+    avcodec_free_context(&codecCtx);
+}
+
+AVPacket *EncoderCache::acquirePacket() {
+    if (!packets.empty()) {
+        AVPacket *packet = packets.back();
+        packets.pop_back();
+        return packet;
+    }
+    AVPacket *packet = av_packet_alloc();
+    if (packet) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(sizeof(AVPacket), std::memory_order_relaxed);
+    }
+    return packet;
+}
+
+void EncoderCache::releasePacket(AVPacket *packet) {
+    if (!packet) {
+        return;
+    }
+    av_packet_unref(packet);
+    if (packets.size() >= PACKET_POOL_CAPACITY) {
+        av_packet_free(&packet);
+        return;
+    }
+    packets.push_back(packet);
+}
+
+void EncoderCache::evictLeastRecentlyUsed() {
+    auto oldest = contexts.begin();
+    for (auto it = contexts.begin(); it != contexts.end(); ++it) {
+        if (it->second.lastUsed < oldest->second.lastUsed) {
+            oldest = it;
+        }
+    }
+    if (oldest != contexts.end()) {
+        avcodec_free_context(&oldest->second.codecCtx);
+        contexts.erase(oldest);
+    }
+}
+
+AVCodecContext *EncoderCache::open(const int width, const int height, const AVPixelFormat pixFmt, const int qscale) {
+
+    // 用于输出错误日志
+    char errorBuf[STACK_SIZE];
+
+    // 通过 id 查找一个匹配的已经注册的音视频编码器
+    AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        LOG("Could not find encoder");
+        return nullptr;
+    }
+
+    // 申请 AVCodecContext 空间
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    if (!codecCtx) {
+        LOG("Could not allocate video codec context");
+        return nullptr;
+    }
+
+    codecCtx->codec_type = AVMEDIA_TYPE_VIDEO;
+    codecCtx->pix_fmt = pixFmt;
+    codecCtx->width = width;
+    codecCtx->height = height;
+
+    // 设置时基。该字段解码时无需设置，编码时需要用户手动指定
+    codecCtx->time_base = (AVRational) {1, 25};
+
+    if (qscale > 0) {
+        // 使用固定量化参数编码，每帧的质量由 AVFrame::quality 指定
+        codecCtx->flags |= AV_CODEC_FLAG_QSCALE;
+        codecCtx->global_quality = FF_QP2LAMBDA * qscale;
+    } else {
+        // 码率控制。与按流参数创建的编码器一致，不设目标码率，由编码器按图像内容选择量化参数
+        codecCtx->bit_rate = 0;
+    }
+
+    // 打开编码器
+    int ret = avcodec_open2(codecCtx, codec, nullptr);
+    if (ret < 0) {
+        av_strerror(ret, errorBuf, STACK_SIZE);
+        LOG("Could not open codec, ret=%d, error=%s", ret, errorBuf);
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+    openCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (DEBUG) {
+        LOG("%s | 新建 Jpeg 编码器：width=%d, height=%d, pixFmt=%d, qscale=%d", __PRETTY_FUNCTION__, width, height,
+            pixFmt, qscale);
+    }
+    return codecCtx;
+}
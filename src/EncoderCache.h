@@ -0,0 +1,161 @@
+#ifndef H265TOJPEG_ENCODERCACHE_H
+#define H265TOJPEG_ENCODERCACHE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavcodec/avcodec.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include "Common.h"
+
+/* 每个线程最多缓存的 Jpeg 编码器个数 */
+#define ENCODER_CACHE_CAPACITY 8
+
+/* 每个线程最多保留的空闲数据包个数 */
+#define PACKET_POOL_CAPACITY 16
+
+
+/**
+ * Jpeg 编码器缓存。
+ * 每个线程各自持有一份，按 (宽, 高, 像素格式, 量化参数) 缓存已打开的固定量化参数的 MJPEG AVCodecContext ，
+ * 同一线程后续相同规格的帧直接复用，省去查找、创建和打开编码器的开销。
+ * 使用码率控制的编码器会把上一帧的状态带到下一帧，不缓存，每次都新建一个，用完由 release() 释放。
+ * 同时缓存接收编码结果的 AVPacket 结构，数据包的缓冲仍由 ffmpeg 按引用计数分配和释放。
+ * 由于是线程私有的，取出的编码器上下文只能在当前线程中使用
+ */
+class EncoderCache {
+
+public:
+
+    /**
+     * 分配统计（所有线程汇总）
+     */
+    struct Stats {
+        unsigned long long encodes;         /* 编码次数 */
+        unsigned long long heapAllocations; /* 申请内存的次数：新建的 AVPacket 结构和 ffmpeg 为编码结果分配的数据包缓冲 */
+        unsigned long long heapBytes;       /* 申请的总字节数 */
+        unsigned long long encoderOpens;    /* 新建并打开的编码器个数 */
+    };
+
+    /**
+     * 获取当前线程的编码器缓存
+     * @return
+     */
+    static EncoderCache &current();
+
+    /**
+     * 获取所有线程汇总的分配统计
+     * @return
+     */
+    static Stats stats();
+
+    /**
+     * 记录一次编码得到的数据包。数据包带有缓冲引用时，该缓冲是 ffmpeg 为这次编码新分配的
+     * @param packet 编码得到的数据包
+     */
+    static void record(const AVPacket *packet);
+
+    ~EncoderCache();
+
+    EncoderCache(const EncoderCache &obj) = delete;
+
+    EncoderCache &operator=(const EncoderCache &obj) = delete;
+
+    /**
+     * 获取已打开的 Jpeg 编码器。指定了量化参数时从缓存中取，缓存中没有时创建一个；否则总是新建
+     * @param width  图像宽度
+     * @param height 图像高度
+     * @param pixFmt 编码器输入的像素格式
+     * @param qscale 量化参数（1~31），为 0 时使用码率控制
+     * @return 编码器上下文，用完后调用 release() 。失败返回 nullptr
+     */
+    AVCodecContext *acquire(int width, int height, AVPixelFormat pixFmt, int qscale);
+
+    /**
+     * 归还一个编码器。缓存中的保留供下次使用，不缓存的（码率控制）直接释放
+     * @param codecCtx 由 acquire() 返回的编码器上下文
+     */
+    void release(AVCodecContext *codecCtx);
+
+    /**
+     * 丢弃一个编码器。编码出错后其内部状态不可信，不能再复用
+     * @param codecCtx 由 acquire() 返回的编码器上下文
+     */
+    void discard(AVCodecContext *codecCtx);
+
+    /**
+     * 借出一个空的数据包，池中没有时新建一个
+     * @return 失败返回 nullptr
+     */
+    AVPacket *acquirePacket();
+
+    /**
+     * 归还数据包。先释放其引用的缓冲，池满时直接释放
+     * @param packet 由 acquirePacket() 返回的数据包
+     */
+    void releasePacket(AVPacket *packet);
+
+private:
+
+    EncoderCache() = default;
+
+    /**
+     * 创建并打开一个 Jpeg 编码器
+     * @return
+     */
+    static AVCodecContext *open(int width, int height, AVPixelFormat pixFmt, int qscale);
+
+    /**
+     * 缓存的键
+     */
+    struct Key {
+        int width;
+        int height;
+        AVPixelFormat pixFmt;
+        int qscale;
+
+        bool operator<(const Key &other) const {
+            if (width != other.width) {
+                return width < other.width;
+            }
+            if (height != other.height) {
+                return height < other.height;
+            }
+            if (pixFmt != other.pixFmt) {
+                return pixFmt < other.pixFmt;
+            }
+            return qscale < other.qscale;
+        }
+    };
+
+    /**
+     * 缓存的编码器
+     */
+    struct Entry {
+        AVCodecContext *codecCtx;
+        unsigned long long lastUsed;    /* 最近一次取出时的 useTick */
+    };
+
+    /**
+     * 淘汰最久没有使用的编码器
+     */
+    void evictLeastRecentlyUsed();
+
+    std::map<Key, Entry> contexts;       /* 已打开的编码器 */
+    unsigned long long useTick = 0;      /* 每次取出编码器时递增，用于找出最久没有使用的 */
+    std::vector<AVPacket *> packets;     /* 空闲的数据包 */
+
+    static std::atomic<unsigned long long> encodeCount;
+    static std::atomic<unsigned long long> allocationCount;
+    static std::atomic<unsigned long long> allocationBytes;
+    static std::atomic<unsigned long long> openCount;
+};
+
+#endif //H265TOJPEG_ENCODERCACHE_H
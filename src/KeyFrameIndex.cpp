@@ -0,0 +1,210 @@
+#include "KeyFrameIndex.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Common.h"
+
+/* 索引文件的后缀 */
+#define INDEX_SUFFIX ".kfi"
+
+/* 索引文件的标识和版本，格式变化时递增版本 */
+#define INDEX_MAGIC "KFI1"
+#define INDEX_VERSION 1
+
+/**
+ * 索引文件头，之后紧跟 count 个 Entry 。按本机字节序保存，只作为本机的缓存
+ */
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t fileSize;   /* 输入文件的长度 */
+    int64_t mtimeSec;    /* 输入文件的修改时间 */
+    int64_t mtimeNsec;
+    int32_t codecId;     /* 编码格式 */
+    uint32_t reserved;
+    uint64_t headerSize; /* 码流开头的参数集等数据的长度 */
+    int64_t frameCount;  /* 码流的总帧数 */
+    uint64_t count;      /* 索引项的个数 */
+};
+
+/**
+ * 文件修改时间的纳秒部分
+ */
+static int64_t mtimeNsec(const struct stat &fileStat) {
+#ifdef __APPLE__
+    return fileStat.st_mtimespec.tv_nsec;
+#else
+    return fileStat.st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * 检查索引项是否可信。索引文件可能损坏或被篡改，定位时会直接使用其中的位置
+ * @param entries    索引项
+ * @param count      索引项的个数
+ * @param fileSize   输入文件的长度
+ * @param frameCount 码流的总帧数
+ * @return 第一项是第 0 帧，位置都在文件之内，且位置和帧序号都严格递增时返回 true
+ */
+static bool validEntries(const KeyFrameIndex::Entry *const entries, const size_t count, const uint64_t fileSize,
+                         const int64_t frameCount) {
+    if (count == 0 || entries[0].frameIndex != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (entries[i].offset >= fileSize || entries[i].frameIndex < 0 || entries[i].frameIndex >= frameCount) {
+            return false;
+        }
+        if (i > 0 && (entries[i].offset <= entries[i - 1].offset ||
+                      entries[i].frameIndex <= entries[i - 1].frameIndex)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+KeyFrameIndex::KeyFrameIndex() {
+    entries = nullptr;
+    count = 0;
+    totalFrames = 0;
+    streamHeaderSize = 0;
+    mappedIndex = nullptr;
+    mappedSize = 0;
+}
+
+KeyFrameIndex::~KeyFrameIndex() {
+    reset();
+}
+
+void KeyFrameIndex::reset() {
+    if (mappedIndex) {
+        munmap(mappedIndex, mappedSize);
+        mappedIndex = nullptr;
+        mappedSize = 0;
+    }
+    builtEntries.clear();
+    entries = nullptr;
+    count = 0;
+    totalFrames = 0;
+    streamHeaderSize = 0;
+}
+
+void KeyFrameIndex::open(const char *const inputPath, const uint8_t *const data, const size_t size,
+                         const AVCodecID codecId) {
+    reset();
+
+    // 数据与文件的长度不一致时（文件正在写入等），不使用索引文件
+    struct stat inputStat;
+    bool cacheable = inputPath && stat(inputPath, &inputStat) == 0 && (size_t) inputStat.st_size == size;
+    std::string indexPath = cacheable ? std::string(inputPath) + INDEX_SUFFIX : std::string();
+    if (cacheable && load(indexPath, inputStat, codecId)) {
+        if (DEBUG) {
+            LOG("%s | 使用索引文件 %s ，%zu 个关键帧", __PRETTY_FUNCTION__, indexPath.c_str(), count);
+        }
+        return;
+    }
+
+    build(data, size, codecId);
+
+    // 保存失败（目录不可写等）不影响本次使用
+    if (cacheable && !save(indexPath, inputStat, codecId) && DEBUG) {
+        LOG("%s | 无法保存索引文件 %s", __PRETTY_FUNCTION__, indexPath.c_str());
+    }
+}
+
+size_t KeyFrameIndex::find(const long long targetFrame) const {
+    const Entry *entry = std::upper_bound(entries, entries + count, targetFrame,
+                                          [](long long frameIndex, const Entry &e) {
+                                              return frameIndex < e.frameIndex;
+                                          });
+    return entry == entries ? 0 : (size_t) (entry - entries - 1);
+}
+
+bool KeyFrameIndex::load(const std::string &indexPath, const struct stat &inputStat, const AVCodecID codecId) {
+    int fd = ::open(indexPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat indexStat;
+    if (fstat(fd, &indexStat) != 0 || (size_t) indexStat.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, (size_t) indexStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    // 输入文件被修改过，或索引文件不完整、损坏时，重新建立索引。
+    // 索引项的个数来自文件内容，先用除法与文件长度比较，避免乘法溢出后恰好通过长度校验
+    const IndexHeader *header = (const IndexHeader *) addr;
+    const size_t entriesSize = (size_t) indexStat.st_size - sizeof(IndexHeader);
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != INDEX_VERSION ||
+        header->fileSize != (uint64_t) inputStat.st_size || header->mtimeSec != (int64_t) inputStat.st_mtime ||
+        header->mtimeNsec != mtimeNsec(inputStat) || header->codecId != (int32_t) codecId || header->count == 0 ||
+        header->count > entriesSize / sizeof(Entry) || entriesSize != header->count * sizeof(Entry) ||
+        header->headerSize > header->fileSize ||
+        !validEntries((const Entry *) (header + 1), (size_t) header->count, header->fileSize, header->frameCount)) {
+        munmap(addr, (size_t) indexStat.st_size);
+        return false;
+    }
+
+    mappedIndex = addr;
+    mappedSize = (size_t) indexStat.st_size;
+    entries = (const Entry *) (header + 1);
+    count = (size_t) header->count;
+    totalFrames = header->frameCount;
+    streamHeaderSize = (size_t) header->headerSize;
+    return true;
+}
+
+void KeyFrameIndex::build(const uint8_t *const data, const size_t size, const AVCodecID codecId) {
+    // 只检查 NAL 头，找出所有的 IDR 帧。码流开头总可以作为解码的起点
+    std::vector<AnnexB::KeyFrame> keyFrames;
+    totalFrames = AnnexB::findKeyFrames(data, size, codecId, keyFrames, streamHeaderSize);
+    if (keyFrames.empty() || keyFrames.front().frameIndex != 0) {
+        keyFrames.insert(keyFrames.begin(), AnnexB::KeyFrame{0, 0});
+    }
+
+    builtEntries.reserve(keyFrames.size());
+    for (const auto &keyFrame : keyFrames) {
+        builtEntries.push_back(Entry{keyFrame.offset, AV_NOPTS_VALUE, keyFrame.frameIndex});
+    }
+    entries = builtEntries.data();
+    count = builtEntries.size();
+}
+
+bool KeyFrameIndex::save(const std::string &indexPath, const struct stat &inputStat, const AVCodecID codecId) const {
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.fileSize = (uint64_t) inputStat.st_size;
+    header.mtimeSec = (int64_t) inputStat.st_mtime;
+    header.mtimeNsec = mtimeNsec(inputStat);
+    header.codecId = (int32_t) codecId;
+    header.headerSize = streamHeaderSize;
+    header.frameCount = totalFrames;
+    header.count = count;
+
+    std::string tempPath = indexPath + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);
+    size_t entriesSize = count * sizeof(Entry);
+    bool ok = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+              write(fd, entries, entriesSize) == (ssize_t) entriesSize;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+#ifndef H265TOJPEG_KEYFRAMEINDEX_H
+#define H265TOJPEG_KEYFRAMEINDEX_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavcodec/avcodec.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "AnnexB.h"
+
+
+/**
+ * 裸流的关键帧索引。
+ * 输入是文件时，索引保存在同目录下的 <文件名>.kfi 中，以文件的长度和修改时间校验是否过期。
+ * 之后的随机访问直接 mmap 索引文件，不再扫描整个码流
+ */
+class KeyFrameIndex {
+
+public:
+
+    /**
+     * 索引文件中的一项
+     */
+    struct Entry {
+        uint64_t offset;    /* IDR 帧所在访问单元的起始位置 */
+        int64_t pts;        /* 显示时间戳。裸流没有时间戳，为 AV_NOPTS_VALUE */
+        int64_t frameIndex; /* 帧序号，按解码顺序从 0 开始 */
+    };
+
+    KeyFrameIndex();
+
+    ~KeyFrameIndex();
+
+    KeyFrameIndex(const KeyFrameIndex &) = delete;
+
+    KeyFrameIndex &operator=(const KeyFrameIndex &) = delete;
+
+    /**
+     * 加载索引。索引文件有效时直接映射，否则扫描码流建立索引，并保存到索引文件
+     * @param inputPath 输入文件路径，为空时只在内存中建立索引
+     * @param data      裸流数据
+     * @param size      数据长度
+     * @param codecId   编码格式（AV_CODEC_ID_HEVC 或 AV_CODEC_ID_H264）
+     */
+    void open(const char *inputPath, const uint8_t *data, size_t size, AVCodecID codecId);
+
+    /**
+     * 释放索引
+     */
+    void reset();
+
+    /**
+     * @return 是否已加载
+     */
+    bool isOpen() const {
+        return count > 0;
+    }
+
+    /**
+     * @return 关键帧的个数。第一项总是码流的开头（第 0 帧）
+     */
+    size_t size() const {
+        return count;
+    }
+
+    /**
+     * @return 码流的总帧数
+     */
+    long long frameCount() const {
+        return totalFrames;
+    }
+
+    /**
+     * @return 码流开头的参数集等数据的长度（第一个图像 NAL 之前的部分）
+     */
+    size_t headerSize() const {
+        return streamHeaderSize;
+    }
+
+    /**
+     * 第 i 个关键帧
+     */
+    AnnexB::KeyFrame at(size_t i) const {
+        return AnnexB::KeyFrame{(size_t) entries[i].offset, entries[i].frameIndex};
+    }
+
+    /**
+     * 查找目标帧之前（含）最近的关键帧
+     * @param targetFrame 目标帧序号
+     * @return 关键帧的下标
+     */
+    size_t find(long long targetFrame) const;
+
+private:
+
+    /**
+     * 映射并校验索引文件
+     * @return 索引文件存在且与输入文件匹配时返回 true
+     */
+    bool load(const std::string &indexPath, const struct stat &inputStat, AVCodecID codecId);
+
+    /**
+     * 扫描码流建立索引
+     */
+    void build(const uint8_t *data, size_t size, AVCodecID codecId);
+
+    /**
+     * 先写入临时文件再重命名，避免其他进程读到写了一半的索引
+     * @return
+     */
+    bool save(const std::string &indexPath, const struct stat &inputStat, AVCodecID codecId) const;
+
+    const Entry *entries;     /* 索引项，指向 mmap 的索引文件或 builtEntries */
+    size_t count;             /* 索引项的个数 */
+    long long totalFrames;    /* 码流的总帧数 */
+    size_t streamHeaderSize;  /* 码流开头的参数集等数据的长度 */
+    std::vector<Entry> builtEntries; /* 扫描码流建立的索引 */
+    void *mappedIndex;        /* mmap 的索引文件 */
+    size_t mappedSize;        /* mmap 的长度 */
+};
+
+#endif //H265TOJPEG_KEYFRAMEINDEX_H
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Common.h"
+#include "OutputSink.h"
+
+
+/*============================== MemorySink ==============================*/
+
+MemorySink::~MemorySink() {
+    free(buf);
+    buf = nullptr;
+    len = 0;
+    cap = 0;
+}
+
+bool MemorySink::begin(const size_t totalSize) {
+    shared.reset();
+    len = 0;
+    return reserve(totalSize);
+}
+
+bool MemorySink::write(const unsigned char *const data, const size_t size) {
+    // 没有调用 begin() 就接着写时，先把 writeJpeg() 持有的数据拷贝到自己的缓冲中，追加在其后
+    if (shared) {
+        if (!reserve(len)) {
+            return false;
+        }
+        if (len > 0) {
+            memcpy(buf, shared.get(), len);
+        }
+        shared.reset();
+    }
+    if (size > SIZE_MAX - len) {
+        LOG("%s line=%d | 数据过长，len=%zu, size=%zu", __PRETTY_FUNCTION__, __LINE__, len, size);
+        return false;
+    }
+    if (len + size > cap && !reserve(len + size)) {
+        return false;
+    }
+    memcpy(buf + len, data, size);
+    len += size;
+    return true;
+}
+
+bool MemorySink::end() {
+    return true;
+}
+
+bool MemorySink::writeJpeg(const std::shared_ptr<const unsigned char> &data, const size_t size) {
+    // 持有编码器的缓冲，不拷贝；自己的缓冲保留容量，供之后分块写入时使用
+    shared = data;
+    len = size;
+    return true;
+}
+
+bool MemorySink::reserve(const size_t required) {
+    if (required <= cap) {
+        return true;
+    }
+    // 按倍数扩容，避免分块写入时反复 realloc
+    size_t newCap = cap > 0 ? cap : STACK_SIZE;
+    while (newCap < required) {
+        newCap = newCap > SIZE_MAX / 2 ? required : newCap * 2;
+    }
+    auto newBuf = (unsigned char *) realloc(buf, newCap);
+    if (!newBuf) {
+        LOG("%s line=%d | realloc failed, cap=%zu", __PRETTY_FUNCTION__, __LINE__, newCap);
+        return false;
+    }
+    buf = newBuf;
+    cap = newCap;
+    return true;
+}
+
+
+/*============================== FdSink ==============================*/
+
+FdSink::FdSink(const int fd) : fd(fd) {
+}
+
+FdSink::FdSink(const char *const filePath) : fd(-1), filePath(filePath ? filePath : "") {
+}
+
+FdSink::~FdSink() {
+    closeOwnedFd();
+}
+
+bool FdSink::begin(size_t) {
+    if (filePath.empty()) {
+        return fd >= 0;
+    }
+    closeOwnedFd();
+    fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG("%s line=%d | Open file error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(),
+            errno);
+        return false;
+    }
+    return true;
+}
+
+bool FdSink::write(const unsigned char *const data, const size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = ::write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG("%s line=%d | write error! fd=%d, errno=%d", __PRETTY_FUNCTION__, __LINE__, fd, errno);
+            return false;
+        }
+        written += (size_t) ret;
+    }
+    return true;
+}
+
+bool FdSink::end() {
+    if (filePath.empty()) {
+        return true;
+    }
+    if (close(fd) != 0) {
+        LOG("%s line=%d | close error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(), errno);
+        fd = -1;
+        return false;
+    }
+    fd = -1;
+    LOG("保存 Jpeg 数据到文件: %s", filePath.c_str());
+    return true;
+}
+
+void FdSink::closeOwnedFd() {
+    if (!filePath.empty() && fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+
+/*============================== MmapFileSink ==============================*/
+
+MmapFileSink::MmapFileSink(const char *const filePath) : filePath(filePath ? filePath : "") {
+}
+
+MmapFileSink::~MmapFileSink() {
+    release();
+}
+
+bool MmapFileSink::begin(const size_t totalSize) {
+    release();
+    fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG("%s line=%d | Open file error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(),
+            errno);
+        return false;
+    }
+    offset = 0;
+    return totalSize == 0 || remap(totalSize);
+}
+
+bool MmapFileSink::write(const unsigned char *const data, const size_t size) {
+    if (size > mapSize - offset && !remap(std::max(offset + size, mapSize * 2))) {
+        return false;
+    }
+    memcpy(map + offset, data, size);
+    offset += size;
+    return true;
+}
+
+bool MmapFileSink::end() {
+    bool isOk = true;
+    if (map) {
+        munmap(map, mapSize);
+        map = nullptr;
+    }
+    // 去掉预分配多出的部分
+    if (fd >= 0 && offset != mapSize && ftruncate(fd, (off_t) offset) != 0) {
+        LOG("%s line=%d | ftruncate error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(),
+            errno);
+        isOk = false;
+    }
+    mapSize = 0;
+    release();
+    return isOk;
+}
+
+bool MmapFileSink::writeJpeg(const std::shared_ptr<const unsigned char> &data, const size_t size) {
+    // 总长度已知，映射区正好是 Jpeg 的大小，一次拷贝完成，end() 时无需再截断
+    if (!begin(size)) {
+        release();
+        return false;
+    }
+    if (size > 0) {
+        memcpy(map, data.get(), size);
+    }
+    offset = size;
+    return end();
+}
+
+bool MmapFileSink::remap(const size_t newSize) {
+    if (map) {
+        munmap(map, mapSize);
+        map = nullptr;
+        mapSize = 0;
+    }
+    if (ftruncate(fd, (off_t) newSize) != 0) {
+        LOG("%s line=%d | ftruncate error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(),
+            errno);
+        return false;
+    }
+    void *addr = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        LOG("%s line=%d | mmap error! filePath=%s, errno=%d", __PRETTY_FUNCTION__, __LINE__, filePath.c_str(), errno);
+        return false;
+    }
+    map = (unsigned char *) addr;
+    mapSize = newSize;
+    return true;
+}
+
+void MmapFileSink::release() {
+    if (map) {
+        munmap(map, mapSize);
+        map = nullptr;
+    }
+    mapSize = 0;
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+
+/*============================== CallbackSink ==============================*/
+
+CallbackSink::CallbackSink(ChunkCallback callback) : callback(std::move(callback)) {
+}
+
+bool CallbackSink::begin(size_t) {
+    return static_cast<bool>(callback);
+}
+
+bool CallbackSink::write(const unsigned char *const data, const size_t size) {
+    return callback(data, size);
+}
+
+bool CallbackSink::end() {
+    return true;
+}
@@ -0,0 +1,314 @@
+#include "PixelConvert.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/common.h"
+#include "libavutil/pixdesc.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#else
+#define PIXEL_CONVERT_X86 0
+#endif
+
+
+void PixelConvert::downshiftScalar(const uint16_t *const src, uint8_t *const dst, const size_t count,
+                                   const int shift) {
+    const uint32_t round = 1u << (shift - 1);
+    for (size_t i = 0; i < count; ++i) {
+        // 最大值四舍五入后会进位到 256 ，损坏的码流还可能超出位深，都截断到 255
+        uint32_t value = (src[i] + round) >> shift;
+        dst[i] = (uint8_t) (value > 255 ? 255 : value);
+    }
+}
+
+/**
+ * 2 倍缩小一行的标量实现：每个输出像素为上下两行中相邻两个像素的四舍五入平均值
+ * @param row0  上一行
+ * @param row1  下一行
+ * @param dst   输出
+ * @param count 输出的像素个数
+ */
+static void boxDown2Scalar(const uint8_t *const row0, const uint8_t *const row1, uint8_t *const dst,
+                           const size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = (uint8_t) ((row0[2 * i] + row0[2 * i + 1] + row1[2 * i] + row1[2 * i + 1] + 2) >> 2);
+    }
+}
+
+/**
+ * 把一行像素累加到 16 位的累加行上的标量实现
+ * @param src   输入
+ * @param acc   累加行
+ * @param count 像素个数
+ */
+static void accumulateScalar(const uint8_t *const src, uint16_t *const acc, const size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        acc[i] = (uint16_t) (acc[i] + src[i]);
+    }
+}
+
+#if PIXEL_CONVERT_X86
+
+/**
+ * 降低位深的 SSE2 实现，每次处理 16 个像素。x86-64 的 CPU 都支持 SSE2
+ */
+__attribute__((target("sse2")))
+static void downshiftSse2(const uint16_t *const src, uint8_t *const dst, const size_t count, const int shift) {
+    const __m128i round = _mm_set1_epi16((short) (1 << (shift - 1)));
+    const __m128i bits = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        // 饱和加法，超出位深的值不会回绕；打包时按有符号 16 位饱和到 0~255
+        a = _mm_srl_epi16(_mm_adds_epu16(a, round), bits);
+        b = _mm_srl_epi16(_mm_adds_epu16(b, round), bits);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(a, b));
+    }
+    PixelConvert::downshiftScalar(src + i, dst + i, count - i, shift);
+}
+
+/**
+ * 降低位深的 AVX2 实现，每次处理 32 个像素
+ */
+__attribute__((target("avx2")))
+static void downshiftAvx2(const uint16_t *const src, uint8_t *const dst, const size_t count, const int shift) {
+    const __m256i round = _mm256_set1_epi16((short) (1 << (shift - 1)));
+    const __m128i bits = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 16));
+        a = _mm256_srl_epi16(_mm256_adds_epu16(a, round), bits);
+        b = _mm256_srl_epi16(_mm256_adds_epu16(b, round), bits);
+        // 打包按 128 位的两半分别进行，结果的 64 位块顺序为 a0 b0 a1 b1 ，重排为 a0 a1 b0 b1
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *) (dst + i), packed);
+    }
+    PixelConvert::downshiftScalar(src + i, dst + i, count - i, shift);
+}
+
+/**
+ * 2 倍缩小一行的 SSE2 实现，每次输出 16 个像素
+ */
+__attribute__((target("sse2")))
+static void boxDown2Sse2(const uint8_t *const row0, const uint8_t *const row1, uint8_t *const dst,
+                         const size_t count) {
+    const __m128i low = _mm_set1_epi16(0x00ff);
+    const __m128i two = _mm_set1_epi16(2);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i sums[2];
+        for (int half = 0; half < 2; ++half) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (row0 + 2 * i + 16 * half));
+            __m128i b = _mm_loadu_si128((const __m128i *) (row1 + 2 * i + 16 * half));
+            // 偶数位置的字节取低 8 位，奇数位置的右移 8 位，相加即得相邻两个像素之和
+            __m128i pairA = _mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8));
+            __m128i pairB = _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8));
+            sums[half] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(pairA, pairB), two), 2);
+        }
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(sums[0], sums[1]));
+    }
+    boxDown2Scalar(row0 + 2 * i, row1 + 2 * i, dst + i, count - i);
+}
+
+/**
+ * 2 倍缩小一行的 AVX2 实现，每次输出 32 个像素
+ */
+__attribute__((target("avx2")))
+static void boxDown2Avx2(const uint8_t *const row0, const uint8_t *const row1, uint8_t *const dst,
+                         const size_t count) {
+    const __m256i low = _mm256_set1_epi16(0x00ff);
+    const __m256i two = _mm256_set1_epi16(2);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i sums[2];
+        for (int half = 0; half < 2; ++half) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (row0 + 2 * i + 32 * half));
+            __m256i b = _mm256_loadu_si256((const __m256i *) (row1 + 2 * i + 32 * half));
+            __m256i pairA = _mm256_add_epi16(_mm256_and_si256(a, low), _mm256_srli_epi16(a, 8));
+            __m256i pairB = _mm256_add_epi16(_mm256_and_si256(b, low), _mm256_srli_epi16(b, 8));
+            sums[half] = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(pairA, pairB), two), 2);
+        }
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sums[0], sums[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *) (dst + i), packed);
+    }
+    boxDown2Scalar(row0 + 2 * i, row1 + 2 * i, dst + i, count - i);
+}
+
+/**
+ * 累加一行的 SSE2 实现，每次处理 16 个像素
+ */
+__attribute__((target("sse2")))
+static void accumulateSse2(const uint8_t *const src, uint16_t *const acc, const size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i *sum = (__m128i *) (acc + i);
+        _mm_storeu_si128(sum, _mm_add_epi16(_mm_loadu_si128(sum), _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(sum + 1, _mm_add_epi16(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi8(pixels, zero)));
+    }
+    accumulateScalar(src + i, acc + i, count - i);
+}
+
+/**
+ * 累加一行的 AVX2 实现，每次处理 16 个像素
+ */
+__attribute__((target("avx2")))
+static void accumulateAvx2(const uint8_t *const src, uint16_t *const acc, const size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+        __m256i *sum = (__m256i *) (acc + i);
+        _mm256_storeu_si256(sum, _mm256_add_epi16(_mm256_loadu_si256(sum), pixels));
+    }
+    accumulateScalar(src + i, acc + i, count - i);
+}
+
+#endif
+
+/**
+ * 运行时选择的一组实现
+ */
+struct KernelSet {
+    const char *name;
+    PixelConvert::DownshiftKernel downshift;
+    void (*boxDown2)(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, size_t count);
+    void (*accumulate)(const uint8_t *src, uint16_t *acc, size_t count);
+};
+
+/**
+ * 按 CPU 支持的指令集选择实现
+ * @return
+ */
+static KernelSet selectKernels() {
+#if PIXEL_CONVERT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelSet{"avx2", downshiftAvx2, boxDown2Avx2, accumulateAvx2};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KernelSet{"sse2", downshiftSse2, boxDown2Sse2, accumulateSse2};
+    }
+#endif
+    return KernelSet{"scalar", PixelConvert::downshiftScalar, boxDown2Scalar, accumulateScalar};
+}
+
+/**
+ * @return 运行时选择的实现。只在第一次调用时检测 CPU ，局部静态变量的初始化是线程安全的
+ */
+static const KernelSet &kernels() {
+    static const KernelSet selected = selectKernels();
+    return selected;
+}
+
+PixelConvert::DownshiftKernel PixelConvert::kernel() {
+    return kernels().downshift;
+}
+
+const char *PixelConvert::kernelName() {
+    return kernels().name;
+}
+
+bool PixelConvert::canDownshift(const AVPixelFormat srcFormat, const AVPixelFormat dstFormat) {
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(srcFormat);
+    const AVPixFmtDescriptor *dst = av_pix_fmt_desc_get(dstFormat);
+    if (!src || !dst) {
+        return false;
+    }
+
+    // 只处理不带 alpha 的小端 YUV 平面格式，每个像素 2 字节
+    if (src->flags != AV_PIX_FMT_FLAG_PLANAR || src->nb_components != 3 || src->comp[0].depth <= 8 ||
+        src->comp[0].step != 2) {
+        return false;
+    }
+    return dst->flags == AV_PIX_FMT_FLAG_PLANAR && dst->nb_components == 3 && dst->comp[0].depth == 8 &&
+           dst->log2_chroma_w == src->log2_chroma_w && dst->log2_chroma_h == src->log2_chroma_h;
+}
+
+bool PixelConvert::canBoxDownscale(const int srcWidth, const int srcHeight, const AVPixelFormat srcFormat,
+                                   const int dstWidth, const int dstHeight, const AVPixelFormat dstFormat) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(srcFormat);
+    if (!desc || dstFormat != srcFormat || desc->flags != AV_PIX_FMT_FLAG_PLANAR || desc->nb_components != 3 ||
+        desc->comp[0].depth != 8 || dstWidth <= 0 || dstHeight <= 0) {
+        return false;
+    }
+
+    // 16 位的累加行最多容纳 256 行的和
+    int factor = srcWidth / dstWidth;
+    if (factor < 2 || factor > 256 || srcWidth != dstWidth * factor || srcHeight != dstHeight * factor) {
+        return false;
+    }
+
+    // 色度平面也要整除，否则块的边界与亮度对不齐
+    int chromaW = desc->log2_chroma_w, chromaH = desc->log2_chroma_h;
+    return AV_CEIL_RSHIFT(srcWidth, chromaW) == AV_CEIL_RSHIFT(dstWidth, chromaW) * factor &&
+           AV_CEIL_RSHIFT(srcHeight, chromaH) == AV_CEIL_RSHIFT(dstHeight, chromaH) * factor;
+}
+
+void PixelConvert::boxDownscale(const AVFrame *const src, AVFrame *const dst) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) src->format);
+    const int factor = src->width / dst->width;
+    const unsigned area = (unsigned) (factor * factor);
+    const KernelSet &set = kernels();
+
+    // 累加行按线程复用，稳定运行后不再申请内存
+    static thread_local std::vector<uint16_t> acc;
+
+    for (int plane = 0; plane < 3; ++plane) {
+        int srcWidth = plane == 0 ? src->width : AV_CEIL_RSHIFT(src->width, desc->log2_chroma_w);
+        int dstWidth = plane == 0 ? dst->width : AV_CEIL_RSHIFT(dst->width, desc->log2_chroma_w);
+        int dstHeight = plane == 0 ? dst->height : AV_CEIL_RSHIFT(dst->height, desc->log2_chroma_h);
+        for (int y = 0; y < dstHeight; ++y) {
+            const uint8_t *srcRow = src->data[plane] + (size_t) y * factor * src->linesize[plane];
+            uint8_t *dstRow = dst->data[plane] + (size_t) y * dst->linesize[plane];
+
+            // 最常见的 2 倍直接按 2×2 块求平均
+            if (factor == 2) {
+                set.boxDown2(srcRow, srcRow + src->linesize[plane], dstRow, (size_t) dstWidth);
+                continue;
+            }
+
+            // 其他倍数先把 N 行纵向累加，再横向每 N 个求和、四舍五入取平均
+            acc.assign((size_t) srcWidth, 0);
+            for (int k = 0; k < factor; ++k) {
+                set.accumulate(srcRow + (size_t) k * src->linesize[plane], acc.data(), (size_t) srcWidth);
+            }
+            const uint16_t *sum = acc.data();
+            for (int x = 0; x < dstWidth; ++x, sum += factor) {
+                unsigned total = 0;
+                for (int k = 0; k < factor; ++k) {
+                    total += sum[k];
+                }
+                dstRow[x] = (uint8_t) ((total + area / 2) / area);
+            }
+        }
+    }
+}
+
+void PixelConvert::downshift(const AVFrame *const src, AVFrame *const dst) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) src->format);
+    const int shift = desc->comp[0].depth - 8;
+    const DownshiftKernel convert = kernel();
+
+    for (int plane = 0; plane < 3; ++plane) {
+        int width = plane == 0 ? src->width : AV_CEIL_RSHIFT(src->width, desc->log2_chroma_w);
+        int height = plane == 0 ? src->height : AV_CEIL_RSHIFT(src->height, desc->log2_chroma_h);
+        const uint8_t *srcRow = src->data[plane];
+        uint8_t *dstRow = dst->data[plane];
+        for (int y = 0; y < height; ++y) {
+            convert((const uint16_t *) srcRow, dstRow, (size_t) width, shift);
+            srcRow += src->linesize[plane];
+            dstRow += dst->linesize[plane];
+        }
+    }
+}
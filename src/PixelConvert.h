@@ -0,0 +1,88 @@
+#ifndef H265TOJPEG_PIXELCONVERT_H
+#define H265TOJPEG_PIXELCONVERT_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * 平面 YUV 的 SIMD 像素处理，按 CPU 在运行时选择 AVX2 、SSE2 或标量实现：
+ * 1. 高位深（如 HEVC Main10 解码出的 yuv420p10le）到 8 位的转换。每个像素四舍五入右移 (位深 - 8) 位，保持取值范围不变，
+ *    比 swscale 的通用路径少一次中间格式的转换；
+ * 2. 8 位平面按整数倍缩小（盒式滤波，取 N×N 块的平均值），用于生成缩略图
+ */
+class PixelConvert {
+
+public:
+
+    /**
+     * 一行像素的转换函数
+     * @param src   输入，每个像素 16 位
+     * @param dst   输出，每个像素 8 位
+     * @param count 像素个数
+     * @param shift 右移的位数（位深 - 8）
+     */
+    typedef void (*DownshiftKernel)(const uint16_t *src, uint8_t *dst, size_t count, int shift);
+
+    /**
+     * 判断能否用本类直接转换
+     * @param srcFormat 输入的像素格式
+     * @param dstFormat 输出的像素格式
+     * @return 输入为 9~16 位小端的 YUV 平面格式、输出为色度采样方式相同的 8 位 YUV 平面格式时返回 true
+     */
+    static bool canDownshift(AVPixelFormat srcFormat, AVPixelFormat dstFormat);
+
+    /**
+     * 逐行遍历各平面，一遍完成转换。输入、输出的宽高必须相同，且 canDownshift() 为 true
+     * @param src 输入帧
+     * @param dst 输出帧，缓冲由调用方申请
+     */
+    static void downshift(const AVFrame *src, AVFrame *dst);
+
+    /**
+     * @return 运行时选择的转换函数
+     */
+    static DownshiftKernel kernel();
+
+    /**
+     * @return 运行时选择的转换函数的名称（avx2 、sse2 或 scalar）
+     */
+    static const char *kernelName();
+
+    /**
+     * 标量实现，用于不支持 SIMD 的 CPU 以及各 SIMD 实现处理行尾剩余的像素
+     */
+    static void downshiftScalar(const uint16_t *src, uint8_t *dst, size_t count, int shift);
+
+    /**
+     * 判断能否用盒式滤波按整数倍缩小
+     * @param srcWidth  输入宽度
+     * @param srcHeight 输入高度
+     * @param srcFormat 输入的像素格式
+     * @param dstWidth  输出宽度
+     * @param dstHeight 输出高度
+     * @param dstFormat 输出的像素格式
+     * @return 输入为 8 位 YUV 平面格式、输出格式相同，且每个平面的宽高都是输出的同一整数倍（2~256）时返回 true
+     */
+    static bool canBoxDownscale(int srcWidth, int srcHeight, AVPixelFormat srcFormat, int dstWidth, int dstHeight,
+                                AVPixelFormat dstFormat);
+
+    /**
+     * 盒式滤波缩小，每个输出像素为对应 N×N 块的四舍五入平均值。canBoxDownscale() 必须为 true
+     * @param src 输入帧
+     * @param dst 输出帧，宽高和缓冲由调用方设置
+     */
+    static void boxDownscale(const AVFrame *src, AVFrame *dst);
+};
+
+#endif //H265TOJPEG_PIXELCONVERT_H
@@ -0,0 +1,193 @@
+#include "PixelConvert.h"
+#include "ScaleCache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/pixdesc.h"
+#ifdef __cplusplus
+}
+#endif
+
+/* 输出帧缓冲的对齐字节数 */
+#define SCALE_FRAME_ALIGN 32
+
+
+ScaleCache &ScaleCache::current() {
+    // 线程退出时自动析构，释放该线程缓存的所有转换上下文
+    static thread_local ScaleCache cache;
+    return cache;
+}
+
+ScaleCache::~ScaleCache() {
+    for (auto &item : entries) {
+        close(item.second);
+    }
+    entries.clear();
+}
+
+AVFrame *ScaleCache::convert(const AVFrame *const src, const int dstWidth, const int dstHeight,
+                             const AVPixelFormat dstFormat) {
+    Key key = {src->width, src->height, (AVPixelFormat) src->format, dstWidth, dstHeight, dstFormat};
+    Entry *entry = acquire(key);
+    if (!entry) {
+        return nullptr;
+    }
+
+    if (!entry->frame) {
+        entry->frame = av_frame_alloc();
+        if (!entry->frame) {
+            LOG("%s line=%d | av_frame_alloc failed", __PRETTY_FUNCTION__, __LINE__);
+            return nullptr;
+        }
+        entry->frame->width = dstWidth;
+        entry->frame->height = dstHeight;
+        entry->frame->format = dstFormat;
+        int ret = av_frame_get_buffer(entry->frame, SCALE_FRAME_ALIGN);
+        if (ret < 0) {
+            LOG("%s line=%d | av_frame_get_buffer failed, ret=%d", __PRETTY_FUNCTION__, __LINE__, ret);
+            av_frame_free(&entry->frame);
+            return nullptr;
+        }
+    }
+
+    AVFrame *frame = entry->frame;
+    if (!scale(*entry, src, frame)) {
+        return nullptr;
+    }
+    frame->pts = src->pts;
+    frame->key_frame = src->key_frame;
+    frame->pict_type = src->pict_type;
+    return frame;
+}
+
+bool ScaleCache::convert(const AVFrame *const src, AVFrame *const dst) {
+    Key key = {src->width, src->height, (AVPixelFormat) src->format, dst->width, dst->height,
+               (AVPixelFormat) dst->format};
+    Entry *entry = acquire(key);
+    if (!entry) {
+        return false;
+    }
+
+    // YUV 转 RGB 时，swscale 默认按 BT.601 的有限范围计算。高清视频多为 BT.709 ，全范围的码流也需要告诉 swscale
+    const AVPixFmtDescriptor *srcDesc = av_pix_fmt_desc_get(key.srcFormat);
+    const AVPixFmtDescriptor *dstDesc = av_pix_fmt_desc_get(key.dstFormat);
+    if (entry->swsCtx && srcDesc && dstDesc && !(srcDesc->flags & AV_PIX_FMT_FLAG_RGB) &&
+        (dstDesc->flags & AV_PIX_FMT_FLAG_RGB)) {
+        int colorspace = src->colorspace == AVCOL_SPC_BT709 ? SWS_CS_ITU709 : SWS_CS_DEFAULT;
+        int srcRange = src->color_range == AVCOL_RANGE_JPEG ? 1 : 0;
+        if (colorspace != entry->colorspace || srcRange != entry->srcRange) {
+            sws_setColorspaceDetails(entry->swsCtx, sws_getCoefficients(colorspace), srcRange,
+                                     sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+            entry->colorspace = colorspace;
+            entry->srcRange = srcRange;
+        }
+    }
+
+    if (!scale(*entry, src, dst)) {
+        return false;
+    }
+    dst->pts = src->pts;
+    dst->key_frame = src->key_frame;
+    dst->pict_type = src->pict_type;
+    return true;
+}
+
+ScaleCache::Entry *ScaleCache::acquire(const Key &key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        Entry entry;
+        if (!open(key, entry)) {
+            return nullptr;
+        }
+
+        // 缓存已满时淘汰最久没有使用的一个，避免分辨率种类很多时无限增长，常用的规格一直保留
+        if (entries.size() >= SCALE_CACHE_CAPACITY) {
+            evictLeastRecentlyUsed();
+        }
+        it = entries.insert(std::make_pair(key, entry)).first;
+    }
+    it->second.lastUsed = ++useTick;
+    return &it->second;
+}
+
+void ScaleCache::evictLeastRecentlyUsed() {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->second.lastUsed < oldest->second.lastUsed) {
+            oldest = it;
+        }
+    }
+    if (oldest != entries.end()) {
+        close(oldest->second);
+        entries.erase(oldest);
+    }
+}
+
+bool ScaleCache::scale(Entry &entry, const AVFrame *const src, AVFrame *const dst) {
+    switch (entry.route) {
+        case Route::Downshift:
+            PixelConvert::downshift(src, dst);
+            break;
+        case Route::BoxDownscale:
+            PixelConvert::boxDownscale(src, dst);
+            break;
+        default: {
+            int ret = sws_scale(entry.swsCtx, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+            if (ret <= 0) {
+                LOG("%s line=%d | sws_scale failed, ret=%d", __PRETTY_FUNCTION__, __LINE__, ret);
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool ScaleCache::open(const Key &key, Entry &entry) {
+    // 只降低位深、不缩放时用 SIMD 直接转换；8 位平面按整数倍缩小时用 SIMD 盒式滤波。都不需要 swscale
+    bool sameSize = key.srcWidth == key.dstWidth && key.srcHeight == key.dstHeight;
+    entry.route = Route::Swscale;
+    if (sameSize && PixelConvert::canDownshift(key.srcFormat, key.dstFormat)) {
+        entry.route = Route::Downshift;
+    } else if (PixelConvert::canBoxDownscale(key.srcWidth, key.srcHeight, key.srcFormat, key.dstWidth, key.dstHeight,
+                                             key.dstFormat)) {
+        entry.route = Route::BoxDownscale;
+    }
+
+    /**
+     * struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW, int srcH, enum AVPixelFormat srcFormat,
+     *                                         int dstW, int dstH, enum AVPixelFormat dstFormat, int flags,
+     *                                         SwsFilter *srcFilter, SwsFilter *dstFilter, const double *param);
+     * 参数与 context 一致时直接返回 context ，否则新建一个。这里每种规格各有一个，context 传 nullptr
+     */
+    entry.swsCtx = nullptr;
+    if (entry.route == Route::Swscale) {
+        // 缩放时用画质较好的双三次插值，只转换格式时用双线性
+        int flags = sameSize ? SWS_BILINEAR : SWS_BICUBIC;
+        entry.swsCtx = sws_getCachedContext(nullptr, key.srcWidth, key.srcHeight, key.srcFormat, key.dstWidth,
+                                            key.dstHeight, key.dstFormat, flags, nullptr, nullptr, nullptr);
+        if (!entry.swsCtx) {
+            LOG("%s line=%d | sws_getCachedContext failed, %dx%d fmt=%d -> %dx%d fmt=%d", __PRETTY_FUNCTION__,
+                __LINE__, key.srcWidth, key.srcHeight, key.srcFormat, key.dstWidth, key.dstHeight, key.dstFormat);
+            return false;
+        }
+    }
+
+    entry.frame = nullptr;
+    entry.colorspace = -1;
+    entry.srcRange = -1;
+
+    if (DEBUG) {
+        LOG("%s | 新建转换上下文：%dx%d fmt=%d -> %dx%d fmt=%d, %s", __PRETTY_FUNCTION__, key.srcWidth,
+            key.srcHeight, key.srcFormat, key.dstWidth, key.dstHeight, key.dstFormat,
+            entry.route == Route::Swscale ? "swscale" : PixelConvert::kernelName());
+    }
+    return true;
+}
+
+void ScaleCache::close(Entry &entry) {
+    sws_freeContext(entry.swsCtx);
+    entry.swsCtx = nullptr;
+    av_frame_free(&entry.frame);
+}
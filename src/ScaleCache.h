@@ -0,0 +1,152 @@
+#ifndef H265TOJPEG_SCALECACHE_H
+#define H265TOJPEG_SCALECACHE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <map>
+#include "Common.h"
+
+/* 每个线程最多缓存的转换上下文个数 */
+#define SCALE_CACHE_CAPACITY 8
+
+
+/**
+ * 像素格式转换（及缩放）的缓存。
+ * 每个线程各自持有一份，按 (输入宽、高、格式, 输出宽、高、格式) 缓存 SwsContext 和输出帧，
+ * 同一线程后续相同规格的帧直接复用，省去创建转换上下文和申请输出缓冲的开销。
+ * 只降低位深（如 10 位转 8 位）、不缩放，或者 8 位平面按整数倍缩小时不经过 swscale ，由 PixelConvert 的 SIMD 实现完成；
+ * 其他缩放用 swscale 的双三次插值。
+ * 由于是线程私有的，转换出的帧只能在当前线程中使用
+ */
+class ScaleCache {
+
+public:
+
+    /**
+     * 获取当前线程的转换缓存
+     * @return
+     */
+    static ScaleCache &current();
+
+    ~ScaleCache();
+
+    ScaleCache(const ScaleCache &obj) = delete;
+
+    ScaleCache &operator=(const ScaleCache &obj) = delete;
+
+    /**
+     * 转换一帧
+     * @param src       输入帧
+     * @param dstWidth  输出宽度
+     * @param dstHeight 输出高度
+     * @param dstFormat 输出的像素格式
+     * @return 输出帧，所有权归缓存，在当前线程下一次转换前有效。失败返回 nullptr
+     */
+    AVFrame *convert(const AVFrame *src, int dstWidth, int dstHeight, AVPixelFormat dstFormat);
+
+    /**
+     * 转换一帧到调用方提供的帧中，只缓存转换上下文。输出帧在转换之后仍归调用方所有，可以交给其他线程。
+     * YUV 转 RGB 时按输入帧的色彩空间（BT.601/BT.709）和取值范围设置转换系数
+     * @param src 输入帧
+     * @param dst 输出帧，宽高、格式和缓冲由调用方设置
+     * @return
+     */
+    bool convert(const AVFrame *src, AVFrame *dst);
+
+private:
+
+    ScaleCache() = default;
+
+    /**
+     * 缓存的键
+     */
+    struct Key {
+        int srcWidth;
+        int srcHeight;
+        AVPixelFormat srcFormat;
+        int dstWidth;
+        int dstHeight;
+        AVPixelFormat dstFormat;
+
+        bool operator<(const Key &other) const {
+            if (srcWidth != other.srcWidth) {
+                return srcWidth < other.srcWidth;
+            }
+            if (srcHeight != other.srcHeight) {
+                return srcHeight < other.srcHeight;
+            }
+            if (srcFormat != other.srcFormat) {
+                return srcFormat < other.srcFormat;
+            }
+            if (dstWidth != other.dstWidth) {
+                return dstWidth < other.dstWidth;
+            }
+            if (dstHeight != other.dstHeight) {
+                return dstHeight < other.dstHeight;
+            }
+            return dstFormat < other.dstFormat;
+        }
+    };
+
+    /**
+     * 转换的方式
+     */
+    enum class Route {
+        Swscale,     /* swscale 的通用路径 */
+        Downshift,   /* 只降低位深，由 PixelConvert 转换 */
+        BoxDownscale /* 8 位平面按整数倍缩小，由 PixelConvert 做盒式滤波 */
+    };
+
+    /**
+     * 缓存的转换上下文和输出帧
+     */
+    struct Entry {
+        Route route;
+        SwsContext *swsCtx;    /* 只在 Swscale 时不为空 */
+        AVFrame *frame;        /* 第一次用缓存的输出帧转换时才申请 */
+        int colorspace;        /* 已设置到 swsCtx 的输入色彩空间（SWS_CS_*），未设置时为 -1 */
+        int srcRange;          /* 已设置到 swsCtx 的输入取值范围，1 为全范围 */
+        unsigned long long lastUsed;    /* 最近一次取出时的 useTick */
+    };
+
+    /**
+     * 查找转换上下文，缓存中没有时创建一个
+     * @return 失败返回 nullptr
+     */
+    Entry *acquire(const Key &key);
+
+    /**
+     * 用缓存的转换上下文转换一帧
+     * @return
+     */
+    static bool scale(Entry &entry, const AVFrame *src, AVFrame *dst);
+
+    /**
+     * 创建转换上下文
+     * @return
+     */
+    static bool open(const Key &key, Entry &entry);
+
+    /**
+     * 释放转换上下文和输出帧
+     */
+    static void close(Entry &entry);
+
+    /**
+     * 淘汰最久没有使用的转换上下文
+     */
+    void evictLeastRecentlyUsed();
+
+    std::map<Key, Entry> entries;    /* 已创建的转换上下文 */
+    unsigned long long useTick = 0;  /* 每次取出转换上下文时递增，用于找出最久没有使用的 */
+};
+
+#endif //H265TOJPEG_SCALECACHE_H
@@ -0,0 +1,193 @@
+#include "TaskScheduler.h"
+
+/* 工作线程队列的初始容量，必须是 2 的幂 */
+#define WORK_DEQUE_CAPACITY 64
+
+/* 当前线程所属的调度器及其中的序号 */
+static thread_local const TaskScheduler *currentScheduler = nullptr;
+static thread_local int currentIndex = -1;
+
+
+TaskScheduler::WorkDeque::WorkDeque() : top(0), bottom(0) {
+    rings.emplace_back(new Ring(WORK_DEQUE_CAPACITY));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+TaskScheduler::WorkDeque::~WorkDeque() {
+    // 调度器析构时工作线程已退出，剩下的任务不再执行
+    Task *task;
+    while ((task = pop()) != nullptr) {
+        delete task;
+    }
+}
+
+void TaskScheduler::WorkDeque::push(Task *const task) {
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    Ring *r = ring.load(std::memory_order_relaxed);
+
+    // 队列满时换成两倍长的数组。旧数组保留到析构，正在窃取的线程仍可安全读取
+    if (b - t >= r->capacity) {
+        Ring *bigger = new Ring(r->capacity * 2);
+        for (long i = t; i < b; ++i) {
+            bigger->put(i, r->get(i));
+        }
+        rings.emplace_back(bigger);
+        ring.store(bigger, std::memory_order_release);
+        r = bigger;
+    }
+
+    r->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+TaskScheduler::Task *TaskScheduler::WorkDeque::pop() {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring *r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // 队列为空
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Task *task = r->get(b);
+    if (t == b) {
+        // 只剩最后一个任务，与窃取的线程竞争
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+TaskScheduler::Task *TaskScheduler::WorkDeque::steal() {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+
+    Ring *r = ring.load(std::memory_order_acquire);
+    Task *task = r->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return task;
+}
+
+TaskScheduler::TaskScheduler(const int workers) : queued(0), stopping(false) {
+    int count = workers > 0 ? workers : 1;
+    for (int i = 0; i < count; ++i) {
+        deques.emplace_back(new WorkDeque());
+    }
+    this->workers.reserve((size_t) count);
+    for (int i = 0; i < count; ++i) {
+        this->workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+    for (Task *task : injected) {
+        delete task;
+    }
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+int TaskScheduler::workerCount() const {
+    return (int) workers.size();
+}
+
+int TaskScheduler::currentWorker() const {
+    return currentScheduler == this ? currentIndex : -1;
+}
+
+void TaskScheduler::submit(Task task) {
+    Task *heapTask = new Task(std::move(task));
+    int index = currentWorker();
+    if (index >= 0) {
+        deques[index]->push(heapTask);
+    } else {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(heapTask);
+    }
+
+    // 计数在加锁后增加，休眠的线程不会错过唤醒
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++queued;
+    }
+    wakeUp.notify_one();
+}
+
+TaskScheduler::Task *TaskScheduler::findTask(const int index) {
+    // 自己的队列
+    Task *task = deques[index]->pop();
+    if (task) {
+        return task;
+    }
+
+    // 全局队列
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if (!injected.empty()) {
+            task = injected.front();
+            injected.pop_front();
+            return task;
+        }
+    }
+
+    // 从下一个线程开始依次窃取，避免所有空闲线程都盯着同一个队列
+    int count = (int) deques.size();
+    for (int i = 1; i < count; ++i) {
+        task = deques[(index + i) % count]->steal();
+        if (task) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void TaskScheduler::workerLoop(const int index) {
+    currentScheduler = this;
+    currentIndex = index;
+
+    while (true) {
+        Task *task = findTask(index);
+        if (task) {
+            --queued;
+            (*task)();
+            delete task;
+            continue;
+        }
+
+        // 没有可取的任务时休眠。计数不为 0 说明有任务刚提交或正被其他线程取走，重新查找
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (queued == 0 && stopping) {
+            break;
+        }
+        wakeUp.wait(lock, [this] { return queued > 0 || stopping; });
+    }
+
+    currentScheduler = nullptr;
+    currentIndex = -1;
+}
@@ -0,0 +1,147 @@
+#ifndef H265TOJPEG_TASKSCHEDULER_H
+#define H265TOJPEG_TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * 工作窃取（work-stealing）的任务调度器。
+ * 每个工作线程有自己的双端队列：本线程提交的任务压入队尾，也从队尾取出（后进先出，数据还在缓存中）；
+ * 空闲的线程从其他线程的队头无锁窃取。其他线程提交的任务先放入全局队列。
+ * 大任务拆成多个小任务（如解码、编码）后，后续的小任务可以被空闲的线程取走，不会都排在一个线程后面
+ */
+class TaskScheduler {
+
+public:
+
+    typedef std::function<void()> Task;
+
+    /**
+     * 创建并启动工作线程
+     * @param workers 工作线程数
+     */
+    explicit TaskScheduler(int workers);
+
+    /**
+     * 停止工作线程，同 stop()
+     */
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler &obj) = delete;
+
+    TaskScheduler &operator=(const TaskScheduler &obj) = delete;
+
+    /**
+     * 提交任务。在本调度器的工作线程中调用时放入该线程的队列，否则放入全局队列
+     * @param task 任务
+     */
+    void submit(Task task);
+
+    /**
+     * 执行完已提交的全部任务（包括执行中再提交的）后停止工作线程，之后不能再提交。可重复调用
+     */
+    void stop();
+
+    /**
+     * @return 工作线程数
+     */
+    int workerCount() const;
+
+    /**
+     * @return 当前线程在本调度器中的序号，不是本调度器的工作线程时返回 -1
+     */
+    int currentWorker() const;
+
+private:
+
+    /**
+     * 单个工作线程的任务队列（Chase-Lev 双端队列）。
+     * 只有所属线程调用 push/pop ，任意线程都可以调用 steal ，三者都不加锁
+     */
+    class WorkDeque {
+
+    public:
+
+        WorkDeque();
+
+        ~WorkDeque();
+
+        WorkDeque(const WorkDeque &obj) = delete;
+
+        WorkDeque &operator=(const WorkDeque &obj) = delete;
+
+        /**
+         * 压入队尾，只能由所属线程调用。队列满时扩容
+         */
+        void push(Task *task);
+
+        /**
+         * 从队尾取出，只能由所属线程调用
+         * @return 队列为空时返回 nullptr
+         */
+        Task *pop();
+
+        /**
+         * 从队头窃取，任意线程都可以调用
+         * @return 队列为空或与其他线程竞争失败时返回 nullptr
+         */
+        Task *steal();
+
+    private:
+
+        /**
+         * 环形数组，长度为 2 的幂
+         */
+        struct Ring {
+            explicit Ring(long capacity) : capacity(capacity), slots(new std::atomic<Task *>[capacity]) {
+            }
+
+            Task *get(long i) const {
+                return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+            }
+
+            void put(long i, Task *task) {
+                slots[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+            }
+
+            const long capacity;
+            std::unique_ptr<std::atomic<Task *>[]> slots;
+        };
+
+        std::atomic<long> top;    /* 队头，窃取的位置 */
+        std::atomic<long> bottom; /* 队尾，所属线程压入和取出的位置 */
+        std::atomic<Ring *> ring; /* 当前的环形数组 */
+        std::vector<std::unique_ptr<Ring>> rings; /* 扩容前的数组可能还在被窃取的线程读取，到析构时才释放 */
+    };
+
+    /**
+     * 工作线程：依次从自己的队列、全局队列、其他线程的队列中取任务，都没有时休眠
+     * @param index 工作线程的序号
+     */
+    void workerLoop(int index);
+
+    /**
+     * 查找下一个任务
+     * @param index 工作线程的序号
+     * @return 没有任务时返回 nullptr
+     */
+    Task *findTask(int index);
+
+    std::vector<std::unique_ptr<WorkDeque>> deques; /* 各工作线程的队列 */
+    std::vector<std::thread> workers;  /* 工作线程 */
+    std::mutex injectMutex;            /* 保护 injected */
+    std::deque<Task *> injected;       /* 非工作线程提交的任务 */
+    std::mutex sleepMutex;             /* 休眠和唤醒工作线程 */
+    std::condition_variable wakeUp;
+    std::atomic<long> queued;          /* 已提交、尚未被取出的任务数 */
+    std::atomic<bool> stopping;        /* 析构中 */
+};
+
+#endif //H265TOJPEG_TASKSCHEDULER_H
@@ -0,0 +1,178 @@
+//
+// 有界队列的测试：先进先出、满/空时的行为，关闭后入队失败、消费者取完剩余元素再结束
+//
+
+#include <vector>
+#include "BoundedQueue.h"
+#include "TestUtil.h"
+
+/* 多线程测试中生产者、消费者的个数和每个生产者入队的元素数 */
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS_PER_PRODUCER 20000
+
+int main() {
+    // 容量向上取整为 2 的幂
+    CHECK_EQ(BoundedQueue<int>(1).stats().capacity, 2);
+    CHECK_EQ(BoundedQueue<int>(5).stats().capacity, 8);
+    CHECK_EQ(BoundedQueue<int>(8).stats().capacity, 8);
+
+    // 不阻塞的入队和出队：满时入队失败，空时出队失败，先进先出
+    {
+        BoundedQueue<int> queue(8);
+        int value = 0;
+        CHECK(!queue.tryPop(value));
+        for (int i = 0; i < 8; ++i) {
+            value = i;
+            CHECK(queue.tryPush(value));
+        }
+        value = 8;
+        CHECK(!queue.tryPush(value));
+        CHECK_EQ(queue.stats().depth, 8);
+        CHECK_EQ(queue.stats().maxDepth, 8);
+        for (int i = 0; i < 8; ++i) {
+            CHECK(queue.tryPop(value));
+            CHECK_EQ(value, i);
+        }
+        CHECK(!queue.tryPop(value));
+        CHECK_EQ(queue.stats().depth, 0);
+    }
+
+    // 关闭后先取完剩余的元素，之后 pop 一直返回 false
+    {
+        BoundedQueue<int> queue(4);
+        queue.push(1);
+        queue.push(2);
+        queue.push(3);
+        queue.close();
+        int value = 0;
+        for (int i = 1; i <= 3; ++i) {
+            CHECK(queue.pop(value));
+            CHECK_EQ(value, i);
+        }
+        CHECK(!queue.pop(value));
+        CHECK(!queue.pop(value));
+    }
+
+    // 关闭后入队失败，不改变队列
+    {
+        BoundedQueue<int> queue(4);
+        CHECK(queue.push(1));
+        queue.close();
+        int value = 2;
+        CHECK(!queue.tryPush(value));
+        CHECK(!queue.push(3));
+        CHECK_EQ(queue.stats().depth, 1);
+        CHECK(queue.pop(value) && value == 1);
+        CHECK(!queue.pop(value));
+    }
+
+    // 队列满时等待中的生产者在关闭时返回 false ，不会一直等待
+    {
+        BoundedQueue<int> queue(2);
+        CHECK(queue.push(1));
+        CHECK(queue.push(2));
+        std::atomic<int> rejected(0);
+        std::vector<std::thread> producers;
+        for (int i = 0; i < PRODUCERS; ++i) {
+            producers.emplace_back([&queue, &rejected]() {
+                if (!queue.push(3)) {
+                    ++rejected;
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.close();
+        for (auto &producer : producers) {
+            producer.join();
+        }
+        CHECK_EQ(rejected.load(), PRODUCERS);
+        CHECK_EQ(queue.stats().depth, 2);
+    }
+
+    // 关闭时唤醒等待中的消费者
+    {
+        BoundedQueue<int> queue(4);
+        std::atomic<int> results(0);
+        std::vector<std::thread> consumers;
+        for (int i = 0; i < CONSUMERS; ++i) {
+            consumers.emplace_back([&queue, &results]() {
+                int value;
+                if (!queue.pop(value)) {
+                    ++results;
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.close();
+        for (auto &consumer : consumers) {
+            consumer.join();
+        }
+        CHECK_EQ(results.load(), CONSUMERS);
+    }
+
+    // 队列满时生产者等待，消费者取出后继续
+    {
+        BoundedQueue<int> queue(2);
+        queue.push(1);
+        queue.push(2);
+        std::atomic<bool> pushed(false);
+        std::thread producer([&queue, &pushed]() {
+            queue.push(3);
+            pushed = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(!pushed.load());
+        int value = 0;
+        CHECK(queue.pop(value) && value == 1);
+        producer.join();
+        CHECK(pushed.load());
+        CHECK(queue.pop(value) && value == 2);
+        CHECK(queue.pop(value) && value == 3);
+        CHECK(queue.stats().fullStallMicros > 0);
+    }
+
+    // 多生产者多消费者：生产者结束后关闭队列，每个元素恰好被取出一次
+    {
+        BoundedQueue<int> queue(16);
+        std::vector<std::atomic<int>> seen(PRODUCERS * ITEMS_PER_PRODUCER);
+        for (auto &count : seen) {
+            count = 0;
+        }
+        std::vector<std::thread> producers, consumers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&queue, p]() {
+                for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                    queue.push(p * ITEMS_PER_PRODUCER + i);
+                }
+            });
+        }
+        for (int c = 0; c < CONSUMERS; ++c) {
+            consumers.emplace_back([&queue, &seen]() {
+                int value;
+                while (queue.pop(value)) {
+                    ++seen[value];
+                }
+            });
+        }
+        for (auto &producer : producers) {
+            producer.join();
+        }
+        queue.close();
+        for (auto &consumer : consumers) {
+            consumer.join();
+        }
+
+        int missing = 0, duplicated = 0;
+        for (auto &count : seen) {
+            missing += count == 0;
+            duplicated += count > 1;
+        }
+        CHECK_EQ(missing, 0);
+        CHECK_EQ(duplicated, 0);
+        CHECK_EQ(queue.stats().depth, 0);
+        CHECK(queue.stats().maxDepth <= 16);
+    }
+
+    return testResult();
+}
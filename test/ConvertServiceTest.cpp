@@ -0,0 +1,70 @@
+//
+// 批量转换服务的测试：各种调度方式的结果正确；编码器只有指定 jpegQscale 时才在各项之间复用
+//
+
+#include "IConvertService.h"
+#include "TestUtil.h"
+
+/* 转换的项数和工作线程数 */
+#define ITEM_COUNT 12
+#define WORKERS 2
+
+int main() {
+    std::vector<unsigned char> expected;
+    if (!readWholeFile(testImage("img01.h264.jpeg"), expected)) {
+        return 1;
+    }
+    const std::string dir = makeTempDir();
+    std::vector<ConvertItem> items;
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        items.push_back(ConvertItem{testImage("img01.h264"), dir + "item" + std::to_string(i) + ".jpeg"});
+    }
+
+    for (ConvertScheduling scheduling : {ConvertScheduling::Fifo, ConvertScheduling::WorkStealing,
+                                         ConvertScheduling::Pipeline}) {
+        for (int qscale : {0, 6}) {
+            ConvertServiceConfig config;
+            config.workers = WORKERS;
+            config.scheduling = scheduling;
+            config.decoderThreads = 1;
+            config.encoderThreads = 1;
+            config.decoder.jpegQscale = qscale;
+            auto service = IConvertService::getInstance(config);
+
+            unsigned long long opens = IDecoder::getAllocationStats().encoderOpens;
+            std::vector<ConvertResult> results = service->convertBatch(items);
+            opens = IDecoder::getAllocationStats().encoderOpens - opens;
+
+            CHECK_EQ(results.size(), ITEM_COUNT);
+            for (size_t i = 0; i < results.size(); ++i) {
+                CHECK(results[i] == ConvertResult::Ok);
+                std::vector<unsigned char> jpeg;
+                int width = 0, height = 0;
+                CHECK(readWholeFile(items[i].outputFilePath, jpeg) && jpegDimensions(jpeg, width, height));
+                CHECK(width == 1920 && height == 1080);
+                // 默认（码率控制）的结果与单独转换相同
+                if (qscale == 0) {
+                    CHECK(jpeg == expected);
+                }
+            }
+
+            // 码率控制时每项新建编码器；固定量化参数时每个执行编码的线程只新建一次
+            if (qscale == 0) {
+                CHECK_EQ(opens, ITEM_COUNT);
+            } else if (opens < 1 || opens > WORKERS) {
+                printf("调度方式 %d ，新建编码器 %llu 个\n", (int) scheduling, opens);
+                CHECK(false);
+            }
+        }
+    }
+
+    // 输入不存在、路径为空
+    auto service = IConvertService::getInstance();
+    std::vector<ConvertItem> bad = {{dir + "missing.h264", dir + "missing.jpeg"}, {"", dir + "empty.jpeg"}};
+    std::vector<ConvertResult> results = service->convertBatch(bad);
+    CHECK(results.size() == 2 && results[0] == ConvertResult::InputNotFound &&
+          results[1] == ConvertResult::InvalidArgument);
+
+    removeTempDir(dir);
+    return testResult();
+}
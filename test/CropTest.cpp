@@ -0,0 +1,194 @@
+//
+// 裁剪输出的测试：区域对齐到色度像素、截掉超出图像的部分，像素与直接编码原图中同一区域的结果完全相同
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/pixdesc.h"
+#ifdef __cplusplus
+}
+#endif
+
+#include <memory>
+#include "Encoder.h"
+#include "IDecoder.h"
+#include "OutputSink.h"
+#include "TestUtil.h"
+
+/**
+ * 一个裁剪区域及其预期的结果
+ */
+struct CropCase {
+    CropRegion region;
+    int x, y, width, height; /* 对齐、截断后的区域 */
+};
+
+/**
+ * 不拷贝像素地引用解码出的图像中的一块区域，作为参照编码的输入
+ * @param decoded 解码出的图像（YUV 平面格式）
+ * @param x       左上角的横坐标，已对齐到色度像素
+ * @param y       左上角的纵坐标，已对齐到色度像素
+ * @param width   宽度
+ * @param height  高度
+ * @return 由调用方用 av_frame_free 释放
+ */
+static AVFrame *referenceFrame(const DecodedFrame &decoded, int x, int y, int width, int height) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) decoded.format);
+    AVFrame *frame = av_frame_alloc();
+    frame->format = decoded.format;
+    frame->width = width;
+    frame->height = height;
+    for (int p = 0; p < decoded.planes; ++p) {
+        int shiftX = p == 0 ? 0 : desc->log2_chroma_w;
+        int shiftY = p == 0 ? 0 : desc->log2_chroma_h;
+        frame->data[p] = (uint8_t *) decoded.data[p] + (y >> shiftY) * decoded.linesize[p] +
+                         (x >> shiftX) * desc->comp[p].step;
+        frame->linesize[p] = decoded.linesize[p];
+    }
+    return frame;
+}
+
+/**
+ * 直接编码原图中的一块区域
+ * @return Jpeg 数据，失败时为空
+ */
+static std::vector<unsigned char> encodeRegion(const DecodedFrame &decoded, const CropCase &crop) {
+    AVFrame *frame = referenceFrame(decoded, crop.x, crop.y, crop.width, crop.height);
+    Encoder encoder;
+    std::vector<unsigned char> jpeg;
+    if (encoder.yuv2Jpeg(frame, crop.region.maxDimension)) {
+        jpeg.assign(encoder.getJpegData(), encoder.getJpegData() + encoder.getJpegSize());
+    }
+    av_frame_free(&frame);
+    return jpeg;
+}
+
+/**
+ * 构造一个裁剪区域及其预期的结果
+ */
+static CropCase makeCase(int x, int y, int width, int height, int expectedX, int expectedY, int expectedWidth,
+                         int expectedHeight, int maxDimension = 0) {
+    CropCase crop;
+    crop.region.x = x;
+    crop.region.y = y;
+    crop.region.width = width;
+    crop.region.height = height;
+    crop.region.maxDimension = maxDimension;
+    crop.x = expectedX;
+    crop.y = expectedY;
+    crop.width = expectedWidth;
+    crop.height = expectedHeight;
+    return crop;
+}
+
+int main() {
+    auto decoder = IDecoder::getInstance();
+    for (const char *name : {"img01.h264", "img01.h265"}) {
+        std::vector<unsigned char> input;
+        if (!readWholeFile(testImage(name), input)) {
+            return 1;
+        }
+        DecodedFrame decoded;
+        CHECK(decoder->H265ToFrame(input.data(), input.size(), decoded));
+        CHECK_EQ(decoded.format, AV_PIX_FMT_YUV420P);
+        const int w = decoded.width, h = decoded.height;
+
+        std::vector<CropCase> cases;
+        // 已对齐
+        cases.push_back(makeCase(100, 50, 200, 100, 100, 50, 200, 100));
+        // 4:2:0 时左上角向下、右下角向上取整到偶数
+        cases.push_back(makeCase(101, 51, 200, 100, 100, 50, 202, 102));
+        cases.push_back(makeCase(7, 9, 1, 1, 6, 8, 2, 2));
+        // 超出图像的部分被截掉
+        cases.push_back(makeCase(w - 120, h - 80, 400, 400, w - 120, h - 80, 120, 80));
+        cases.push_back(makeCase(-10, -10, 50, 50, 0, 0, 40, 40));
+        // 整幅图像
+        cases.push_back(makeCase(0, 0, w, h, 0, 0, w, h));
+        // 裁剪后缩小
+        cases.push_back(makeCase(0, 0, 1000, 500, 0, 0, 1000, 500, 250));
+        cases.push_back(makeCase(301, 201, 600, 600, 300, 200, 602, 602, 256));
+
+        std::vector<std::unique_ptr<MemorySink>> sinks;
+        std::vector<CropRegion> regions;
+        for (CropCase &crop : cases) {
+            sinks.emplace_back(new MemorySink());
+            crop.region.sink = sinks.back().get();
+            regions.push_back(crop.region);
+        }
+        CHECK(decoder->H265ToJpegCrops(input.data(), input.size(), regions));
+
+        for (size_t i = 0; i < cases.size(); ++i) {
+            const CropCase &crop = cases[i];
+            int expectedWidth, expectedHeight, width = 0, height = 0;
+            Encoder::thumbnailSize(crop.width, crop.height, crop.region.maxDimension, expectedWidth, expectedHeight);
+            CHECK(jpegDimensions(sinks[i]->data(), sinks[i]->size(), width, height));
+            CHECK_EQ(width, expectedWidth);
+            CHECK_EQ(height, expectedHeight);
+
+            // 与直接编码同一区域的结果逐字节相同，即裁剪的位置正确
+            std::vector<unsigned char> expected = encodeRegion(decoded, crop);
+            CHECK(!expected.empty());
+            if (std::vector<unsigned char>(sinks[i]->data(), sinks[i]->data() + sinks[i]->size()) != expected) {
+                printf("%s 第 %zu 个区域与参照不同\n", name, i);
+                CHECK(false);
+            }
+        }
+
+        // 整幅图像的裁剪与不裁剪的结果相同
+        std::vector<unsigned char> whole;
+        CHECK(decoder->H265ToJpeg(input.data(), input.size(), whole));
+        CHECK(std::vector<unsigned char>(sinks[5]->data(), sinks[5]->data() + sinks[5]->size()) == whole);
+
+        // 区域在图像之外时失败，其余区域仍会输出
+        MemorySink outside, inside;
+        std::vector<CropRegion> mixed(2);
+        mixed[0].x = w;
+        mixed[0].width = 10;
+        mixed[0].height = 10;
+        mixed[0].sink = &outside;
+        mixed[1] = cases[0].region;
+        mixed[1].sink = &inside;
+        CHECK(!decoder->H265ToJpegCrops(input.data(), input.size(), mixed));
+        CHECK_EQ(outside.size(), 0);
+        CHECK_EQ(inside.size(), sinks[0]->size());
+
+        // 空区域
+        mixed.resize(1);
+        mixed[0] = cases[0].region;
+        mixed[0].width = 0;
+        CHECK(!decoder->H265ToJpegCrops(input.data(), input.size(), mixed));
+    }
+
+    // 码率控制（默认）时每个区域新建编码器；指定 jpegQscale 后大小相同的区域复用同一个
+    std::vector<unsigned char> input;
+    CHECK(readWholeFile(testImage("img01.h264"), input));
+    std::vector<std::unique_ptr<MemorySink>> sinks;
+    std::vector<CropRegion> sameSize(4);
+    for (size_t i = 0; i < sameSize.size(); ++i) {
+        sinks.emplace_back(new MemorySink());
+        sameSize[i].x = 100 * (int) i;
+        sameSize[i].width = 64;
+        sameSize[i].height = 64;
+        sameSize[i].sink = sinks.back().get();
+    }
+    unsigned long long opens = IDecoder::getAllocationStats().encoderOpens;
+    CHECK(decoder->H265ToJpegCrops(input.data(), input.size(), sameSize));
+    CHECK_EQ(IDecoder::getAllocationStats().encoderOpens - opens, sameSize.size());
+
+    DecoderConfig config;
+    config.jpegQscale = 6;
+    auto fixedQuality = IDecoder::getInstance(config);
+    for (int round = 0; round < 2; ++round) {
+        opens = IDecoder::getAllocationStats().encoderOpens;
+        CHECK(fixedQuality->H265ToJpegCrops(input.data(), input.size(), sameSize));
+        // 第一轮新建一个，之后一直复用
+        CHECK_EQ(IDecoder::getAllocationStats().encoderOpens - opens, round == 0 ? 1 : 0);
+        for (auto &sink : sinks) {
+            int width = 0, height = 0;
+            CHECK(jpegDimensions(sink->data(), sink->size(), width, height) && width == 64 && height == 64);
+        }
+    }
+
+    return testResult();
+}
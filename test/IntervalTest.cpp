@@ -0,0 +1,79 @@
+//
+// 按时间间隔取帧的测试：输出的是各取样点正在显示的帧
+//
+
+#include "IDecoder.h"
+#include "TestStream.h"
+#include "TestUtil.h"
+
+/* 构造的裸流的帧数，帧率为测试图片 SPS 中的 10 */
+#define FRAME_COUNT 8
+
+/**
+ * 按间隔取帧，读出各输出图片对应的帧序号（由宽度得出）
+ * @param input   输入文件
+ * @param dir     输出目录
+ * @param options 取帧选项
+ * @return 各输出图片的帧序号，失败时为空
+ */
+static std::vector<int> sampleFrames(const std::string &input, const std::string &dir, const ExtractOptions &options) {
+    static int round = 0;
+    const std::string pattern = dir + "interval" + std::to_string(++round) + "_%d.jpeg";
+    std::vector<int> frames;
+    int written = IDecoder::getInstance()->H265ToJpegSequence(input.c_str(), pattern.c_str(), options);
+    for (int i = 1; i <= written; ++i) {
+        char path[256];
+        snprintf(path, sizeof(path), pattern.c_str(), i);
+        std::vector<unsigned char> jpeg;
+        int width = 0, height = 0;
+        if (!readWholeFile(path, jpeg) || !jpegDimensions(jpeg, width, height)) {
+            return std::vector<int>();
+        }
+        frames.push_back((1920 - width) / 2);
+    }
+    return frames;
+}
+
+int main() {
+    std::vector<unsigned char> source, stream;
+    if (!readWholeFile(testImage("img01.h264"), source)) {
+        return 1;
+    }
+    CHECK(makeDistinctH264Stream(source, FRAME_COUNT, stream));
+    const std::string dir = makeTempDir();
+    const std::string input = dir + "interval.h264";
+    CHECK(writeWholeFile(input, stream));
+
+    // 每帧都是关键帧，吸附到关键帧与否结果相同
+    for (bool snap : {false, true}) {
+        ExtractOptions options;
+        options.select = FrameSelect::Interval;
+        options.snapToKeyFrame = snap;
+
+        // 0、0.3、0.6 秒，0.9 秒超出时长
+        options.intervalSeconds = 0.3;
+        CHECK(sampleFrames(input, dir, options) == std::vector<int>({0, 3, 6}));
+
+        // 取样点落在帧的显示期间内时取该帧：0.25 秒是第 2 帧，0.75 秒是第 7 帧
+        options.intervalSeconds = 0.25;
+        CHECK(sampleFrames(input, dir, options) == std::vector<int>({0, 2, 5, 7}));
+
+        // 间隔小于一帧时每帧只输出一次
+        options.intervalSeconds = 0.04;
+        CHECK(sampleFrames(input, dir, options) == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}));
+
+        // 限制输出张数
+        options.intervalSeconds = 0.2;
+        options.maxFrames = 2;
+        CHECK(sampleFrames(input, dir, options) == std::vector<int>({0, 2}));
+    }
+
+    // 非法的间隔
+    ExtractOptions options;
+    options.select = FrameSelect::Interval;
+    options.intervalSeconds = 0;
+    CHECK(IDecoder::getInstance()->H265ToJpegSequence(input.c_str(), (dir + "bad_%d.jpeg").c_str(), options) < 0);
+
+    removeTempDir(dir);
+    return testResult();
+}
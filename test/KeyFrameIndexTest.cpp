@@ -0,0 +1,140 @@
+//
+// 关键帧索引文件的测试：输入文件的长度或修改时间变化后，索引文件失效并重新建立
+//
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "KeyFrameIndex.h"
+#include "TestStream.h"
+#include "TestUtil.h"
+
+/* 构造的裸流的帧数 */
+#define FRAME_COUNT 8
+
+/* 索引文件头的长度和其中索引项个数的位置，见 KeyFrameIndex.cpp 中的 IndexHeader */
+#define INDEX_HEADER_SIZE 64
+#define INDEX_COUNT_OFFSET 56
+
+/**
+ * 设置文件的修改时间
+ * @param filePath 文件路径
+ * @param seconds  修改时间（秒）
+ * @return
+ */
+static bool setModifyTime(const std::string &filePath, time_t seconds) {
+    struct timespec times[2];
+    times[0].tv_sec = seconds;
+    times[0].tv_nsec = 0;
+    times[1] = times[0];
+    return utimensat(AT_FDCWD, filePath.c_str(), times, 0) == 0;
+}
+
+/**
+ * 写入文件并设置修改时间，再打开索引
+ */
+static void openIndex(KeyFrameIndex &index, const std::string &filePath, const std::vector<unsigned char> &data,
+                      time_t seconds) {
+    CHECK(writeWholeFile(filePath, data));
+    CHECK(setModifyTime(filePath, seconds));
+    index.open(filePath.c_str(), data.data(), data.size(), AV_CODEC_ID_H264);
+}
+
+int main() {
+    std::vector<unsigned char> source, stream, shortStream;
+    if (!readWholeFile(testImage("img01.h264"), source)) {
+        return 1;
+    }
+    CHECK(makeDistinctH264Stream(source, FRAME_COUNT, stream));
+    CHECK(makeDistinctH264Stream(source, FRAME_COUNT - 3, shortStream));
+
+    // 长度相同、关键帧不同的码流：奇数帧的 IDR 改为普通条带
+    std::vector<unsigned char> halfKeyStream = stream;
+    int idrCount = 0;
+    for (size_t i = 0; i + 4 < halfKeyStream.size(); ++i) {
+        unsigned char &header = halfKeyStream[i + 4];
+        if (halfKeyStream[i] == 0 && halfKeyStream[i + 1] == 0 && halfKeyStream[i + 2] == 0 &&
+            halfKeyStream[i + 3] == 1 && (header & 0x1f) == 5 && (idrCount++ & 1)) {
+            header = (unsigned char) ((header & 0xe0) | 1);
+        }
+    }
+    CHECK_EQ(idrCount, FRAME_COUNT);
+
+    const std::string dir = makeTempDir();
+    const std::string input = dir + "index.h264";
+    const std::string indexFile = input + ".kfi";
+    const time_t modifyTime = 1700000000;
+    KeyFrameIndex index;
+
+    // 建立索引并保存
+    openIndex(index, input, stream, modifyTime);
+    CHECK_EQ(index.size(), FRAME_COUNT);
+    CHECK_EQ(index.frameCount(), FRAME_COUNT);
+    CHECK_EQ(index.find(5), 5);
+    CHECK(access(indexFile.c_str(), F_OK) == 0);
+
+    // 长度和修改时间都不变时使用索引文件，不再扫描码流（因此仍是原来的关键帧）
+    openIndex(index, input, halfKeyStream, modifyTime);
+    CHECK_EQ(index.size(), FRAME_COUNT);
+
+    // 修改时间变化，重新建立索引
+    openIndex(index, input, halfKeyStream, modifyTime + 1);
+    CHECK_EQ(index.size(), FRAME_COUNT / 2);
+    CHECK_EQ(index.frameCount(), FRAME_COUNT);
+    CHECK_EQ(index.at(index.find(5)).frameIndex, 4);
+
+    // 重新建立的索引已保存
+    openIndex(index, input, stream, modifyTime + 1);
+    CHECK_EQ(index.size(), FRAME_COUNT / 2);
+
+    // 长度变化，重新建立索引
+    openIndex(index, input, shortStream, modifyTime + 1);
+    CHECK_EQ(index.size(), FRAME_COUNT - 3);
+    CHECK_EQ(index.frameCount(), FRAME_COUNT - 3);
+
+    // 数据与文件长度不一致时不使用索引文件
+    index.open(input.c_str(), stream.data(), stream.size(), AV_CODEC_ID_H264);
+    CHECK_EQ(index.size(), FRAME_COUNT);
+
+    // 索引文件损坏时重新建立
+    CHECK(writeWholeFile(indexFile, std::vector<unsigned char>(7, 0xff)));
+    index.open(input.c_str(), shortStream.data(), shortStream.size(), AV_CODEC_ID_H264);
+    CHECK_EQ(index.size(), FRAME_COUNT - 3);
+
+    // 篡改的索引文件：项数乘法溢出后恰好等于实际长度、位置超出文件、位置不递增，都重新建立索引
+    openIndex(index, input, stream, modifyTime + 2);
+    std::vector<unsigned char> goodIndex;
+    CHECK(readWholeFile(indexFile, goodIndex));
+    CHECK_EQ(goodIndex.size(), INDEX_HEADER_SIZE + FRAME_COUNT * sizeof(KeyFrameIndex::Entry));
+    std::vector<uint64_t> offsets;
+    for (size_t i = 0; i < index.size(); ++i) {
+        offsets.push_back(index.at(i).offset);
+    }
+    for (int tamper = 0; tamper < 3; ++tamper) {
+        std::vector<unsigned char> badIndex = goodIndex;
+        KeyFrameIndex::Entry *entries = (KeyFrameIndex::Entry *) (badIndex.data() + INDEX_HEADER_SIZE);
+        if (tamper == 0) {
+            uint64_t count = FRAME_COUNT + (1ULL << 61);
+            memcpy(badIndex.data() + INDEX_COUNT_OFFSET, &count, sizeof(count));
+        } else if (tamper == 1) {
+            entries[3].offset = stream.size();
+        } else {
+            std::swap(entries[2].offset, entries[3].offset);
+        }
+        CHECK(writeWholeFile(indexFile, badIndex));
+        index.open(input.c_str(), stream.data(), stream.size(), AV_CODEC_ID_H264);
+        CHECK_EQ(index.size(), FRAME_COUNT);
+        for (size_t i = 0; i < index.size() && i < offsets.size(); ++i) {
+            CHECK_EQ(index.at(i).offset, offsets[i]);
+        }
+    }
+
+    // 不是文件输入时只在内存中建立
+    index.open(nullptr, halfKeyStream.data(), halfKeyStream.size(), AV_CODEC_ID_H264);
+    CHECK_EQ(index.size(), FRAME_COUNT / 2);
+
+    index.reset();
+    CHECK(!index.isOpen());
+    removeTempDir(dir);
+    return testResult();
+}
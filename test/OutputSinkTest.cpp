@@ -0,0 +1,102 @@
+//
+// 内存输出端的测试：持有编码器交出的缓冲、分块写入扩容，以及两种方式交替使用时不越界
+//
+
+#include <cstdint>
+#include <cstring>
+#include "OutputSink.h"
+#include "TestUtil.h"
+
+/**
+ * 生成测试数据
+ * @param size 长度
+ * @param seed 数据的起始值
+ * @return
+ */
+static std::vector<unsigned char> makeData(size_t size, unsigned seed) {
+    std::vector<unsigned char> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = (unsigned char) (seed + i * 7);
+    }
+    return data;
+}
+
+/**
+ * 判断输出端中的数据是否与预期相同
+ */
+static bool sameData(const MemorySink &sink, const std::vector<unsigned char> &expected) {
+    return sink.size() == expected.size() &&
+           (expected.empty() || memcmp(sink.data(), expected.data(), expected.size()) == 0);
+}
+
+int main() {
+    std::vector<unsigned char> jpeg = makeData(100, 1);
+    std::vector<unsigned char> chunk = makeData(5000, 2);
+
+    // 持有交出的缓冲，不拷贝，输出端销毁或下次输出时才释放
+    int released = 0;
+    {
+        MemorySink sink;
+        unsigned char *buffer = new unsigned char[jpeg.size()];
+        memcpy(buffer, jpeg.data(), jpeg.size());
+        std::shared_ptr<const unsigned char> shared(buffer, [&released](const unsigned char *p) {
+            ++released;
+            delete[] p;
+        });
+        CHECK(sink.writeJpeg(shared, jpeg.size()));
+        shared.reset();
+        CHECK_EQ(released, 0);
+        CHECK(sink.data() == buffer);
+        CHECK(sameData(sink, jpeg));
+
+        // 不调用 begin() 接着写，追加在持有的数据之后，并释放持有的缓冲
+        CHECK(sink.write(chunk.data(), chunk.size()));
+        CHECK_EQ(released, 1);
+        std::vector<unsigned char> expected = jpeg;
+        expected.insert(expected.end(), chunk.begin(), chunk.end());
+        CHECK(sameData(sink, expected));
+
+        // 长度溢出时失败，数据不变
+        CHECK(!sink.write(chunk.data(), SIZE_MAX));
+        CHECK(sameData(sink, expected));
+
+        // begin() 重新开始，多次小块写入时按需扩容
+        CHECK(sink.begin(0));
+        expected.clear();
+        for (int i = 0; i < 300; ++i) {
+            std::vector<unsigned char> piece = makeData((size_t) (i % 17) * 31 + 1, (unsigned) i);
+            CHECK(sink.write(piece.data(), piece.size()));
+            expected.insert(expected.end(), piece.begin(), piece.end());
+        }
+        CHECK(sink.end());
+        CHECK(sameData(sink, expected));
+
+        // 之后再交出缓冲，再接着写
+        std::shared_ptr<const unsigned char> second(new unsigned char[jpeg.size()],
+                                                    std::default_delete<unsigned char[]>());
+        memcpy((void *) second.get(), jpeg.data(), jpeg.size());
+        CHECK(sink.writeJpeg(second, jpeg.size()));
+        CHECK(sameData(sink, jpeg));
+        CHECK(sink.write(jpeg.data(), jpeg.size()));
+        expected = jpeg;
+        expected.insert(expected.end(), jpeg.begin(), jpeg.end());
+        CHECK(sameData(sink, expected));
+    }
+    CHECK_EQ(released, 1);
+
+    // 默认实现按 begin -> write -> end 输出
+    std::vector<unsigned char> received;
+    int calls = 0;
+    CallbackSink callback([&received, &calls](const unsigned char *data, size_t size) {
+        ++calls;
+        received.assign(data, data + size);
+        return true;
+    });
+    std::shared_ptr<const unsigned char> shared(jpeg.data(), [](const unsigned char *) {
+    });
+    CHECK(callback.writeJpeg(shared, jpeg.size()));
+    CHECK_EQ(calls, 1);
+    CHECK(received == jpeg);
+
+    return testResult();
+}
@@ -0,0 +1,90 @@
+//
+// 高位深到 8 位转换的测试：运行时选择的 SIMD 实现与标量实现、逐像素的参考结果完全相同
+//
+
+#include <random>
+#include "PixelConvert.h"
+#include "TestUtil.h"
+
+/**
+ * 一个像素的参考结果：四舍五入右移，截断到 255
+ */
+static uint8_t referenceDownshift(uint16_t value, int shift) {
+    uint32_t result = ((uint32_t) value + (1u << (shift - 1))) >> shift;
+    return (uint8_t) (result > 255 ? 255 : result);
+}
+
+int main() {
+    printf("转换函数：%s\n", PixelConvert::kernelName());
+    std::mt19937 random(20261017);
+
+    // 各种长度（覆盖 SIMD 的整块和行尾剩余的像素）、未对齐的地址、9~16 位的位深
+    std::vector<uint16_t> src(300);
+    std::vector<uint8_t> simd(src.size() + 1), scalar(src.size() + 1);
+    PixelConvert::DownshiftKernel kernel = PixelConvert::kernel();
+    int mismatches = 0;
+    for (int shift = 1; shift <= 8; ++shift) {
+        const uint16_t maxValue = (uint16_t) ((1u << (8 + shift)) - 1);
+        for (size_t count = 0; count <= 130; ++count) {
+            for (size_t offset = 0; offset < 3; ++offset) {
+                // 正常取值；奇数轮混入超出位深的值（损坏的码流），包括 0xffff
+                for (size_t i = 0; i < src.size(); ++i) {
+                    src[i] = (count & 1) && i % 7 == 0 ? (uint16_t) random() : (uint16_t) (random() % (maxValue + 1));
+                }
+                src[offset] = maxValue;
+                src[offset + 1] = 0xffff;
+                kernel(src.data() + offset, simd.data() + offset, count, shift);
+                PixelConvert::downshiftScalar(src.data() + offset, scalar.data() + offset, count, shift);
+                for (size_t i = offset; i < offset + count; ++i) {
+                    if (simd[i] != scalar[i] || scalar[i] != referenceDownshift(src[i], shift)) {
+                        if (mismatches++ < 10) {
+                            printf("shift=%d count=%zu offset=%zu i=%zu | %u -> simd %u scalar %u\n", shift, count,
+                                   offset, i, src[i], simd[i], scalar[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // 整帧转换：宽度为奇数、行有填充，色度平面按 4:2:0 取整
+    CHECK(PixelConvert::canDownshift(AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P));
+    CHECK(PixelConvert::canDownshift(AV_PIX_FMT_YUV422P12LE, AV_PIX_FMT_YUV422P));
+    CHECK(!PixelConvert::canDownshift(AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV422P));
+    CHECK(!PixelConvert::canDownshift(AV_PIX_FMT_YUV420P10BE, AV_PIX_FMT_YUV420P));
+    CHECK(!PixelConvert::canDownshift(AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P));
+
+    AVFrame *in = av_frame_alloc();
+    AVFrame *out = av_frame_alloc();
+    in->format = AV_PIX_FMT_YUV420P10LE;
+    out->format = AV_PIX_FMT_YUV420P;
+    in->width = out->width = 101;
+    in->height = out->height = 37;
+    CHECK(av_frame_get_buffer(in, 64) == 0 && av_frame_get_buffer(out, 64) == 0);
+    const int planeWidth[3] = {101, 51, 51}, planeHeight[3] = {37, 19, 19};
+    for (int p = 0; p < 3; ++p) {
+        for (int y = 0; y < planeHeight[p]; ++y) {
+            uint16_t *row = (uint16_t *) (in->data[p] + y * in->linesize[p]);
+            for (int x = 0; x < planeWidth[p]; ++x) {
+                row[x] = (uint16_t) (random() % 1024);
+            }
+        }
+    }
+    PixelConvert::downshift(in, out);
+    int frameMismatches = 0;
+    for (int p = 0; p < 3; ++p) {
+        for (int y = 0; y < planeHeight[p]; ++y) {
+            const uint16_t *srcRow = (const uint16_t *) (in->data[p] + y * in->linesize[p]);
+            const uint8_t *dstRow = out->data[p] + y * out->linesize[p];
+            for (int x = 0; x < planeWidth[p]; ++x) {
+                frameMismatches += dstRow[x] != referenceDownshift(srcRow[x], 2);
+            }
+        }
+    }
+    CHECK_EQ(frameMismatches, 0);
+    av_frame_free(&in);
+    av_frame_free(&out);
+
+    return testResult();
+}
@@ -0,0 +1,158 @@
+//
+// 多分辨率输出的测试：各级图片的尺寸符合 Encoder::thumbnailSize 的规则
+//
+
+#include <dirent.h>
+#include <memory>
+#include <thread>
+#include "Encoder.h"
+#include "IDecoder.h"
+#include "OutputSink.h"
+#include "TestUtil.h"
+
+/**
+ * 检查缩略图尺寸的计算结果
+ */
+static void checkThumbnailSize(int width, int height, int maxDimension, int expectedWidth, int expectedHeight) {
+    int dstWidth = 0, dstHeight = 0;
+    Encoder::thumbnailSize(width, height, maxDimension, dstWidth, dstHeight);
+    CHECK_EQ(dstWidth, expectedWidth);
+    CHECK_EQ(dstHeight, expectedHeight);
+}
+
+/**
+ * @return 当前进程的线程数
+ */
+static int threadCount() {
+    int count = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return -1;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        count += entry->d_name[0] != '.';
+    }
+    closedir(dir);
+    return count;
+}
+
+/**
+ * 多分辨率输出到内存
+ * @param decoder 解码器
+ * @param input   输入数据
+ * @param count   级数
+ * @return
+ */
+static bool pyramidToMemory(IDecoder &decoder, const std::vector<unsigned char> &input, int count) {
+    std::vector<std::unique_ptr<MemorySink>> sinks;
+    std::vector<PyramidLevel> levels(count);
+    for (int i = 0; i < count; ++i) {
+        sinks.emplace_back(new MemorySink());
+        levels[i].maxDimension = i == 0 ? 0 : 1024 >> i;
+        levels[i].sink = sinks.back().get();
+    }
+    return decoder.H265ToJpegPyramid(input.data(), input.size(), levels);
+}
+
+int main() {
+    // 不缩小
+    checkThumbnailSize(1920, 1080, 0, 1920, 1080);
+    checkThumbnailSize(1920, 1080, 1920, 1920, 1080);
+    checkThumbnailSize(1920, 1080, 4096, 1920, 1080);
+    // 整数倍缩小，保持精确的比例
+    checkThumbnailSize(1920, 1080, 960, 960, 540);
+    checkThumbnailSize(1920, 1080, 480, 480, 270);
+    checkThumbnailSize(1080, 1920, 640, 360, 640);
+    // 其他比例四舍五入到偶数，不超过最长边
+    checkThumbnailSize(1920, 1080, 1000, 1000, 562);
+    checkThumbnailSize(1920, 1080, 256, 256, 144);
+    checkThumbnailSize(101, 37, 50, 50, 18);
+    checkThumbnailSize(4000, 3, 100, 100, 2);
+
+    const int maxDimensions[] = {0, 1000, 960, 480, 256};
+    const int levelCount = sizeof(maxDimensions) / sizeof(maxDimensions[0]);
+    const std::string dir = makeTempDir();
+    auto decoder = IDecoder::getInstance();
+
+    // 测试图片及其分辨率
+    const struct {
+        const char *name;
+        int width;
+        int height;
+    } images[] = {{"img01.h264", 1920, 1080}, {"img01.h265", 2560, 1440}};
+    for (const auto &image : images) {
+        const char *name = image.name;
+        std::vector<unsigned char> input;
+        if (!readWholeFile(testImage(name), input)) {
+            return 1;
+        }
+
+        // 原图的尺寸
+        MemorySink original;
+        CHECK(decoder->H265ToJpeg(input.data(), input.size(), original));
+        int width = 0, height = 0;
+        CHECK(jpegDimensions(original.data(), original.size(), width, height));
+        CHECK_EQ(width, image.width);
+        CHECK_EQ(height, image.height);
+
+        // 各级输出到内存，顺序打乱
+        std::vector<std::unique_ptr<MemorySink>> sinks;
+        std::vector<PyramidLevel> levels;
+        for (int i = levelCount - 1; i >= 0; --i) {
+            sinks.emplace_back(new MemorySink());
+            PyramidLevel level;
+            level.maxDimension = maxDimensions[i];
+            level.sink = sinks.back().get();
+            levels.push_back(level);
+        }
+        CHECK(decoder->H265ToJpegPyramid(input.data(), input.size(), levels));
+        for (size_t i = 0; i < levels.size(); ++i) {
+            int expectedWidth, expectedHeight, levelWidth = 0, levelHeight = 0;
+            Encoder::thumbnailSize(width, height, levels[i].maxDimension, expectedWidth, expectedHeight);
+            CHECK(jpegDimensions(sinks[i]->data(), sinks[i]->size(), levelWidth, levelHeight));
+            CHECK_EQ(levelWidth, expectedWidth);
+            CHECK_EQ(levelHeight, expectedHeight);
+        }
+
+        // 原始分辨率一级与单独转换的结果相同
+        CHECK_EQ(sinks.back()->size(), original.size());
+
+        // 输出到文件
+        std::vector<std::string> paths;
+        levels.clear();
+        for (int i = 0; i < levelCount; ++i) {
+            paths.push_back(dir + name + "." + std::to_string(maxDimensions[i]) + ".jpeg");
+        }
+        for (int i = 0; i < levelCount; ++i) {
+            PyramidLevel level;
+            level.maxDimension = maxDimensions[i];
+            level.outputFilePath = paths[i].c_str();
+            levels.push_back(level);
+        }
+        CHECK(decoder->H265ToJpegPyramid(testImage(name).c_str(), levels));
+        for (int i = 0; i < levelCount; ++i) {
+            std::vector<unsigned char> jpeg;
+            int expectedWidth, expectedHeight, levelWidth = 0, levelHeight = 0;
+            Encoder::thumbnailSize(width, height, maxDimensions[i], expectedWidth, expectedHeight);
+            CHECK(readWholeFile(paths[i], jpeg) && jpegDimensions(jpeg, levelWidth, levelHeight));
+            CHECK_EQ(levelWidth, expectedWidth);
+            CHECK_EQ(levelHeight, expectedHeight);
+        }
+    }
+
+    // 编码各级的工作线程数随级数增加：先 2 级（1 个工作线程），再 6 级时重建为 5 个（不超过 CPU 核数 - 1）
+    std::vector<unsigned char> input;
+    CHECK(readWholeFile(testImage("img01.h264"), input));
+    auto pyramid = IDecoder::getInstance();
+    int baseThreads = threadCount();
+    CHECK(pyramidToMemory(*pyramid, input, 2));
+    CHECK_EQ(threadCount() - baseThreads, 1);
+    CHECK(pyramidToMemory(*pyramid, input, 6));
+    CHECK_EQ(threadCount() - baseThreads, std::max(1, std::min(5, (int) std::thread::hardware_concurrency() - 1)));
+    // 级数变少时沿用已有的线程
+    CHECK(pyramidToMemory(*pyramid, input, 3));
+    CHECK_EQ(threadCount() - baseThreads, std::max(1, std::min(5, (int) std::thread::hardware_concurrency() - 1)));
+
+    removeTempDir(dir);
+    return testResult();
+}
@@ -0,0 +1,78 @@
+//
+// 按时间 / 序号提取单帧的测试：定位到的帧与逐帧解码时同一序号的帧完全相同
+//
+
+#include "IDecoder.h"
+#include "TestStream.h"
+#include "TestUtil.h"
+
+/* 构造的裸流的帧数 */
+#define FRAME_COUNT 8
+
+/* 测试图片的 SPS 中的帧率 */
+#define FRAME_RATE 10.0
+
+int main() {
+    std::vector<unsigned char> source, stream;
+    if (!readWholeFile(testImage("img01.h264"), source)) {
+        return 1;
+    }
+
+    // 裁剪量不变时改写的 SPS 与原来的完全相同
+    std::vector<std::vector<unsigned char>> units = splitNalUnits(source);
+    std::vector<unsigned char> sps;
+    CHECK_EQ(units.size(), 3);
+    CHECK(rewriteSpsCropRight(units[0], 0, sps) && sps == units[0]);
+
+    CHECK(makeDistinctH264Stream(source, FRAME_COUNT, stream));
+    const std::string dir = makeTempDir();
+    const std::string input = dir + "seek.h264";
+    CHECK(writeWholeFile(input, stream));
+
+    // 逐帧解码作为参照，第 i 帧的宽度比原图少 2*i 像素
+    auto decoder = IDecoder::getInstance();
+    ExtractOptions options;
+    CHECK_EQ(decoder->H265ToJpegSequence(input.c_str(), (dir + "all_%d.jpeg").c_str(), options), FRAME_COUNT);
+    std::vector<std::vector<unsigned char>> expected(FRAME_COUNT);
+    for (int i = 0; i < FRAME_COUNT; ++i) {
+        int width = 0, height = 0;
+        CHECK(readWholeFile(dir + "all_" + std::to_string(i + 1) + ".jpeg", expected[i]));
+        CHECK(jpegDimensions(expected[i], width, height));
+        CHECK_EQ(width, 1920 - 2 * i);
+        CHECK_EQ(height, 1080);
+    }
+
+    // 默认不在输入文件的目录中写索引文件
+    CHECK(decoder->H265ToJpegAtFrame(input.c_str(), 3, (dir + "default.jpeg").c_str()));
+    CHECK(decoder->H265ToJpegAt(input.c_str(), 0.5, (dir + "default.jpeg").c_str()));
+    CHECK(access((input + ".kfi").c_str(), F_OK) != 0);
+
+    // 关键帧索引缓存开启和关闭时结果相同，开启时第二轮使用已保存的索引文件
+    for (bool indexCache : {false, true, true}) {
+        DecoderConfig config;
+        config.keyFrameIndexCache = indexCache;
+        auto seeker = IDecoder::getInstance(config);
+
+        // 倒序定位，每次都要跳回前面的关键帧
+        for (int i = FRAME_COUNT - 1; i >= 0; --i) {
+            std::vector<unsigned char> actual;
+            const std::string output = dir + "frame.jpeg";
+            CHECK(seeker->H265ToJpegAtFrame(input.c_str(), i, output.c_str()));
+            CHECK(readWholeFile(output, actual) && actual == expected[i]);
+
+            // 该帧显示期间的任意时刻都定位到该帧
+            for (double offset : {0.0, 0.5, 0.99}) {
+                CHECK(seeker->H265ToJpegAt(input.c_str(), (i + offset) / FRAME_RATE, output.c_str()));
+                CHECK(readWholeFile(output, actual) && actual == expected[i]);
+            }
+        }
+
+        // 超出视频时长
+        CHECK(!seeker->H265ToJpegAtFrame(input.c_str(), FRAME_COUNT, (dir + "out.jpeg").c_str()));
+        CHECK(!seeker->H265ToJpegAt(input.c_str(), FRAME_COUNT / FRAME_RATE, (dir + "out.jpeg").c_str()));
+        CHECK(!seeker->H265ToJpegAtFrame(input.c_str(), -1, (dir + "out.jpeg").c_str()));
+    }
+
+    removeTempDir(dir);
+    return testResult();
+}
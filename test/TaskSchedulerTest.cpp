@@ -0,0 +1,85 @@
+//
+// 任务调度器的测试：stop() 和析构时执行完全部任务，包括执行中再提交的任务
+//
+
+#include <chrono>
+#include <set>
+#include "TaskScheduler.h"
+#include "TestUtil.h"
+
+/* 工作线程数 */
+#define WORKERS 4
+
+/**
+ * 提交一棵深度为 depth 的二叉任务树，每个任务在执行时再提交两个子任务
+ * @param scheduler 调度器
+ * @param depth     深度
+ * @param executed  执行过的任务数
+ */
+static void submitTree(TaskScheduler &scheduler, int depth, std::atomic<int> &executed) {
+    scheduler.submit([&scheduler, depth, &executed]() {
+        ++executed;
+        if (depth > 1) {
+            submitTree(scheduler, depth - 1, executed);
+            submitTree(scheduler, depth - 1, executed);
+        }
+    });
+}
+
+int main() {
+    // 外部提交的任务和执行中再提交的任务都在 stop() 返回前执行完
+    {
+        TaskScheduler scheduler(WORKERS);
+        CHECK_EQ(scheduler.workerCount(), WORKERS);
+        CHECK_EQ(scheduler.currentWorker(), -1);
+
+        std::atomic<int> executed(0);
+        std::atomic<int> badWorker(0);
+        for (int i = 0; i < 1000; ++i) {
+            scheduler.submit([&scheduler, &executed, &badWorker]() {
+                int worker = scheduler.currentWorker();
+                if (worker < 0 || worker >= WORKERS) {
+                    ++badWorker;
+                }
+                ++executed;
+            });
+        }
+        for (int i = 0; i < 8; ++i) {
+            submitTree(scheduler, 10, executed);
+        }
+        scheduler.stop();
+        CHECK_EQ(executed.load(), 1000 + 8 * 1023);
+        CHECK_EQ(badWorker.load(), 0);
+
+        // 可重复调用
+        scheduler.stop();
+    }
+
+    // 析构时同样执行完全部任务
+    std::atomic<int> executed(0);
+    {
+        TaskScheduler scheduler(WORKERS);
+        submitTree(scheduler, 12, executed);
+    }
+    CHECK_EQ(executed.load(), 4095);
+
+    // 一个工作线程提交到自己队列中的任务，会被空闲的线程窃取
+    {
+        TaskScheduler scheduler(WORKERS);
+        std::mutex mutex;
+        std::set<int> workers;
+        scheduler.submit([&]() {
+            for (int i = 0; i < 64; ++i) {
+                scheduler.submit([&]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    std::lock_guard<std::mutex> lock(mutex);
+                    workers.insert(scheduler.currentWorker());
+                });
+            }
+        });
+        scheduler.stop();
+        CHECK(workers.size() > 1);
+    }
+
+    return testResult();
+}
@@ -0,0 +1,286 @@
+//
+// 构造测试用的多帧 H264 裸流。
+// 测试图片只有一帧，把其中的 IDR 帧重复多次，每帧前放一个右侧裁剪量不同的 SPS ，
+// 裁剪不影响码流的解析，第 i 帧的宽度比原图少 2*i 像素，可以据此判断定位到的是哪一帧
+//
+
+#ifndef H265TOJPEG_TESTSTREAM_H
+#define H265TOJPEG_TESTSTREAM_H
+
+#include <vector>
+
+/**
+ * 按位读取 RBSP
+ */
+class RbspReader {
+public:
+    explicit RbspReader(const std::vector<unsigned char> &data) : data(data) {
+    }
+
+    int readBit() {
+        int bit = (data[pos >> 3] >> (7 - (pos & 7))) & 1;
+        ++pos;
+        return bit;
+    }
+
+    unsigned readBits(int n) {
+        unsigned value = 0;
+        while (n-- > 0) {
+            value = (value << 1) | (unsigned) readBit();
+        }
+        return value;
+    }
+
+    unsigned readUe() {
+        int zeros = 0;
+        while (readBit() == 0) {
+            ++zeros;
+        }
+        return (1u << zeros) - 1 + readBits(zeros);
+    }
+
+    int readSe() {
+        unsigned code = readUe();
+        return (code & 1) ? (int) ((code + 1) / 2) : -(int) (code / 2);
+    }
+
+    size_t position() const {
+        return pos;
+    }
+
+    size_t size() const {
+        return data.size() * 8;
+    }
+
+private:
+    const std::vector<unsigned char> &data;
+    size_t pos = 0;
+};
+
+
+/**
+ * 按位写入 RBSP
+ */
+class RbspWriter {
+public:
+    void writeBit(int bit) {
+        if ((bits & 7) == 0) {
+            data.push_back(0);
+        }
+        if (bit) {
+            data.back() |= (unsigned char) (0x80 >> (bits & 7));
+        }
+        ++bits;
+    }
+
+    void writeBits(unsigned value, int n) {
+        while (n-- > 0) {
+            writeBit((value >> n) & 1);
+        }
+    }
+
+    void writeUe(unsigned value) {
+        unsigned code = value + 1;
+        int length = 0;
+        while ((code >> length) > 1) {
+            ++length;
+        }
+        writeBits(0, length);
+        writeBits(code, length + 1);
+    }
+
+    void writeSe(int value) {
+        writeUe(value > 0 ? (unsigned) (2 * value - 1) : (unsigned) (-2 * value));
+    }
+
+    std::vector<unsigned char> data;
+
+private:
+    size_t bits = 0;
+};
+
+
+/**
+ * 按起始码切分 Annex-B 裸流
+ * @param stream 裸流
+ * @return 各 NAL 单元（含 NAL 头，不含起始码）
+ */
+inline std::vector<std::vector<unsigned char>> splitNalUnits(const std::vector<unsigned char> &stream) {
+    std::vector<size_t> starts;
+    for (size_t i = 0; i + 3 <= stream.size(); ++i) {
+        if (stream[i] == 0 && stream[i + 1] == 0 && stream[i + 2] == 1) {
+            starts.push_back(i + 3);
+            i += 2;
+        }
+    }
+    std::vector<std::vector<unsigned char>> units;
+    for (size_t k = 0; k < starts.size(); ++k) {
+        size_t end = k + 1 < starts.size() ? starts[k + 1] - 3 : stream.size();
+        // 去掉下一个四字节起始码多出的 0
+        while (end > starts[k] && stream[end - 1] == 0) {
+            --end;
+        }
+        units.emplace_back(stream.begin() + starts[k], stream.begin() + end);
+    }
+    return units;
+}
+
+/**
+ * 去掉 NAL 单元中的防竞争字节
+ * @param nal NAL 单元（含 NAL 头）
+ * @return RBSP（不含 NAL 头）
+ */
+inline std::vector<unsigned char> nalToRbsp(const std::vector<unsigned char> &nal) {
+    std::vector<unsigned char> rbsp;
+    int zeros = 0;
+    for (size_t i = 1; i < nal.size(); ++i) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        rbsp.push_back(nal[i]);
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+    }
+    return rbsp;
+}
+
+/**
+ * 把 RBSP 重新封装为 NAL 单元，加上防竞争字节
+ * @param header NAL 头
+ * @param rbsp   RBSP
+ * @return
+ */
+inline std::vector<unsigned char> rbspToNal(unsigned char header, const std::vector<unsigned char> &rbsp) {
+    std::vector<unsigned char> nal(1, header);
+    int zeros = 0;
+    for (unsigned char byte : rbsp) {
+        if (zeros >= 2 && byte <= 3) {
+            nal.push_back(3);
+            zeros = 0;
+        }
+        nal.push_back(byte);
+        zeros = byte == 0 ? zeros + 1 : 0;
+    }
+    return nal;
+}
+
+/**
+ * 重写 H264 SPS 的右侧裁剪量。只支持没有 chroma_format_idc 等扩展字段的档次（Baseline/Main/Extended）
+ * @param sps       SPS 的 NAL 单元（含 NAL 头）
+ * @param cropRight frame_crop_right_offset （4:2:0 时单位为 2 像素）
+ * @param nal       新的 NAL 单元
+ * @return
+ */
+inline bool rewriteSpsCropRight(const std::vector<unsigned char> &sps, unsigned cropRight,
+                                std::vector<unsigned char> &nal) {
+    std::vector<unsigned char> rbsp = nalToRbsp(sps);
+    RbspReader reader(rbsp);
+    RbspWriter writer;
+    unsigned profileIdc = reader.readBits(8);
+    if (profileIdc != 66 && profileIdc != 77 && profileIdc != 88) {
+        return false;
+    }
+    writer.writeBits(profileIdc, 8);
+    writer.writeBits(reader.readBits(16), 16);  // constraint_set_flags 、level_idc
+    writer.writeUe(reader.readUe());            // seq_parameter_set_id
+    writer.writeUe(reader.readUe());            // log2_max_frame_num_minus4
+    unsigned pocType = reader.readUe();
+    writer.writeUe(pocType);
+    if (pocType == 0) {
+        writer.writeUe(reader.readUe());        // log2_max_pic_order_cnt_lsb_minus4
+    } else if (pocType == 1) {
+        writer.writeBit(reader.readBit());      // delta_pic_order_always_zero_flag
+        writer.writeSe(reader.readSe());        // offset_for_non_ref_pic
+        writer.writeSe(reader.readSe());        // offset_for_top_to_bottom_field
+        unsigned cycle = reader.readUe();
+        writer.writeUe(cycle);
+        for (unsigned i = 0; i < cycle; ++i) {
+            writer.writeSe(reader.readSe());    // offset_for_ref_frame
+        }
+    }
+    writer.writeUe(reader.readUe());            // max_num_ref_frames
+    writer.writeBit(reader.readBit());          // gaps_in_frame_num_value_allowed_flag
+    writer.writeUe(reader.readUe());            // pic_width_in_mbs_minus1
+    writer.writeUe(reader.readUe());            // pic_height_in_map_units_minus1
+    int frameMbsOnly = reader.readBit();
+    writer.writeBit(frameMbsOnly);
+    if (!frameMbsOnly) {
+        writer.writeBit(reader.readBit());      // mb_adaptive_frame_field_flag
+    }
+    writer.writeBit(reader.readBit());          // direct_8x8_inference_flag
+
+    // 原来的裁剪量，只替换右侧
+    unsigned crop[4] = {0, 0, 0, 0};
+    if (reader.readBit()) {
+        for (unsigned &offset : crop) {
+            offset = reader.readUe();
+        }
+    }
+    crop[1] = cropRight;
+    bool cropping = crop[0] || crop[1] || crop[2] || crop[3];
+    writer.writeBit(cropping);
+    if (cropping) {
+        for (unsigned offset : crop) {
+            writer.writeUe(offset);
+        }
+    }
+
+    // 其余字段（VUI）原样拷贝到 rbsp_stop_one_bit 为止，再补齐字节
+    size_t end = reader.size();
+    while (end > reader.position() && ((rbsp[(end - 1) >> 3] >> (7 - ((end - 1) & 7))) & 1) == 0) {
+        --end;
+    }
+    while (reader.position() < end) {
+        writer.writeBit(reader.readBit());
+    }
+    nal = rbspToNal(sps[0], writer.data);
+    return true;
+}
+
+/**
+ * 构造每一帧都不同的 H264 裸流，每帧都是 IDR ，帧前放改写过的 SPS 和原来的 PPS 。第 i 帧的宽度比原图少 2*i 像素
+ * @param source 只有一帧的 H264 裸流（SPS 、PPS 、IDR），不能有右侧裁剪
+ * @param frames 帧数，不超过宽度的一半
+ * @param stream 构造的裸流
+ * @return
+ */
+inline bool makeDistinctH264Stream(const std::vector<unsigned char> &source, int frames,
+                                   std::vector<unsigned char> &stream) {
+    const std::vector<unsigned char> *sps = nullptr, *pps = nullptr, *idr = nullptr;
+    std::vector<std::vector<unsigned char>> units = splitNalUnits(source);
+    for (const auto &unit : units) {
+        switch (unit.empty() ? 0 : unit[0] & 0x1f) {
+            case 7:
+                sps = &unit;
+                break;
+            case 8:
+                pps = &unit;
+                break;
+            case 5:
+                idr = &unit;
+                break;
+            default:
+                break;
+        }
+    }
+    if (!sps || !pps || !idr) {
+        return false;
+    }
+
+    static const unsigned char startCode[] = {0, 0, 0, 1};
+    stream.clear();
+    for (int i = 0; i < frames; ++i) {
+        std::vector<unsigned char> frameSps;
+        if (!rewriteSpsCropRight(*sps, (unsigned) i, frameSps)) {
+            return false;
+        }
+        const std::vector<unsigned char> *frameUnits[] = {&frameSps, pps, idr};
+        for (const std::vector<unsigned char> *unit : frameUnits) {
+            stream.insert(stream.end(), startCode, startCode + 4);
+            stream.insert(stream.end(), unit->begin(), unit->end());
+        }
+    }
+    return true;
+}
+
+#endif //H265TOJPEG_TESTSTREAM_H
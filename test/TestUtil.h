@@ -0,0 +1,149 @@
+//
+// 单元测试的公共工具
+//
+
+#ifndef H265TOJPEG_TESTUTIL_H
+#define H265TOJPEG_TESTUTIL_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/* 失败的检查数 */
+static int testFailures = 0;
+
+/**
+ * 检查条件是否成立，不成立时输出位置并记录失败，继续执行后面的检查
+ */
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d | 检查失败：%s\n", __FILE__, __LINE__, #cond); \
+            ++testFailures; \
+        } \
+    } while (0)
+
+/**
+ * 检查两个整数是否相等，不相等时输出两边的值
+ */
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long actualValue = (long long) (actual); \
+        long long expectedValue = (long long) (expected); \
+        if (actualValue != expectedValue) { \
+            printf("%s:%d | 检查失败：%s == %s （%lld != %lld）\n", __FILE__, __LINE__, #actual, #expected, \
+                   actualValue, expectedValue); \
+            ++testFailures; \
+        } \
+    } while (0)
+
+/**
+ * 输出测试结果，作为 main() 的返回值
+ * @return 全部通过返回 0
+ */
+inline int testResult() {
+    if (testFailures > 0) {
+        printf(">>> %d 项检查失败\n", testFailures);
+        return 1;
+    }
+    printf(">>> 全部通过\n");
+    return 0;
+}
+
+/**
+ * 获取测试图片的路径
+ * @param name 文件名，如 img01.h265
+ * @return
+ */
+inline std::string testImage(const char *name) {
+    return std::string(TEST_IMG_DIR) + "/" + name;
+}
+
+/**
+ * 将整个文件读入内存
+ * @param filePath 文件路径
+ * @param data     文件内容
+ * @return
+ */
+inline bool readWholeFile(const std::string &filePath, std::vector<unsigned char> &data) {
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    if (!in) {
+        printf("打开文件失败：%s\n", filePath.c_str());
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+/**
+ * 将数据写入文件
+ * @param filePath 文件路径
+ * @param data     文件内容
+ * @return
+ */
+inline bool writeWholeFile(const std::string &filePath, const std::vector<unsigned char> &data) {
+    std::ofstream out(filePath.c_str(), std::ios::binary | std::ios::trunc);
+    out.write((const char *) data.data(), (std::streamsize) data.size());
+    return out.good();
+}
+
+/**
+ * 从 Jpeg 的 SOF 段读取图像的宽高
+ * @param data   Jpeg 数据
+ * @param size   数据长度
+ * @param width  宽度
+ * @param height 高度
+ * @return 找不到 SOF 段时返回 false
+ */
+inline bool jpegDimensions(const unsigned char *data, size_t size, int &width, int &height) {
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xff) {
+        unsigned char marker = data[pos + 1];
+        size_t length = ((size_t) data[pos + 2] << 8) | data[pos + 3];
+        // SOF0 ~ SOF15 ，不含 DHT(C4) 、JPG(C8) 、DAC(CC)
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return true;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+inline bool jpegDimensions(const std::vector<unsigned char> &data, int &width, int &height) {
+    return jpegDimensions(data.data(), data.size(), width, height);
+}
+
+/**
+ * 创建测试用的临时目录
+ * @return 目录路径，以 / 结尾
+ */
+inline std::string makeTempDir() {
+    char dir[] = "/tmp/H265ToJpegTest.XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("创建临时目录失败\n");
+        exit(1);
+    }
+    return std::string(dir) + "/";
+}
+
+/**
+ * 删除临时目录及其中的文件
+ * @param dir makeTempDir() 返回的路径
+ */
+inline void removeTempDir(const std::string &dir) {
+    std::string command = "rm -rf '" + dir + "'";
+    if (system(command.c_str()) != 0) {
+        printf("删除临时目录失败：%s\n", dir.c_str());
+    }
+}
+
+#endif //H265TOJPEG_TESTUTIL_H